@@ -0,0 +1,48 @@
+/*
+* Golden image and frame time regression tests of the triangle example
+*
+* Usage : goldenTests -golden <directory> [-golden-output <directory>] [-golden-update]
+*                     [-golden-tolerance <value>] [-golden-max-regression <percent>]
+* The example is created headless, only the offscreen render target of the tests
+* is set up (no window, surface or swap chain), so the tests run on machines
+* without display, e.g. with a software implementation on CI
+* Returns 0 if all scenes match their golden image and baseline frame time
+* The golden images and baselines are written by a run with -golden-update on
+* the implementation the tests are run with (e.g. lavapipe), they are only
+* valid for that implementation
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <iostream>
+
+// SDL2main provides the entry point of the windows subsystem selected by vulkanexamplebase.h
+// No window is created
+#include <SDL/SDL.h>
+
+#include "../src/triangle.cpp"
+
+// Size of the rendered scenes, small enough for the golden images to be committed
+#define GOLDEN_TEST_WIDTH 320
+#define GOLDEN_TEST_HEIGHT 180
+
+int main(int argc, char *argv[])
+{
+    for (int i = 0; i < argc; i++)
+    {
+        VulkanExample::args.push_back(argv[i]);
+    }
+    VulkanExampleBase::headless = true;
+
+    VulkanExample triangle;
+    if (!triangle.goldenTests)
+    {
+        std::cerr << "Usage : " << argv[0] << " -golden <directory> [-golden-output <directory>] [-golden-update] [-golden-tolerance <value>] [-golden-max-regression <percent>]\n";
+        return 1;
+    }
+    triangle.width = GOLDEN_TEST_WIDTH;
+    triangle.height = GOLDEN_TEST_HEIGHT;
+    triangle.prepare();
+
+    return triangle.runGoldenTests() ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+/*
+* Packs SPIR-V shaders into a single archive (see src/vulkanshaderarchive.hpp)
+*
+* Usage : shaderPacker [-no-optimize] <archive> <shader.spv>...
+* Shaders are stored under their file name, without the directory
+* Debug information and dead code are removed from the shaders unless
+* -no-optimize is given (see src/vulkanspirvoptimizer.h)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../src/vulkanshaderarchive.hpp"
+#include "../src/vulkanspirvoptimizer.h"
+
+int main(int argc, char *argv[])
+{
+    bool optimize = true;
+    int firstArg = 1;
+    if ((argc > 1) && (std::string(argv[1]) == "-no-optimize"))
+    {
+        optimize = false;
+        firstArg++;
+    }
+    if (argc - firstArg < 2)
+    {
+        std::cerr << "Usage : " << argv[0] << " [-no-optimize] <archive> <shader.spv>...\n";
+        return 1;
+    }
+    const char *archiveName = argv[firstArg];
+
+    std::vector<VulkanShaderArchive::Shader> shaders;
+    std::set<std::string> names;
+    size_t originalSize = 0;
+    size_t totalSize = 0;
+    for (int i = firstArg + 1; i < argc; i++)
+    {
+        VulkanMappedFile file;
+        if (!file.open(argv[i]) || !file.isSpirv())
+        {
+            std::cerr << "Could not read SPIR-V shader " << argv[i] << "\n";
+            return 1;
+        }
+        VulkanShaderArchive::Shader shader;
+        shader.name = VulkanShaderArchive::shaderName(argv[i]);
+        if (!names.insert(shader.name).second)
+        {
+            std::cerr << "Duplicate shader name " << shader.name << "\n";
+            return 1;
+        }
+        const uint32_t *code = (const uint32_t*)file.data();
+        vkSpirvOptimizer::Report report;
+        if (!optimize || !vkSpirvOptimizer::optimize(code, file.size(), &shader.code, &report))
+        {
+            shader.code.assign(code, code + file.size() / sizeof(uint32_t));
+        }
+        else
+        {
+            std::cout << shader.name << " : " << vkSpirvOptimizer::toString(report) << "\n";
+        }
+        originalSize += file.size();
+        totalSize += shader.code.size() * sizeof(uint32_t);
+        shaders.push_back(shader);
+    }
+
+    if (!VulkanShaderArchive::write(archiveName, shaders))
+    {
+        std::cerr << "Could not write archive " << archiveName << "\n";
+        return 1;
+    }
+
+    // Make sure the archive can be read back
+    VulkanShaderArchive archive;
+    if (!archive.open(archiveName) || (archive.size() != shaders.size()))
+    {
+        std::cerr << "Archive " << archiveName << " is not valid\n";
+        return 1;
+    }
+    std::cout << "Packed " << shaders.size() << " shaders (" << totalSize << " bytes";
+    if (optimize)
+    {
+        std::cout << ", " << (originalSize - totalSize) << " bytes saved";
+    }
+    std::cout << ") into " << archiveName << "\n";
+    return 0;
+}
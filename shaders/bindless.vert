@@ -0,0 +1,37 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inColor;
+
+// Per-frame matrices
+layout (set = 0, binding = 0) uniform UBO
+{
+	mat4 projectionMatrix;
+	mat4 modelMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+// Bindless table : every per-draw block is a storage buffer of the table
+layout (set = 1, binding = 1) readonly buffer PerDraw
+{
+	mat4 modelMatrix;
+	vec4 color;
+} perDraw[];
+
+// Handle of the per-draw block in the table
+layout (push_constant) uniform PushConsts
+{
+	uint perDrawHandle;
+} pushConsts;
+
+layout (location = 0) out vec3 outColor;
+
+void main()
+{
+	outColor = inColor * perDraw[pushConsts.perDrawHandle].color.rgb;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * perDraw[pushConsts.perDrawHandle].modelMatrix * vec4(inPos.xyz, 1.0);
+}
@@ -0,0 +1,28 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Per-vertex attributes
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inColor;
+
+// Per-instance attributes
+// A mat4 attribute uses four consecutive locations (2 to 5)
+layout (location = 2) in mat4 instanceModelMatrix;
+layout (location = 6) in vec4 instanceColor;
+
+layout (binding = 0) uniform UBO
+{
+	mat4 projectionMatrix;
+	mat4 modelMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+layout (location = 0) out vec3 outColor;
+
+void main()
+{
+	outColor = inColor * instanceColor.rgb;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * instanceModelMatrix * vec4(inPos.xyz, 1.0);
+}
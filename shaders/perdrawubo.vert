@@ -0,0 +1,30 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inColor;
+
+// Per-frame matrices
+layout (binding = 0) uniform UBO
+{
+	mat4 projectionMatrix;
+	mat4 modelMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+// Per-draw data, bound either as a dynamic or as a static uniform buffer
+layout (binding = 1) uniform PerDraw
+{
+	mat4 modelMatrix;
+	vec4 color;
+} perDraw;
+
+layout (location = 0) out vec3 outColor;
+
+void main()
+{
+	outColor = inColor * perDraw.color.rgb;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * perDraw.modelMatrix * vec4(inPos.xyz, 1.0);
+}
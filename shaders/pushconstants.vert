@@ -0,0 +1,30 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inColor;
+
+// Per-frame matrices
+layout (binding = 0) uniform UBO
+{
+	mat4 projectionMatrix;
+	mat4 modelMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+// Per-draw data, 80 bytes (below the 128 bytes guaranteed by maxPushConstantsSize)
+layout (push_constant) uniform PushConsts
+{
+	mat4 modelMatrix;
+	vec4 color;
+} pushConsts;
+
+layout (location = 0) out vec3 outColor;
+
+void main()
+{
+	outColor = inColor * pushConsts.color.rgb;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * pushConsts.modelMatrix * vec4(inPos.xyz, 1.0);
+}
@@ -0,0 +1,28 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Specialization constants, set per pipeline
+// Disabled branches are removed by the driver when the pipeline is compiled
+layout (constant_id = 0) const bool GRAYSCALE = false;
+layout (constant_id = 1) const bool INVERT = false;
+layout (constant_id = 2) const float BRIGHTNESS = 1.0;
+
+layout (location = 0) in vec3 inColor;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+  vec3 color = inColor * BRIGHTNESS;
+  if (GRAYSCALE)
+  {
+    color = vec3(dot(color, vec3(0.299, 0.587, 0.114)));
+  }
+  if (INVERT)
+  {
+    color = vec3(1.0) - color;
+  }
+  outFragColor = vec4(color, 1.0);
+}
@@ -5,6 +5,10 @@
 #include "triangle.cpp"
 
 int main(int argc, char** argv) {
+    for (int i = 0; i < argc; i++) {
+        VulkanExample::args.push_back(argv[i]);
+    }
+
     SDL_Init(SDL_INIT_VIDEO);
 
     auto pWindow = SDL_CreateWindow("c2baVulkanTriangle", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 1280, 720, SDL_WINDOW_SHOWN);
@@ -14,17 +18,42 @@ int main(int argc, char** argv) {
     triangle.prepare();
     //triangle.renderLoop();
 
+    if (triangle.runFixedFrameBenchmark()) {
+        SDL_Quit();
+        return 0;
+    }
+
+    if (!triangle.capturePath.empty()) {
+        bool captured = triangle.runCapture();
+        SDL_Quit();
+        return captured ? 0 : 1;
+    }
+
+    if (triangle.runBenchmarks()) {
+        SDL_Quit();
+        return 0;
+    }
+
     auto done = false;
     while (!done) {
-        SDL_Event e;
-        while (SDL_PollEvent(&e)) {
-            switch (e.type) {
-            case SDL_QUIT:
-                done = true;
+        CPU_PROFILE_SCOPE("frame");
+        {
+            CPU_PROFILE_SCOPE("events");
+            SDL_Event e;
+            while (SDL_PollEvent(&e)) {
+                switch (e.type) {
+                case SDL_QUIT:
+                    done = true;
+                }
             }
         }
 
+        auto tStart = std::chrono::high_resolution_clock::now();
         triangle.render();
+        auto tEnd = std::chrono::high_resolution_clock::now();
+        // Animations follow the wall time, see the -benchmark argument for fixed time steps
+        triangle.advanceTimer(std::chrono::duration<float>(tEnd - tStart).count());
+        triangle.updateCpuProfile();
     }
 
     SDL_Quit();
@@ -17,11 +17,59 @@
 #include <assert.h>
 #include <vector>
 #include <iterator>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <map>
 
 #include <vulkan/vulkan.h>
 #include "vulkanexamplebase.h"
+#include "vulkanindirectdraw.hpp"
+#include "vulkanringbuffer.hpp"
+#include "vulkancommandstream.h"
+#include "vulkanpipelinecompiler.hpp"
+#include "vulkanpipelineregistry.hpp"
+#include "vulkanlayoutcache.hpp"
+#include "vulkandescriptorsetcache.hpp"
+#include "vulkanbindlesstable.hpp"
+#include "vulkandescriptorupdatetemplate.hpp"
+#include "vulkanoffscreentarget.hpp"
+#include "vulkanreadbackring.hpp"
+#include "vulkangoldenimage.hpp"
+#include "vulkanframetimes.hpp"
+#include "vulkanframecapture.hpp"
+#include "vulkanshaderreloader.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
+#define INSTANCE_BUFFER_BIND_ID 1
+// Number of triangle instances drawn when instancing is enabled
+#define INSTANCE_COUNT 64
+// Largest number of instances drawn by the instancing benchmark
+#define BENCHMARK_MAX_INSTANCE_COUNT 1000000
+// Largest number of draw calls recorded by the per-draw data benchmark
+#define BENCHMARK_MAX_DRAW_COUNT 100000
+// Number of draw calls of the workload captured by the command stream replay benchmark
+#define BENCHMARK_REPLAY_DRAW_COUNT 10000
+// Number of shader modules created by the shader loading benchmark
+#define BENCHMARK_SHADER_MODULE_COUNT 500
+// Number of descriptor sets updated by the descriptor update benchmark
+#define BENCHMARK_DESCRIPTOR_SET_COUNT 10000
+// Number of uniform buffer bindings of the sets updated by the descriptor update benchmark
+#define BENCHMARK_DESCRIPTOR_BINDING_COUNT 4
+// Number of offscreen frames rendered and read back by the readback benchmark
+#define BENCHMARK_READBACK_FRAME_COUNT 300
+// Number of slots of the readback ring used by the asynchronous mode of the readback benchmark
+#define BENCHMARK_READBACK_SLOT_COUNT 3
+// Number of frames rendered per scene by the golden image tests, the last one is compared
+#define GOLDEN_FRAME_COUNT 100
+// Largest fraction of pixels allowed to differ from the golden image by more than the tolerance
+#define GOLDEN_MAX_DIFFERING_FRACTION 0.001f
+// Number of readbacks in flight while capturing frames to disk
+#define CAPTURE_READBACK_SLOT_COUNT 3
+// Number of frames waiting for the capture writer thread before rendering waits for it
+#define CAPTURE_QUEUE_CAPACITY 8
+// Number of frames between two prints of the GPU profiler averages
+#define GPU_PROFILE_PRINT_INTERVAL 300
 // Note : 
 //	Enabling this define will feed GLSL directly to the driver
 //	Unlike the SDK samples that convert it to SPIR-V
@@ -36,6 +84,17 @@ static void setIdentity(float* matrix) {
     matrix[0] = matrix[5] = matrix[10] = matrix[15] = 1.f;
 }
 
+// Column major scale, rotation around z and translation in the xy plane
+static void setTransform2D(float* matrix, float x, float y, float scale, float angle) {
+    setIdentity(matrix);
+    matrix[0] = scale * cosf(angle);
+    matrix[1] = scale * sinf(angle);
+    matrix[4] = -scale * sinf(angle);
+    matrix[5] = scale * cosf(angle);
+    matrix[12] = x;
+    matrix[13] = y;
+}
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -65,13 +124,159 @@ public:
         float viewMatrix[16];
     } uboVS;
 
+	// Per-instance data, fetched through a vertex binding with VK_VERTEX_INPUT_RATE_INSTANCE
+	struct InstanceData {
+		float modelMatrix[16];
+		float color[4];
+	};
+
+	struct {
+		// One segment per swap chain image, updated before the matching command buffer is submitted
+		VulkanRingBuffer ring;
+		uint32_t count = 1;
+		VkPipelineVertexInputStateCreateInfo vi;
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+	} instances;
+
 	struct {
 		VkPipeline solid;
+		VkPipeline instanced = VK_NULL_HANDLE;
+		VkPipeline pushConstants = VK_NULL_HANDLE;
 	} pipelines;
 
+	// Per-draw data pushed before drawing when push constants are used
+	// Uses the same layout as the per-instance data
+	InstanceData pushConstants;
+	// Same as pipelineLayout with an additional push constant range for the per-draw data
+	VkPipelineLayout pushConstantPipelineLayout = VK_NULL_HANDLE;
+
+	// Resources of the per-draw data benchmark
+	struct {
+		// One aligned entry per draw
+		VulkanRingBuffer uniformBuffer;
+		VkDescriptorSetLayout dynamicSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout staticSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout dynamicPipelineLayout = VK_NULL_HANDLE;
+		VkPipelineLayout staticPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline dynamicPipeline = VK_NULL_HANDLE;
+		VkPipeline staticPipeline = VK_NULL_HANDLE;
+		VkDescriptorSet dynamicSet;
+		std::vector<VkDescriptorSet> staticSets;
+		// Bindless : the per-draw entries are storage buffers of the bindless table,
+		// indexed by a handle pushed for every draw (if descriptor indexing is supported)
+		VkPipelineLayout bindlessPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline bindlessPipeline = VK_NULL_HANDLE;
+		std::vector<uint32_t> bindlessHandles;
+	} perDrawBenchmark;
+
+	// Global table of resources referenced by handle, set 1 of the bindless pipelines
+	VulkanBindlessTable bindlessTable;
+
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
+	// Generates the layouts and vertex input from the shaders' SPIR-V and owns the layouts
+	VulkanLayoutCache layoutCache;
+	// Sets by layout and bound resources, allocated from the base class allocator
+	VulkanDescriptorSetCache descriptorSetCache;
+
+	// Compiles the pipeline variants on worker threads
+	// The solid pipeline is used as a placeholder until they are done
+	VulkanPipelineCompiler pipelineCompiler;
+	// Owns all pipelines, identical requests share the same pipeline
+	VulkanPipelineRegistry pipelineRegistry;
+	// Pipelines being compiled and the members they are stored in once done
+	std::vector<std::pair<std::shared_future<VkPipeline>, VkPipeline*>> pendingPipelines;
+	std::chrono::time_point<std::chrono::high_resolution_clock> pipelineCompileStart;
+	// Compile all pipelines on the main thread before rendering
+	// Enabled with the "-sync-pipelines" command line argument
+	bool syncPipelineCompilation = false;
+
+	// Render with the grayscale variant of the fragment shader (specialization constant)
+	// Enabled with the "-grayscale" command line argument
+	bool useGrayscale = false;
+	// Compile all variants of the fragment shader and report their compile times
+	// Enabled with the "-benchmark-variants" command line argument
+	bool benchmarkVariants = false;
+	// Compile time of each fragment shader variant, filled by createVariantPipelines
+	std::vector<std::pair<std::string, double>> variantCompileTimes;
+
+	// Use indirect draw commands stored in a buffer instead of direct draw calls
+	// Enabled with the "-indirect" command line argument
+	bool useIndirectDraw = false;
+	VulkanIndirectDrawBuffer indirectDraw;
+
+	// Draw INSTANCE_COUNT instances of the triangle in one call
+	// Enabled with the "-instancing" command line argument
+	bool useInstancing = false;
+	// Run the instance count scaling benchmark instead of the render loop
+	// Enabled with the "-benchmark-instancing" command line argument
+	bool benchmarkInstancing = false;
+
+	// Deliver the per-draw transform and color through push constants
+	// Enabled with the "-pushconstants" command line argument
+	bool usePushConstants = false;
+	// Run the push constants / dynamic uniform buffer / static uniform buffer / bindless benchmark
+	// Enabled with the "-benchmark-perdraw" command line argument
+	bool benchmarkPerDraw = false;
+
+	// Run the command stream capture / replay benchmark
+	// Enabled with the "-benchmark-replay" command line argument
+	bool benchmarkReplay = false;
+	// File the captured command stream is loaded from if it exists or saved to otherwise
+	// Set with the "-command-stream <file>" command line argument
+	std::string commandStreamFile;
+
+	// Reload shaders when their SPIR-V files change and rebuild the pipelines using them
+	// Enabled with the "-hot-reload" command line argument
+	bool hotReloadShaders = false;
+	VulkanShaderReloader shaderReloader;
+
+	// Compare shader module loading through a heap copy and through a memory mapping
+	// Enabled with the "-benchmark-shader-loading" command line argument
+	bool benchmarkShaderLoading = false;
+
+	// Compare descriptor set updates through write arrays and through update templates
+	// Enabled with the "-benchmark-descriptor-updates" command line argument
+	bool benchmarkDescriptorUpdates = false;
+
+	// Compare reading offscreen frames back after each frame and through a ring of in flight readbacks
+	// Enabled with the "-benchmark-readback" command line argument
+	bool benchmarkReadback = false;
+
+	// Render the scenes offscreen, compare them to the golden images and check their frame times
+	// Enabled with the "-golden <directory>" command line argument of the goldenTests target, the
+	// directory holds the golden images (<scene>.ppm) and the baseline frame times (timings.txt)
+	bool goldenTests = false;
+	std::string goldenDirectory;
+	// Directory receiving the report (report.json) and the images of the failed scenes (<scene>_failed.ppm)
+	// Set with the "-golden-output <directory>" command line argument, the working directory by default
+	std::string goldenOutputDirectory = ".";
+	// Write the golden images and baseline frame times with the results of this run instead of
+	// comparing to them, enabled with the "-golden-update" command line argument
+	bool goldenUpdate = false;
+	// Largest channel difference of a pixel considered equal to the golden image
+	// Set with the "-golden-tolerance <value>" command line argument
+	uint32_t goldenTolerance = 2;
+	// Largest increase of the median frame time over the baseline, in percent
+	// Set with the "-golden-max-regression <percent>" command line argument
+	double goldenMaxRegression = 20.0;
+
+	// Render frames offscreen and write every one of them to disk instead of running the window loop
+	// Enabled with the "-capture <path>" command line argument
+	std::string capturePath;
+	// Set with the "-capture-format <ppm|y4m|raw>" command line argument
+	VulkanFrameCapture::Format captureFormat = VulkanFrameCapture::PPM;
+	// Set with the "-capture-frames <count>" command line argument
+	uint32_t captureFrameCount = 300;
+
+	// Render target of the benchmarks, created by prepareBenchmark and destroyed by finishBenchmark
+	// The swap chain images are not used, they can't be rendered to without being acquired
+	VulkanOffscreenTarget benchmarkTarget;
+
+	// Frames rendered since the start, the GPU profiler averages are printed every GPU_PROFILE_PRINT_INTERVAL frames
+	uint64_t gpuProfileFrame = 0;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -79,6 +284,107 @@ public:
 		height = 720;
 		zoom = -2.5f;
 		title = "Vulkan Example - Basic indexed triangle";
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			std::string arg = args[i];
+			if (arg == std::string("-indirect"))
+			{
+				useIndirectDraw = true;
+			}
+			if (arg == std::string("-instancing"))
+			{
+				useInstancing = true;
+			}
+			if (arg == std::string("-benchmark-instancing"))
+			{
+				benchmarkInstancing = true;
+			}
+			if (arg == std::string("-pushconstants"))
+			{
+				usePushConstants = true;
+			}
+			if (arg == std::string("-benchmark-perdraw"))
+			{
+				benchmarkPerDraw = true;
+			}
+			if (arg == std::string("-sync-pipelines"))
+			{
+				syncPipelineCompilation = true;
+			}
+			if (arg == std::string("-grayscale"))
+			{
+				useGrayscale = true;
+			}
+			if (arg == std::string("-benchmark-variants"))
+			{
+				benchmarkVariants = true;
+			}
+			if (arg == std::string("-benchmark-replay"))
+			{
+				benchmarkReplay = true;
+			}
+			if (arg == std::string("-hot-reload"))
+			{
+				hotReloadShaders = true;
+			}
+			if (arg == std::string("-benchmark-shader-loading"))
+			{
+				benchmarkShaderLoading = true;
+			}
+			if (arg == std::string("-benchmark-descriptor-updates"))
+			{
+				benchmarkDescriptorUpdates = true;
+			}
+			if (arg == std::string("-benchmark-readback"))
+			{
+				benchmarkReadback = true;
+			}
+			if ((arg == std::string("-command-stream")) && (i + 1 < args.size()))
+			{
+				commandStreamFile = args[++i];
+			}
+			if ((arg == std::string("-golden")) && (i + 1 < args.size()))
+			{
+				goldenTests = true;
+				goldenDirectory = args[++i];
+			}
+			if ((arg == std::string("-golden-output")) && (i + 1 < args.size()))
+			{
+				goldenOutputDirectory = args[++i];
+			}
+			if (arg == std::string("-golden-update"))
+			{
+				goldenUpdate = true;
+			}
+			if ((arg == std::string("-golden-tolerance")) && (i + 1 < args.size()))
+			{
+				goldenTolerance = (uint32_t)atoi(args[++i]);
+			}
+			if ((arg == std::string("-golden-max-regression")) && (i + 1 < args.size()))
+			{
+				goldenMaxRegression = atof(args[++i]);
+			}
+			if ((arg == std::string("-capture")) && (i + 1 < args.size()))
+			{
+				capturePath = args[++i];
+			}
+			if ((arg == std::string("-capture-format")) && (i + 1 < args.size()))
+			{
+				if (!VulkanFrameCapture::parseFormat(args[++i], &captureFormat))
+				{
+					std::cout << "Unknown capture format " << args[i] << ", using ppm\n";
+				}
+			}
+			if ((arg == std::string("-capture-frames")) && (i + 1 < args.size()))
+			{
+				captureFrameCount = (uint32_t)atoi(args[++i]);
+			}
+		}
+		// The instanced and push constant paths use different vertex shaders
+		if (useInstancing)
+		{
+			usePushConstants = false;
+		}
 		// Values not set here are initialized in the base class constructor
 	}
 
@@ -86,10 +392,15 @@ public:
 	{
 		// Clean up used Vulkan resources 
 		// Note : Inherited destructor cleans up resources stored in base class
-		vkDestroyPipeline(device, pipelines.solid, nullptr);
+		// Stops watching the shader files and releases the modules it holds
+		shaderReloader.cleanup();
+		// Pipelines still compiling must be finished before they can be destroyed
+		pipelineCompiler.cleanup();
+		// Destroys all pipelines
+		pipelineRegistry.cleanup();
 
-		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		// Destroys the pipeline and descriptor set layouts generated from the shaders
+		layoutCache.cleanup();
 
 		vkDestroyBuffer(device, vertices.buf, nullptr);
 		vkFreeMemory(device, vertices.mem, nullptr);
@@ -97,8 +408,86 @@ public:
 		vkDestroyBuffer(device, indices.buf, nullptr);
 		vkFreeMemory(device, indices.mem, nullptr);
 
+		descriptorSetCache.unpin(descriptorSet);
+		descriptorSetCache.invalidateBuffer(uniformDataVS.buffer);
+		descriptorSetCache.cleanup();
 		vkDestroyBuffer(device, uniformDataVS.buffer, nullptr);
 		vkFreeMemory(device, uniformDataVS.memory, nullptr);
+
+		indirectDraw.cleanup();
+		instances.ring.cleanup();
+
+		vkDestroyPipelineLayout(device, perDrawBenchmark.dynamicPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, perDrawBenchmark.staticPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, perDrawBenchmark.dynamicSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, perDrawBenchmark.staticSetLayout, nullptr);
+		vkDestroyPipelineLayout(device, perDrawBenchmark.bindlessPipelineLayout, nullptr);
+		bindlessTable.cleanup();
+		perDrawBenchmark.uniformBuffer.cleanup();
+	}
+
+	// Record the scene into a command buffer inside a render pass compatible with renderPass
+	// instanceSegment selects the segment of the instance ring buffer used for instancing
+	void recordScene(VkCommandBuffer cmdBuffer, uint32_t instanceSegment)
+	{
+		// Update dynamic viewport state
+		VkViewport viewport = {};
+		viewport.height = (float)height;
+		viewport.width = (float)width;
+		viewport.minDepth = (float) 0.0f;
+		viewport.maxDepth = (float) 1.0f;
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+		// Update dynamic scissor state
+		VkRect2D scissor = {};
+		scissor.extent.width = width;
+		scissor.extent.height = height;
+		scissor.offset.x = 0;
+		scissor.offset.y = 0;
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		// Variant pipelines that are still being compiled are replaced by the solid pipeline
+		if (usePushConstants && (pipelines.pushConstants != VK_NULL_HANDLE))
+		{
+			// The descriptor set must be bound with a layout that has the same push constant ranges
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pushConstantPipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.pushConstants);
+			// Per-draw data is stored in the command buffer itself, no descriptor or buffer update needed
+			vkCmdPushConstants(cmdBuffer, pushConstantPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+		}
+		else
+		{
+			// Bind descriptor sets describing shader binding points
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+
+			// Bind the rendering pipeline (including the shaders)
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, (useInstancing && (pipelines.instanced != VK_NULL_HANDLE)) ? pipelines.instanced : pipelines.solid);
+		}
+
+		// Bind triangle vertices
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(cmdBuffer, VERTEX_BUFFER_BIND_ID, 1, &vertices.buf, offsets);
+
+		if (useInstancing)
+		{
+			// Bind the instance data segment used by this command buffer
+			VkDeviceSize instanceOffset = instances.ring.offset(instanceSegment);
+			vkCmdBindVertexBuffers(cmdBuffer, INSTANCE_BUFFER_BIND_ID, 1, &instances.ring.buffer, &instanceOffset);
+		}
+
+		// Bind triangle indices
+		vkCmdBindIndexBuffer(cmdBuffer, indices.buf, 0, VK_INDEX_TYPE_UINT32);
+
+		if (useIndirectDraw)
+		{
+			// Draw parameters are read from the indirect buffer
+			indirectDraw.draw(cmdBuffer);
+		}
+		else
+		{
+			// Draw indexed triangle
+			vkCmdDrawIndexed(cmdBuffer, indices.count, instances.count, 0, 0, useInstancing ? 0 : 1);
+		}
 	}
 
 	// Build separate command buffers for every framebuffer image
@@ -106,6 +495,7 @@ public:
 	// into command buffers that are then resubmitted to the queue
 	void buildCommandBuffers()
 	{
+		CPU_PROFILE_SCOPE("buildCommandBuffers");
 		VkCommandBufferBeginInfo cmdBufInfo = {};
 		cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 		cmdBufInfo.pNext = NULL;
@@ -135,42 +525,18 @@ public:
 			err = vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo);
 			assert(!err);
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			// Update dynamic viewport state
-			VkViewport viewport = {};
-			viewport.height = (float)height;
-			viewport.width = (float)width;
-			viewport.minDepth = (float) 0.0f;
-			viewport.maxDepth = (float) 1.0f;
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-			// Update dynamic scissor state
-			VkRect2D scissor = {};
-			scissor.extent.width = width;
-			scissor.extent.height = height;
-			scissor.offset.x = 0;
-			scissor.offset.y = 0;
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-			// Bind descriptor sets describing shader binding points
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+			// Each command buffer has its own profiler slot, as it may be in flight while another one is recorded
+			gpuProfiler.beginSlot(drawCmdBuffers[i], i);
+			uint32_t renderPassScope = gpuProfiler.begin(drawCmdBuffers[i], "render pass");
 
-			// Bind the rendering pipeline (including the shaders)
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid);
-
-			// Bind triangle vertices
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &vertices.buf, offsets);
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			// Bind triangle indices
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], indices.buf, 0, VK_INDEX_TYPE_UINT32);
-
-			// Draw indexed triangle
-			vkCmdDrawIndexed(drawCmdBuffers[i], indices.count, 1, 0, 0, 1);
+			recordScene(drawCmdBuffers[i], i);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			gpuProfiler.end(drawCmdBuffers[i], renderPassScope);
+
 			// Add a present memory barrier to the end of the command buffer
 			// This will transform the frame buffer color attachment to a
 			// new layout for presenting it to the windowing system integration 
@@ -203,6 +569,7 @@ public:
 
 	void draw()
 	{
+		CPU_PROFILE_SCOPE("draw");
 		VkResult err;
 		VkSemaphore presentCompleteSemaphore;
 		VkSemaphoreCreateInfo presentCompleteSemaphoreCreateInfo = {};
@@ -217,6 +584,11 @@ public:
 		err = swapChain.acquireNextImage(presentCompleteSemaphore, &currentBuffer);
 		assert(!err);
 
+		if (useInstancing)
+		{
+			updateInstanceData(currentBuffer);
+		}
+
 		// The submit infor strcuture contains a list of
 		// command buffers and semaphores to be submitted to a queue
 		// If you want to submit multiple command buffers, pass an array
@@ -227,9 +599,13 @@ public:
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
+		// Read the GPU times of the previous submission of this command buffer before its queries are reused
+		gpuProfiler.collect(currentBuffer);
+
 		// Submit to the graphics queue
 		err = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
 		assert(!err);
+		gpuProfiler.submitted(currentBuffer);
 
 		// Present the current buffer to the swap chain
 		// This will display the image
@@ -263,6 +639,11 @@ public:
 		err = vkBeginCommandBuffer(postPresentCmdBuffer, &cmdBufInfo);
 		assert(!err);
 
+		// The post present command buffer uses the profiler slot after the draw command buffers
+		uint32_t postPresentSlot = (uint32_t)drawCmdBuffers.size();
+		gpuProfiler.beginSlot(postPresentCmdBuffer, postPresentSlot);
+		uint32_t postPresentScope = gpuProfiler.begin(postPresentCmdBuffer, "post present barrier");
+
 		// Put post present barrier into command buffer
 		vkCmdPipelineBarrier(
 			postPresentCmdBuffer,
@@ -273,6 +654,8 @@ public:
 			0, nullptr,
 			1, &postPresentBarrier);
 
+		gpuProfiler.end(postPresentCmdBuffer, postPresentScope);
+
 		err = vkEndCommandBuffer(postPresentCmdBuffer);
 		assert(!err);
 
@@ -284,9 +667,10 @@ public:
 
 		err = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
 		assert(!err);
+		gpuProfiler.submitted(postPresentSlot);
 		
-		err = vkQueueWaitIdle(queue);
-		assert(!err);
+		// Also waits for the frame, counted as device time by the fixed frame benchmark
+		waitQueueIdle();
 	}
 
 	// Setups vertex and index buffers for an indexed triangle,
@@ -294,6 +678,7 @@ public:
 	// descriptions to match locations inside the shaders
 	void prepareVertices()
 	{
+		CPU_PROFILE_SCOPE("prepareVertices");
 		struct Vertex {
 			float pos[3];
 			float col[3];
@@ -371,27 +756,20 @@ public:
 		assert(!err);
 		indices.count = indexBuffer.size();
 
-		// Binding description
-		vertices.bindingDescriptions.resize(1);
-		vertices.bindingDescriptions[0].binding = VERTEX_BUFFER_BIND_ID;
-		vertices.bindingDescriptions[0].stride = sizeof(Vertex);
-		vertices.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
 		// Attribute descriptions
 		// Describes memory layout and shader attribute locations
-		vertices.attributeDescriptions.resize(2);
+		// Generated from the inputs of the vertex shader, interleaved in the order of their locations
 		// Location 0 : Position
-		vertices.attributeDescriptions[0].binding = VERTEX_BUFFER_BIND_ID;
-		vertices.attributeDescriptions[0].location = 0;
-		vertices.attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertices.attributeDescriptions[0].offset = 0;
-		vertices.attributeDescriptions[0].binding = 0;
 		// Location 1 : Color
-		vertices.attributeDescriptions[1].binding = VERTEX_BUFFER_BIND_ID;
-		vertices.attributeDescriptions[1].location = 1;
-		vertices.attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertices.attributeDescriptions[1].offset = sizeof(float) * 3;
-		vertices.attributeDescriptions[1].binding = 0;
+		const vkReflection::ShaderInterface &vertexShader = layoutCache.reflectFile("./../data/shaders/triangle.vert.spv");
+		uint32_t stride = vkReflection::interleavedVertexInput(vertexShader, VERTEX_BUFFER_BIND_ID, &vertices.attributeDescriptions);
+		assert(stride == sizeof(Vertex));
+
+		// Binding description
+		vertices.bindingDescriptions.resize(1);
+		vertices.bindingDescriptions[0].binding = VERTEX_BUFFER_BIND_ID;
+		vertices.bindingDescriptions[0].stride = stride;
+		vertices.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 		// Assign to vertex buffer
 		vertices.vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -402,32 +780,1185 @@ public:
 		vertices.vi.pVertexAttributeDescriptions = vertices.attributeDescriptions.data();
 	}
 
+	// Fill the indirect draw buffer with the draws of this example
+	// Later stages (e.g. GPU culling) can write to the same buffer
+	void prepareIndirectCommands()
+	{
+		indirectDraw.init(physicalDevice, device, enabledFeatures, drawIndirectCountEnabled);
+		indirectDraw.create(1);
+		// Same parameters as the direct draw
+		// A first instance other than 0 requires the drawIndirectFirstInstance feature
+		uint32_t firstInstance = (enabledFeatures.drawIndirectFirstInstance && !useInstancing) ? 1 : 0;
+		indirectDraw.add(indices.count, instances.count, 0, 0, firstInstance);
+	}
+
+	// Lay out count instances on a grid covering the viewport
+	// time rotates the instances
+	void fillInstanceData(InstanceData *data, uint32_t count, float time)
+	{
+		uint32_t gridSize = (uint32_t)ceilf(sqrtf((float)count));
+		float cellSize = 2.0f / gridSize;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float x = -1.0f + cellSize * (i % gridSize + 0.5f);
+			float y = -1.0f + cellSize * (i / gridSize + 0.5f);
+			setTransform2D(data[i].modelMatrix, x, y, cellSize * 0.4f, time * deg_to_rad(360.0f) + i * 0.1f);
+			data[i].color[0] = (float)((i >> 0) & 1) * 0.5f + 0.5f;
+			data[i].color[1] = (float)((i >> 1) & 1) * 0.5f + 0.5f;
+			data[i].color[2] = (float)((i >> 2) & 1) * 0.5f + 0.5f;
+			data[i].color[3] = 1.0f;
+		}
+	}
+
+	// Setup the per-instance vertex stream
+	// The instance buffer is a ring with one segment per swap chain image
+	void prepareInstancing()
+	{
+		// The golden image tests render an instanced scene
+		if (useInstancing || goldenTests)
+		{
+			instances.count = INSTANCE_COUNT;
+			instances.ring.init(physicalDevice, device);
+			// A single segment without swap chain
+			instances.ring.create(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, instances.count * sizeof(InstanceData), headless ? 1 : swapChain.imageCount);
+			for (uint32_t i = 0; i < instances.ring.segmentCount; i++)
+			{
+				fillInstanceData((InstanceData*)instances.ring.segment(i), instances.count, timer);
+			}
+		}
+
+		// Binding 0 : Per-vertex triangle data
+		// Binding 1 : Per-instance data, stepped once per instance
+		instances.bindingDescriptions = vertices.bindingDescriptions;
+		instances.bindingDescriptions.push_back(
+			vkTools::initializers::vertexInputBindingDescription(INSTANCE_BUFFER_BIND_ID, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE));
+
+		// Locations 0 and 1 are the same as for the non instanced triangle
+		instances.attributeDescriptions = vertices.attributeDescriptions;
+		// Location 2 - 5 : Model matrix (one location per column)
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			instances.attributeDescriptions.push_back(
+				vkTools::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 2 + column, VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(float) * 4 * column));
+		}
+		// Location 6 : Color
+		instances.attributeDescriptions.push_back(
+			vkTools::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 6, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, color)));
+
+		instances.vi = vkTools::initializers::pipelineVertexInputStateCreateInfo();
+		instances.vi.vertexBindingDescriptionCount = (uint32_t)instances.bindingDescriptions.size();
+		instances.vi.pVertexBindingDescriptions = instances.bindingDescriptions.data();
+		instances.vi.vertexAttributeDescriptionCount = (uint32_t)instances.attributeDescriptions.size();
+		instances.vi.pVertexAttributeDescriptions = instances.attributeDescriptions.data();
+	}
+
+	// Write this frame's instance data to the ring segment of the given swap chain image
+	void updateInstanceData(uint32_t frameIndex)
+	{
+		CPU_PROFILE_SCOPE("updateInstanceData");
+		fillInstanceData((InstanceData*)instances.ring.segment(frameIndex), instances.count, timer);
+	}
+
+	// Allocate the command buffer and fence used by the benchmarks and create their offscreen render target
+	void prepareBenchmark(VkCommandBuffer *cmdBuffer, VkFence *fence)
+	{
+		VkResult err;
+
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vkTools::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+		err = vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, cmdBuffer);
+		assert(!err);
+
+		VkFenceCreateInfo fenceCreateInfo = vkTools::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+		err = vkCreateFence(device, &fenceCreateInfo, nullptr, fence);
+		assert(!err);
+
+		benchmarkTarget.init(physicalDevice, device);
+		benchmarkTarget.create(width, height, colorformat, depthFormat);
+	}
+
+	// Free the objects created by prepareBenchmark, the benchmark's commands must have completed
+	void finishBenchmark(VkCommandBuffer cmdBuffer, VkFence fence)
+	{
+		vkDestroyFence(device, fence, nullptr);
+		vkFreeCommandBuffers(device, cmdPool, 1, &cmdBuffer);
+		benchmarkTarget.cleanup();
+	}
+
+	// Begin recording a benchmark command buffer and start the render pass with dynamic states set
+	void beginBenchmarkPass(VkCommandBuffer cmdBuffer)
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
+		VkResult err = vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo);
+		assert(!err);
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vkTools::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = benchmarkTarget.renderPass;
+		renderPassBeginInfo.framebuffer = benchmarkTarget.framebuffer;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = vkTools::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vkTools::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(cmdBuffer, VERTEX_BUFFER_BIND_ID, 1, &vertices.buf, offsets);
+		vkCmdBindIndexBuffer(cmdBuffer, indices.buf, 0, VK_INDEX_TYPE_UINT32);
+	}
+
+	// End the render pass, submit the command buffer and wait for it to complete
+	// Returns the time from submission to completion in milliseconds
+	double endBenchmarkPass(VkCommandBuffer cmdBuffer, VkFence fence)
+	{
+		VkResult err;
+
+		vkCmdEndRenderPass(cmdBuffer);
+		err = vkEndCommandBuffer(cmdBuffer);
+		assert(!err);
+
+		VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &cmdBuffer;
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+		err = vkQueueSubmit(queue, 1, &submitInfo, fence);
+		assert(!err);
+		err = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+		assert(!err);
+		auto tEnd = std::chrono::high_resolution_clock::now();
+
+		err = vkResetFences(device, 1, &fence);
+		assert(!err);
+
+		return std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+	}
+
+	// Draws 1 to BENCHMARK_MAX_INSTANCE_COUNT instances with a single instanced draw call
+	// and reports the average time from submission to completion for each instance count
+	void runInstancingBenchmark()
+	{
+		const uint32_t iterations = 10;
+
+		// Separate instance buffer large enough for the biggest run
+		VulkanRingBuffer benchmarkInstances;
+		benchmarkInstances.init(physicalDevice, device);
+		benchmarkInstances.create(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, BENCHMARK_MAX_INSTANCE_COUNT * sizeof(InstanceData), 1);
+
+		VkCommandBuffer cmdBuffer;
+		VkFence fence;
+		prepareBenchmark(&cmdBuffer, &fence);
+
+		std::cout << "Instancing benchmark (" << iterations << " iterations per instance count)\n";
+		std::cout << "instances\tavg ms\tinstances/s\n";
+
+		for (uint32_t count = 1; count <= BENCHMARK_MAX_INSTANCE_COUNT; count *= 10)
+		{
+			// Spread the instances over the whole viewport for every run
+			fillInstanceData((InstanceData*)benchmarkInstances.segment(0), count, 0.0f);
+
+			double totalTime = 0.0;
+			for (uint32_t iteration = 0; iteration < iterations; iteration++)
+			{
+				beginBenchmarkPass(cmdBuffer);
+				vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+				vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.instanced);
+				VkDeviceSize offsets[1] = { 0 };
+				vkCmdBindVertexBuffers(cmdBuffer, INSTANCE_BUFFER_BIND_ID, 1, &benchmarkInstances.buffer, offsets);
+				// All instances in one call
+				vkCmdDrawIndexed(cmdBuffer, indices.count, count, 0, 0, 0);
+				totalTime += endBenchmarkPass(cmdBuffer, fence);
+			}
+
+			double averageTime = totalTime / iterations;
+			std::cout << count << "\t" << averageTime << "\t" << (count / (averageTime / 1000.0)) << "\n";
+		}
+
+		finishBenchmark(cmdBuffer, fence);
+		benchmarkInstances.cleanup();
+	}
+
+	// Create the descriptor set and pipeline layouts used by the per-draw data benchmark
+	// Binding 0 : Per-frame uniform buffer (same as the triangle)
+	// Binding 1 : Per-draw uniform buffer, either dynamic (one set, offset per draw) or static (one set per draw)
+	void setupPerDrawBenchmarkLayouts()
+	{
+		VkResult err;
+		VkDescriptorType perDrawTypes[2] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER };
+		VkDescriptorSetLayout *setLayouts[2] = { &perDrawBenchmark.dynamicSetLayout, &perDrawBenchmark.staticSetLayout };
+		VkPipelineLayout *pipelineLayouts[2] = { &perDrawBenchmark.dynamicPipelineLayout, &perDrawBenchmark.staticPipelineLayout };
+
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings =
+			{
+				vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+				vkTools::initializers::descriptorSetLayoutBinding(perDrawTypes[i], VK_SHADER_STAGE_VERTEX_BIT, 1)
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorLayout =
+				vkTools::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), (uint32_t)setLayoutBindings.size());
+			err = vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, setLayouts[i]);
+			assert(!err);
+
+			VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vkTools::initializers::pipelineLayoutCreateInfo(setLayouts[i], 1);
+			err = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, pipelineLayouts[i]);
+			assert(!err);
+		}
+
+		// Bindless : set 0 is the triangle's set, set 1 the bindless table
+		// The handle of the per-draw entry is pushed for every draw
+		if (descriptorIndexingEnabled)
+		{
+			bindlessTable.init(device, 16, BENCHMARK_MAX_DRAW_COUNT);
+			VkDescriptorSetLayout bindlessSetLayouts[2] = { descriptorSetLayout, bindlessTable.setLayout };
+			VkPushConstantRange pushConstantRange = vkTools::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(uint32_t), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vkTools::initializers::pipelineLayoutCreateInfo(bindlessSetLayouts, 2);
+			pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+			pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+			err = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &perDrawBenchmark.bindlessPipelineLayout);
+			assert(!err);
+		}
+	}
+
+	// Fill the per-draw uniform buffer and allocate the descriptor sets of the per-draw data benchmark
+	void setupPerDrawBenchmarkDescriptors()
+	{
+		const uint32_t drawCount = BENCHMARK_MAX_DRAW_COUNT;
+
+		// One entry per draw, aligned so every entry can be used as a uniform buffer offset
+		// (and as a storage buffer offset for the bindless table)
+		perDrawBenchmark.uniformBuffer.init(physicalDevice, device);
+		perDrawBenchmark.uniformBuffer.create(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			sizeof(InstanceData),
+			drawCount,
+			std::max(deviceProperties.limits.minUniformBufferOffsetAlignment, deviceProperties.limits.minStorageBufferOffsetAlignment));
+		// Per-draw data uses the same layout as the per-instance data
+		std::vector<InstanceData> drawData(drawCount);
+		fillInstanceData(drawData.data(), drawCount, 0.0f);
+		for (uint32_t i = 0; i < drawCount; i++)
+		{
+			memcpy(perDrawBenchmark.uniformBuffer.segment(i), &drawData[i], sizeof(InstanceData));
+		}
+
+		VkDescriptorBufferInfo perDrawDescriptor = {};
+		perDrawDescriptor.buffer = perDrawBenchmark.uniformBuffer.buffer;
+		perDrawDescriptor.offset = 0;
+		perDrawDescriptor.range = sizeof(InstanceData);
+
+		// Dynamic : the offset of the per-draw entry is passed when binding the set
+		perDrawBenchmark.dynamicSet = descriptorAllocator.allocate(perDrawBenchmark.dynamicSetLayout);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
+		{
+			vkTools::initializers::writeDescriptorSet(perDrawBenchmark.dynamicSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformDataVS.descriptor),
+			vkTools::initializers::writeDescriptorSet(perDrawBenchmark.dynamicSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &perDrawDescriptor)
+		};
+		vkUpdateDescriptorSets(device, (uint32_t)writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+
+		// Static : every draw has its own set pointing at its entry
+		// The allocator adds pools as the draw count requires
+		perDrawBenchmark.staticSets.resize(drawCount);
+		descriptorAllocator.allocate(perDrawBenchmark.staticSetLayout, drawCount, perDrawBenchmark.staticSets.data());
+		// The sets are updated from one packed structure per draw
+		struct StaticDescriptors
+		{
+			VkDescriptorBufferInfo frame;
+			VkDescriptorBufferInfo perDraw;
+		};
+		std::vector<StaticDescriptors> staticDescriptors(drawCount, { uniformDataVS.descriptor, perDrawDescriptor });
+		for (uint32_t i = 0; i < drawCount; i++)
+		{
+			staticDescriptors[i].perDraw.offset = perDrawBenchmark.uniformBuffer.offset(i);
+		}
+		VulkanDescriptorUpdateTemplate staticUpdateTemplate;
+		staticUpdateTemplate.init(device, descriptorUpdateTemplateEnabled);
+		staticUpdateTemplate.create(perDrawBenchmark.staticSetLayout,
+		{
+			VulkanDescriptorUpdateTemplate::entry(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, offsetof(StaticDescriptors, frame)),
+			VulkanDescriptorUpdateTemplate::entry(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, offsetof(StaticDescriptors, perDraw))
+		});
+		staticUpdateTemplate.update(drawCount, perDrawBenchmark.staticSets.data(), staticDescriptors.data(), sizeof(StaticDescriptors));
+		staticUpdateTemplate.cleanup();
+		std::cout << "Descriptor sets : " << descriptorAllocator.stats.setsAllocated << " allocated from "
+			<< descriptorAllocator.poolCount() << " pools\n";
+
+		// Bindless : every entry is added to the table once, draws only refer to its handle
+		if (descriptorIndexingEnabled)
+		{
+			perDrawBenchmark.bindlessHandles.resize(drawCount);
+			for (uint32_t i = 0; i < drawCount; i++)
+			{
+				perDrawDescriptor.offset = perDrawBenchmark.uniformBuffer.offset(i);
+				perDrawBenchmark.bindlessHandles[i] = bindlessTable.addBuffer(perDrawDescriptor);
+			}
+			bindlessTable.update();
+			std::cout << "Bindless table : " << bindlessTable.stats.buffers << " buffers, "
+				<< bindlessTable.stats.descriptorsWritten << " descriptors in " << bindlessTable.stats.writes << " writes\n";
+		}
+	}
+
+	// Compares the ways of delivering per-draw data at high draw counts :
+	// push constants, one dynamic uniform buffer with an offset per draw, one static uniform buffer set per draw
+	// and, if descriptor indexing is supported, one bindless table bound once with a handle pushed per draw
+	// Reports the time spent recording on the CPU and the time from submission to completion
+	void runPerDrawBenchmark()
+	{
+		const uint32_t iterations = 10;
+		const char *modeNames[4] = { "push constants", "dynamic ubo", "static ubo", "bindless" };
+		const uint32_t modeCount = descriptorIndexingEnabled ? 4 : 3;
+
+		VkCommandBuffer cmdBuffer;
+		VkFence fence;
+		prepareBenchmark(&cmdBuffer, &fence);
+
+		std::vector<InstanceData> drawData(BENCHMARK_MAX_DRAW_COUNT);
+		fillInstanceData(drawData.data(), BENCHMARK_MAX_DRAW_COUNT, 0.0f);
+
+		std::cout << "Per-draw data benchmark (" << iterations << " iterations per draw count)\n";
+		std::cout << "mode\tdraws\trecord ms\tsubmit ms\tdraws/s\n";
+
+		for (uint32_t drawCount = 1000; drawCount <= BENCHMARK_MAX_DRAW_COUNT; drawCount *= 10)
+		{
+			for (uint32_t mode = 0; mode < modeCount; mode++)
+			{
+				double recordTime = 0.0;
+				double submitTime = 0.0;
+				for (uint32_t iteration = 0; iteration < iterations; iteration++)
+				{
+					auto tStart = std::chrono::high_resolution_clock::now();
+					beginBenchmarkPass(cmdBuffer);
+					switch (mode)
+					{
+					case 0:
+						vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pushConstantPipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+						vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.pushConstants);
+						for (uint32_t i = 0; i < drawCount; i++)
+						{
+							vkCmdPushConstants(cmdBuffer, pushConstantPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(InstanceData), &drawData[i]);
+							vkCmdDrawIndexed(cmdBuffer, indices.count, 1, 0, 0, 0);
+						}
+						break;
+					case 1:
+						vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perDrawBenchmark.dynamicPipeline);
+						for (uint32_t i = 0; i < drawCount; i++)
+						{
+							uint32_t dynamicOffset = (uint32_t)perDrawBenchmark.uniformBuffer.offset(i);
+							vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perDrawBenchmark.dynamicPipelineLayout, 0, 1, &perDrawBenchmark.dynamicSet, 1, &dynamicOffset);
+							vkCmdDrawIndexed(cmdBuffer, indices.count, 1, 0, 0, 0);
+						}
+						break;
+					case 2:
+						vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perDrawBenchmark.staticPipeline);
+						for (uint32_t i = 0; i < drawCount; i++)
+						{
+							vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perDrawBenchmark.staticPipelineLayout, 0, 1, &perDrawBenchmark.staticSets[i], 0, NULL);
+							vkCmdDrawIndexed(cmdBuffer, indices.count, 1, 0, 0, 0);
+						}
+						break;
+					case 3:
+						// Both sets are bound once for all draws
+						vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perDrawBenchmark.bindlessPipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+						bindlessTable.bind(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perDrawBenchmark.bindlessPipelineLayout, 1);
+						vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perDrawBenchmark.bindlessPipeline);
+						for (uint32_t i = 0; i < drawCount; i++)
+						{
+							vkCmdPushConstants(cmdBuffer, perDrawBenchmark.bindlessPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &perDrawBenchmark.bindlessHandles[i]);
+							vkCmdDrawIndexed(cmdBuffer, indices.count, 1, 0, 0, 0);
+						}
+						break;
+					}
+					auto tEnd = std::chrono::high_resolution_clock::now();
+					recordTime += std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+					submitTime += endBenchmarkPass(cmdBuffer, fence);
+				}
+				recordTime /= iterations;
+				submitTime /= iterations;
+				std::cout << modeNames[mode] << "\t" << drawCount << "\t" << recordTime << "\t" << submitTime << "\t" << (drawCount / ((recordTime + submitTime) / 1000.0)) << "\n";
+			}
+		}
+
+		finishBenchmark(cmdBuffer, fence);
+	}
+
+	// Record a repeatable workload through the command recorder
+	// Every draw gets its own viewport on a grid so the stream contains state changes between draws
+	// Named objects can be rebound when the stream is replayed by another process
+	void recordReplayWorkload(VulkanCommandRecorder &recorder, uint32_t drawCount)
+	{
+		recorder.registerObject(vkCommandStream::OBJECT_RENDER_PASS, (uint64_t)benchmarkTarget.renderPass, "renderPass");
+		recorder.registerObject(vkCommandStream::OBJECT_FRAMEBUFFER, (uint64_t)benchmarkTarget.framebuffer, "frameBuffer");
+		recorder.registerObject(vkCommandStream::OBJECT_PIPELINE, (uint64_t)pipelines.solid, "pipeline");
+		recorder.registerObject(vkCommandStream::OBJECT_PIPELINE_LAYOUT, (uint64_t)pipelineLayout, "pipelineLayout");
+		recorder.registerObject(vkCommandStream::OBJECT_DESCRIPTOR_SET, (uint64_t)descriptorSet, "descriptorSet");
+		recorder.registerObject(vkCommandStream::OBJECT_BUFFER, (uint64_t)vertices.buf, "vertexBuffer");
+		recorder.registerObject(vkCommandStream::OBJECT_BUFFER, (uint64_t)indices.buf, "indexBuffer");
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vkTools::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = benchmarkTarget.renderPass;
+		renderPassBeginInfo.framebuffer = benchmarkTarget.framebuffer;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		recorder.beginRenderPass(&renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkRect2D scissor = vkTools::initializers::rect2D(width, height, 0, 0);
+		recorder.setScissor(0, 1, &scissor);
+		recorder.bindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+		recorder.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid);
+		VkDeviceSize offsets[1] = { 0 };
+		recorder.bindVertexBuffers(VERTEX_BUFFER_BIND_ID, 1, &vertices.buf, offsets);
+		recorder.bindIndexBuffer(indices.buf, 0, VK_INDEX_TYPE_UINT32);
+
+		uint32_t gridSize = (uint32_t)ceilf(sqrtf((float)drawCount));
+		float cellWidth = (float)width / gridSize;
+		float cellHeight = (float)height / gridSize;
+		for (uint32_t i = 0; i < drawCount; i++)
+		{
+			VkViewport viewport = vkTools::initializers::viewport(cellWidth, cellHeight, 0.0f, 1.0f);
+			viewport.x = cellWidth * (i % gridSize);
+			viewport.y = cellHeight * (i / gridSize);
+			recorder.setViewport(0, 1, &viewport);
+			recorder.drawIndexed(indices.count, 1, 0, 0, 1);
+		}
+
+		recorder.endRenderPass();
+	}
+
+	// Captures a workload into a command stream (or loads it from commandStreamFile)
+	// and compares the time needed to encode it directly and to replay it into a command buffer
+	// Reports the encode time, commands/s and the stream bandwidth
+	void runReplayBenchmark()
+	{
+		const uint32_t iterations = 10;
+		VkResult err;
+
+		VkCommandBuffer cmdBuffer;
+		VkFence fence;
+		prepareBenchmark(&cmdBuffer, &fence);
+
+		VulkanCommandStream stream;
+		VulkanCommandRecorder recorder;
+		bool loaded = !commandStreamFile.empty() && stream.load(commandStreamFile);
+		if (!loaded)
+		{
+			recorder.begin(&stream);
+			recordReplayWorkload(recorder, BENCHMARK_REPLAY_DRAW_COUNT);
+			recorder.end();
+			if (!commandStreamFile.empty() && !stream.save(commandStreamFile))
+			{
+				std::cout << "Could not save command stream to " << commandStreamFile << "\n";
+			}
+		}
+
+		// Objects are bound by name so streams captured by another run can be replayed
+		VulkanCommandReplayer replayer;
+		replayer.init(&stream);
+		replayer.setObject("renderPass", (uint64_t)benchmarkTarget.renderPass);
+		replayer.setObject("frameBuffer", (uint64_t)benchmarkTarget.framebuffer);
+		replayer.setObject("pipeline", (uint64_t)pipelines.solid);
+		replayer.setObject("pipelineLayout", (uint64_t)pipelineLayout);
+		replayer.setObject("descriptorSet", (uint64_t)descriptorSet);
+		replayer.setObject("vertexBuffer", (uint64_t)vertices.buf);
+		replayer.setObject("indexBuffer", (uint64_t)indices.buf);
+		if (!replayer.validate())
+		{
+			std::cout << "Command stream" << (loaded ? " " + commandStreamFile : "") << " is corrupt or references objects of this example that are not bound\n";
+			finishBenchmark(cmdBuffer, fence);
+			return;
+		}
+
+		std::cout << "Command stream replay benchmark (" << iterations << " iterations, "
+			<< stream.commandCount << " commands, " << stream.data.size() << " bytes"
+			<< (loaded ? ", loaded from " + commandStreamFile : "") << ")\n";
+		std::cout << "mode\tencode ms\tcommands/s\tMB/s\n";
+
+		VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
+		const char *modeNames[3] = { "direct", "capture", "replay" };
+		for (uint32_t mode = 0; mode < 3; mode++)
+		{
+			// Direct encoding is only available for the built-in workload
+			if (loaded && mode < 2)
+			{
+				continue;
+			}
+
+			VulkanCommandStream captureStream;
+			double encodeTime = 0.0;
+			for (uint32_t iteration = 0; iteration < iterations; iteration++)
+			{
+				err = vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo);
+				assert(!err);
+				auto tStart = std::chrono::high_resolution_clock::now();
+				switch (mode)
+				{
+				case 0:
+					// Same workload as the stream, only forwarded to the command buffer
+					recorder.begin(nullptr, cmdBuffer);
+					recordReplayWorkload(recorder, BENCHMARK_REPLAY_DRAW_COUNT);
+					recorder.end();
+					break;
+				case 1:
+					// Recording into the stream while encoding
+					recorder.begin(&captureStream, cmdBuffer);
+					recordReplayWorkload(recorder, BENCHMARK_REPLAY_DRAW_COUNT);
+					recorder.end();
+					break;
+				case 2:
+					// Can't fail, the stream has been validated above
+					replayer.replay(cmdBuffer);
+					break;
+				}
+				auto tEnd = std::chrono::high_resolution_clock::now();
+				encodeTime += std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+				err = vkEndCommandBuffer(cmdBuffer);
+				assert(!err);
+			}
+			encodeTime /= iterations;
+			std::cout << modeNames[mode] << "\t" << encodeTime << "\t" << (stream.commandCount / (encodeTime / 1000.0))
+				<< "\t" << (stream.data.size() / (1024.0 * 1024.0) / (encodeTime / 1000.0)) << "\n";
+		}
+
+		// Make sure the replayed commands are valid by executing them once
+		err = vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo);
+		assert(!err);
+		replayer.replay(cmdBuffer);
+		err = vkEndCommandBuffer(cmdBuffer);
+		assert(!err);
+		VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &cmdBuffer;
+		err = vkQueueSubmit(queue, 1, &submitInfo, fence);
+		assert(!err);
+		err = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+		assert(!err);
+
+		finishBenchmark(cmdBuffer, fence);
+	}
+
+	// Creates BENCHMARK_SHADER_MODULE_COUNT shader modules from the shaders of this example,
+	// reading the code into a heap buffer (previous loader), handing it from a memory mapping
+	// of each file and from the shader archive (if found)
+	// Reports the load time (file access + module creation) and the amount of code read per second
+	void runShaderLoadingBenchmark()
+	{
+		const char *shaderFiles[] =
+		{
+			"./../data/shaders/triangle.vert.spv",
+			"./../data/shaders/triangle.frag.spv",
+			"./../data/shaders/instancing.vert.spv",
+			"./../data/shaders/pushconstants.vert.spv",
+			"./../data/shaders/perdrawubo.vert.spv",
+			"./../data/shaders/variants.frag.spv"
+		};
+		const uint32_t shaderFileCount = sizeof(shaderFiles) / sizeof(shaderFiles[0]);
+
+		std::vector<VkShaderModule> modules(BENCHMARK_SHADER_MODULE_COUNT);
+
+		std::cout << "Shader loading benchmark (" << BENCHMARK_SHADER_MODULE_COUNT << " modules from " << shaderFileCount << " files)\n";
+		std::cout << "mode\tms\tus/module\tMB/s\n";
+
+		const char *modeNames[3] = { "copy", "mapped", "archive" };
+		for (uint32_t mode = 0; mode < 3; mode++)
+		{
+			if ((mode == 2) && !shaderArchive.isOpen())
+			{
+				continue;
+			}
+			size_t totalSize = 0;
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < BENCHMARK_SHADER_MODULE_COUNT; i++)
+			{
+				const char *fileName = shaderFiles[i % shaderFileCount];
+				if (mode == 0)
+				{
+					size_t size = 0;
+					char *code = vkTools::readBinaryFile(fileName, &size);
+					assert(code != nullptr);
+					modules[i] = vkTools::createShaderModule((const uint32_t*)code, size, device);
+					free(code);
+					totalSize += size;
+				}
+				else if (mode == 1)
+				{
+					VulkanMappedFile file(fileName);
+					assert(file.isSpirv());
+					modules[i] = vkTools::createShaderModule((const uint32_t*)file.data(), file.size(), device);
+					totalSize += file.size();
+				}
+				else
+				{
+					size_t size = 0;
+					const uint32_t *code = shaderArchive.find(VulkanShaderArchive::shaderName(fileName), &size);
+					assert(code != nullptr);
+					modules[i] = vkTools::createShaderModule(code, size, device);
+					totalSize += size;
+				}
+			}
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			double loadTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+
+			for (auto& module : modules)
+			{
+				vkDestroyShaderModule(device, module, nullptr);
+			}
+
+			std::cout << modeNames[mode] << "\t" << loadTime << "\t" << (loadTime * 1000.0 / BENCHMARK_SHADER_MODULE_COUNT)
+				<< "\t" << (totalSize / (1024.0 * 1024.0) / (loadTime / 1000.0)) << "\n";
+		}
+	}
+
+	// Updates BENCHMARK_DESCRIPTOR_SET_COUNT sets of BENCHMARK_DESCRIPTOR_BINDING_COUNT uniform buffers each,
+	// with one vkUpdateDescriptorSets call per set (hand-built writes), with the writes of all sets
+	// batched into one call and, if supported, with a descriptor update template
+	// Reports the update time and the number of sets updated per second
+	void runDescriptorUpdateBenchmark()
+	{
+		const uint32_t iterations = 10;
+		const uint32_t setCount = BENCHMARK_DESCRIPTOR_SET_COUNT;
+		const char *modeNames[3] = { "write per set", "batched writes", "template" };
+		const uint32_t modeCount = descriptorUpdateTemplateEnabled ? 3 : 2;
+		VkResult err;
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings;
+		for (uint32_t binding = 0; binding < BENCHMARK_DESCRIPTOR_BINDING_COUNT; binding++)
+		{
+			setLayoutBindings.push_back(vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, binding));
+		}
+		VkDescriptorSetLayoutCreateInfo descriptorLayout =
+			vkTools::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), (uint32_t)setLayoutBindings.size());
+		VkDescriptorSetLayout setLayout;
+		err = vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &setLayout);
+		assert(!err);
+
+		// The sets are released all at once with their allocator
+		VulkanDescriptorAllocator allocator;
+		allocator.init(device, { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, (float)BENCHMARK_DESCRIPTOR_BINDING_COUNT } }, 1024);
+		std::vector<VkDescriptorSet> sets(setCount);
+		allocator.allocate(setLayout, setCount, sets.data());
+
+		// One packed structure per set
+		struct SetDescriptors
+		{
+			VkDescriptorBufferInfo buffers[BENCHMARK_DESCRIPTOR_BINDING_COUNT];
+		};
+		SetDescriptors setDescriptors;
+		std::fill(setDescriptors.buffers, setDescriptors.buffers + BENCHMARK_DESCRIPTOR_BINDING_COUNT, uniformDataVS.descriptor);
+		std::vector<SetDescriptors> descriptors(setCount, setDescriptors);
+
+		std::cout << "Descriptor update benchmark (" << setCount << " sets of " << BENCHMARK_DESCRIPTOR_BINDING_COUNT
+			<< " uniform buffers, " << iterations << " iterations)\n";
+		std::cout << "mode\tms\tsets/s\tdescriptors/s\n";
+
+		for (uint32_t mode = 0; mode < modeCount; mode++)
+		{
+			// Batched writes use the fallback path of the template class
+			VulkanDescriptorUpdateTemplate updateTemplate;
+			updateTemplate.init(device, mode == 2);
+			// The bindings are identical, so one entry covers all of them (writes roll over to the next binding)
+			updateTemplate.create(setLayout,
+			{
+				VulkanDescriptorUpdateTemplate::entry(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, offsetof(SetDescriptors, buffers), BENCHMARK_DESCRIPTOR_BINDING_COUNT)
+			});
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t iteration = 0; iteration < iterations; iteration++)
+			{
+				if (mode == 0)
+				{
+					for (uint32_t i = 0; i < setCount; i++)
+					{
+						VkWriteDescriptorSet writeDescriptorSets[BENCHMARK_DESCRIPTOR_BINDING_COUNT];
+						for (uint32_t binding = 0; binding < BENCHMARK_DESCRIPTOR_BINDING_COUNT; binding++)
+						{
+							writeDescriptorSets[binding] =
+								vkTools::initializers::writeDescriptorSet(sets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, binding, &descriptors[i].buffers[binding]);
+						}
+						vkUpdateDescriptorSets(device, BENCHMARK_DESCRIPTOR_BINDING_COUNT, writeDescriptorSets, 0, NULL);
+					}
+				}
+				else
+				{
+					updateTemplate.update(setCount, sets.data(), descriptors.data(), sizeof(SetDescriptors));
+				}
+			}
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			updateTemplate.cleanup();
+
+			double updateTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count() / iterations;
+			double setsPerSecond = setCount / (updateTime / 1000.0);
+			std::cout << modeNames[mode] << "\t" << updateTime << "\t" << setsPerSecond << "\t"
+				<< setsPerSecond * BENCHMARK_DESCRIPTOR_BINDING_COUNT << "\n";
+		}
+
+		allocator.cleanup();
+		vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	}
+
+	// Renders BENCHMARK_READBACK_FRAME_COUNT frames of the scene into an offscreen target and reads
+	// their color and depth back, once waiting for each frame before rendering the next one and
+	// once with a ring of BENCHMARK_READBACK_SLOT_COUNT readbacks in flight, where the host reads
+	// a frame while the following ones are being rendered
+	// Reports the number of frames read back per second and the readback throughput
+	void runReadbackBenchmark()
+	{
+		const uint32_t frameCount = BENCHMARK_READBACK_FRAME_COUNT;
+		const char *modeNames[2] = { "sync", "async ring" };
+		const uint32_t slotCounts[2] = { 1, BENCHMARK_READBACK_SLOT_COUNT };
+
+		// Same formats as the swap chain render pass, so the scene pipelines can be used
+		VulkanOffscreenTarget target;
+		target.init(physicalDevice, device);
+		target.create(width, height, colorformat, depthFormat);
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		VkRenderPassBeginInfo renderPassBeginInfo = vkTools::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = target.renderPass;
+		renderPassBeginInfo.framebuffer = target.framebuffer;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		std::cout << "Readback benchmark (" << frameCount << " frames of " << width << "x" << height << ")\n";
+		std::cout << "mode\tslots\tms\tframes/s\tMB/s\tskipped\n";
+
+		for (uint32_t mode = 0; mode < 2; mode++)
+		{
+			VulkanReadbackRing ring;
+			ring.init(physicalDevice, device, cmdPool, queue);
+			ring.create(&target, slotCounts[mode]);
+			// Frames are read lag frames after being submitted
+			const uint32_t lag = ring.slotCount() - 1;
+
+			// Touch every read byte so the cost of reading the memory is measured
+			uint32_t checksum = 0;
+			VulkanReadbackRing::Readback readback;
+			auto consume = [&]()
+			{
+				for (uint32_t i = 0; i < readback.width * readback.height; i++)
+				{
+					checksum += readback.color[i * 4];
+				}
+				checksum += readback.depth[0];
+			};
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint64_t frame = 0; frame < frameCount; frame++)
+			{
+				// Free the slot of the frame by reading the frame submitted slotCount - 1 frames earlier
+				// With a single slot the frame is read once it has been submitted (below)
+				if ((lag > 0) && (frame >= lag))
+				{
+					if (ring.readback(frame - lag, &readback) || ring.wait(frame - lag, &readback))
+					{
+						consume();
+					}
+				}
+
+				VkCommandBuffer cmdBuffer = ring.beginFrame(frame);
+				assert(cmdBuffer != VK_NULL_HANDLE);
+				vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				recordScene(cmdBuffer, 0);
+				vkCmdEndRenderPass(cmdBuffer);
+				ring.endFrame();
+
+				if ((lag == 0) && ring.wait(frame, &readback))
+				{
+					consume();
+				}
+			}
+			for (uint64_t frame = frameCount - lag; frame < frameCount; frame++)
+			{
+				if (ring.wait(frame, &readback))
+				{
+					consume();
+				}
+			}
+			auto tEnd = std::chrono::high_resolution_clock::now();
+
+			double totalTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			std::cout << modeNames[mode] << "\t" << ring.slotCount() << "\t" << totalTime << "\t" << (ring.stats.framesRead / (totalTime / 1000.0))
+				<< "\t" << (ring.stats.bytesRead / (1024.0 * 1024.0) / (totalTime / 1000.0)) << "\t" << ring.stats.framesSkipped
+				<< "\t(checksum " << checksum << ")\n";
+			ring.cleanup();
+		}
+
+		target.cleanup();
+	}
+
+	// Scene rendered by the golden image tests
+	struct GoldenScene
+	{
+		const char *name;
+		bool instancing;
+		bool pushConstants;
+	};
+
+	// Baseline median frame times by scene name, one "<scene> <median ms>" line per scene
+	// Lines starting with # are comments
+	// Returns false if the file can't be read or a line is malformed
+	static bool loadGoldenTimings(const std::string &fileName, std::map<std::string, double> *timings)
+	{
+		std::ifstream file(fileName);
+		if (!file)
+		{
+			return false;
+		}
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() || (line[0] == '#'))
+			{
+				continue;
+			}
+			std::istringstream fields(line);
+			std::string scene;
+			double median;
+			if (!(fields >> scene >> median) || (median <= 0.0))
+			{
+				return false;
+			}
+			(*timings)[scene] = median;
+		}
+		return true;
+	}
+
+	static bool saveGoldenTimings(const std::string &fileName, const std::map<std::string, double> &timings)
+	{
+		std::ofstream file(fileName);
+		file << "# Baseline median frame time of each golden image test scene in milliseconds\n";
+		for (auto& timing : timings)
+		{
+			file << timing.first << " " << timing.second << "\n";
+		}
+		return (bool)file;
+	}
+
+	// Renders each scene GOLDEN_FRAME_COUNT times into an offscreen target, waiting for the readback of
+	// every frame, and compares the color of the last frame to the golden image of the scene
+	// The median frame time of each scene is compared to the baseline in timings.txt, frame times
+	// are only reported for the scenes without baseline
+	// A missing golden image fails the scene, "-golden-update" writes the golden images and baselines instead
+	// Writes report.json and returns false if a scene differs from its golden image or got slower
+	// Note : The scenes don't depend on the window, a software implementation (e.g. lavapipe selected
+	// with VK_ICD_FILENAMES) renders the same images within the tolerance
+	bool runGoldenTests()
+	{
+		// The scenes need the actual pipelines, not placeholders
+		resolvePendingPipelines(true);
+		setupContext.waitAll();
+
+		const GoldenScene scenes[] =
+		{
+			{ "triangle", false, false },
+			{ "instancing", true, false },
+			{ "pushconstants", false, true },
+		};
+
+		bool passed = true;
+		std::string baselineFile = goldenDirectory + "/timings.txt";
+		std::map<std::string, double> baseline;
+		if (!goldenUpdate)
+		{
+			if (!std::ifstream(baselineFile))
+			{
+				std::cout << "No baseline frame times (" << baselineFile << "), frame times are only reported\n";
+			}
+			else if (!loadGoldenTimings(baselineFile, &baseline))
+			{
+				std::cout << "Malformed baseline frame times " << baselineFile << "\n";
+				baseline.clear();
+				passed = false;
+			}
+		}
+		std::map<std::string, double> timings;
+
+		VulkanOffscreenTarget target;
+		target.init(physicalDevice, device);
+		target.create(width, height, colorformat, depthFormat);
+		// A single slot, each frame is read back before the next one is rendered
+		VulkanReadbackRing ring;
+		ring.init(physicalDevice, device, cmdPool, queue);
+		ring.create(&target, 1);
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		VkRenderPassBeginInfo renderPassBeginInfo = vkTools::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = target.renderPass;
+		renderPassBeginInfo.framebuffer = target.framebuffer;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		// The scenes are selected through the same members as the command line arguments
+		bool savedInstancing = useInstancing;
+		bool savedPushConstants = usePushConstants;
+		bool savedIndirectDraw = useIndirectDraw;
+		uint32_t savedInstanceCount = instances.count;
+
+		uint64_t frame = 0;
+		std::stringstream report;
+		report << "{\n\"scenes\": [\n";
+		std::cout << "Golden image tests (" << width << "x" << height << ", " << GOLDEN_FRAME_COUNT << " frames per scene)\n";
+		std::cout << "scene\timage\tdiffering\tmedian ms\tbaseline ms\ttiming\n";
+
+		for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++)
+		{
+			const GoldenScene &scene = scenes[i];
+			useInstancing = scene.instancing;
+			usePushConstants = scene.pushConstants;
+			useIndirectDraw = false;
+			instances.count = scene.instancing ? INSTANCE_COUNT : 1;
+			if (scene.instancing)
+			{
+				// Same instance transforms in every run
+				fillInstanceData((InstanceData*)instances.ring.segment(0), instances.count, 0.0f);
+			}
+
+			VulkanFrameTimes frameTimes;
+			VulkanReadbackRing::Readback readback;
+			for (uint32_t sceneFrame = 0; sceneFrame < GOLDEN_FRAME_COUNT; sceneFrame++, frame++)
+			{
+				auto tStart = std::chrono::high_resolution_clock::now();
+				VkCommandBuffer cmdBuffer = ring.beginFrame(frame);
+				assert(cmdBuffer != VK_NULL_HANDLE);
+				vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				recordScene(cmdBuffer, 0);
+				vkCmdEndRenderPass(cmdBuffer);
+				ring.endFrame();
+				ring.wait(frame, &readback);
+				auto tEnd = std::chrono::high_resolution_clock::now();
+				frameTimes.add(std::chrono::duration<double, std::milli>(tEnd - tStart).count());
+			}
+
+			VulkanGoldenImage image;
+			if (!image.fromPixels(readback.color, readback.width, readback.height, colorformat))
+			{
+				vkTools::exitFatal("Golden image tests need an 8 bit RGBA or BGRA color format", "Fatal error");
+			}
+			std::string imageFile = goldenDirectory + "/" + scene.name + ".ppm";
+			VulkanGoldenImage golden;
+			std::string imageStatus;
+			VulkanGoldenImage::Comparison comparison;
+			if (goldenUpdate)
+			{
+				imageStatus = image.save(imageFile) ? "updated" : "not saved";
+				passed = passed && (imageStatus == "updated");
+			}
+			else if (!golden.load(imageFile))
+			{
+				// Copy it to the golden directory as <scene>.ppm to accept it
+				image.save(goldenOutputDirectory + "/" + scene.name + "_failed.ppm");
+				imageStatus = "missing";
+				passed = false;
+			}
+			else
+			{
+				comparison = image.compare(golden, goldenTolerance);
+				bool imagePassed = comparison.sameSize && (comparison.differingFraction <= GOLDEN_MAX_DIFFERING_FRACTION);
+				imageStatus = imagePassed ? "passed" : "failed";
+				if (!imagePassed)
+				{
+					// Kept for inspection
+					image.save(goldenOutputDirectory + "/" + scene.name + "_failed.ppm");
+					passed = false;
+				}
+			}
+
+			VulkanFrameTimes::Summary summary = frameTimes.summary();
+			timings[scene.name] = summary.median;
+			auto baselineTiming = baseline.find(scene.name);
+			double baselineMedian = baselineTiming != baseline.end() ? baselineTiming->second : 0.0;
+			std::string timingStatus;
+			if (goldenUpdate)
+			{
+				timingStatus = "updated";
+			}
+			else if (baselineTiming == baseline.end())
+			{
+				timingStatus = "no baseline";
+			}
+			else
+			{
+				bool timingPassed = summary.median <= baselineMedian * (1.0 + goldenMaxRegression / 100.0);
+				timingStatus = timingPassed ? "passed" : "regressed";
+				passed = passed && timingPassed;
+			}
+
+			report << "{ \"name\": \"" << scene.name << "\", \"image\": \"" << imageStatus << "\""
+				<< ", \"differing_pixels\": " << comparison.differingPixels << ", \"max_difference\": " << comparison.maxDifference << ", ";
+			VulkanFrameTimes::writeJson(report, summary);
+			report << ", \"baseline_median_ms\": " << baselineMedian << ", \"timing\": \"" << timingStatus << "\" }"
+				<< ((i + 1 < sizeof(scenes) / sizeof(scenes[0])) ? ",\n" : "\n");
+			std::cout << scene.name << "\t" << imageStatus << "\t" << comparison.differingPixels << "\t" << summary.median
+				<< "\t" << baselineMedian << "\t" << timingStatus << "\n";
+		}
+		report << "],\n\"passed\": " << (passed ? "true" : "false") << "\n}\n";
+
+		useInstancing = savedInstancing;
+		usePushConstants = savedPushConstants;
+		useIndirectDraw = savedIndirectDraw;
+		instances.count = savedInstanceCount;
+		ring.cleanup();
+		target.cleanup();
+
+		std::ofstream(goldenOutputDirectory + "/report.json") << report.str();
+		if (goldenUpdate && !saveGoldenTimings(baselineFile, timings))
+		{
+			std::cout << "Could not write " << baselineFile << "\n";
+			passed = false;
+		}
+		std::cout << "Golden image tests " << (passed ? "passed" : "failed") << "\n";
+		return passed;
+	}
+
+	// Renders captureFrameCount frames of the scene into an offscreen target and writes all of them to
+	// capturePath, with CAPTURE_READBACK_SLOT_COUNT readbacks in flight and the encoding and file writes
+	// on the writer thread of the capture
+	// Reports the rendering rate, the sustained rate of frames written to disk and the time spent
+	// waiting for the writer
+	// Returns false if the capture files could not be created
+	bool runCapture()
+	{
+		resolvePendingPipelines(true);
+		setupContext.waitAll();
+
+		VulkanFrameCapture capture;
+		if (!capture.open(capturePath, captureFormat, width, height, colorformat, CAPTURE_QUEUE_CAPACITY))
+		{
+			std::cout << "Could not create capture files at " << capturePath << "\n";
+			return false;
+		}
+
+		VulkanOffscreenTarget target;
+		target.init(physicalDevice, device);
+		target.create(width, height, colorformat, depthFormat);
+		VulkanReadbackRing ring;
+		ring.init(physicalDevice, device, cmdPool, queue);
+		ring.create(&target, CAPTURE_READBACK_SLOT_COUNT);
+		const uint32_t lag = ring.slotCount() - 1;
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		VkRenderPassBeginInfo renderPassBeginInfo = vkTools::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = target.renderPass;
+		renderPassBeginInfo.framebuffer = target.framebuffer;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		VulkanReadbackRing::Readback readback;
+		auto tStart = std::chrono::high_resolution_clock::now();
+		for (uint64_t frame = 0; frame < captureFrameCount + lag; frame++)
+		{
+			// Every frame is captured, so the oldest one in flight is waited for if it is not done yet
+			if (frame >= lag)
+			{
+				if (!ring.readback(frame - lag, &readback))
+				{
+					ring.wait(frame - lag, &readback);
+				}
+				capture.push(readback);
+			}
+			if (frame < captureFrameCount)
+			{
+				VkCommandBuffer cmdBuffer = ring.beginFrame(frame);
+				assert(cmdBuffer != VK_NULL_HANDLE);
+				vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				recordScene(cmdBuffer, 0);
+				vkCmdEndRenderPass(cmdBuffer);
+				ring.endFrame();
+			}
+		}
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		capture.close();
+		ring.cleanup();
+		target.cleanup();
+
+		double renderTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		std::cout << "Captured " << capture.stats.framesWritten << " frames of " << width << "x" << height << " to " << capturePath
+			<< " (" << capture.stats.writeErrors << " write errors)\n";
+		std::cout << "Rendering : " << (captureFrameCount / (renderTime / 1000.0)) << " frames/s, waited " << capture.stats.stallTime
+			<< " ms for the writer (" << capture.stats.stalls << " times)\n";
+		std::cout << "Disk : " << capture.writeRate() << " frames/s, " << capture.writeThroughput() << " MB/s\n";
+		return capture.stats.writeErrors == 0;
+	}
+
+	// Runs the benchmarks requested on the command line
+	// Returns true if at least one benchmark has been run
+	bool runBenchmarks()
+	{
+		// Benchmarks need the actual pipelines, not placeholders
+		resolvePendingPipelines(true);
+		if (benchmarkInstancing || benchmarkPerDraw || benchmarkReplay || benchmarkVariants || benchmarkShaderLoading || benchmarkDescriptorUpdates || benchmarkReadback)
+		{
+			setupContext.waitAll();
+		}
+		if (benchmarkInstancing)
+		{
+			runInstancingBenchmark();
+		}
+		if (benchmarkPerDraw)
+		{
+			runPerDrawBenchmark();
+		}
+		if (benchmarkReplay)
+		{
+			runReplayBenchmark();
+		}
+		if (benchmarkVariants)
+		{
+			runVariantBenchmark();
+		}
+		if (benchmarkShaderLoading)
+		{
+			runShaderLoadingBenchmark();
+		}
+		if (benchmarkDescriptorUpdates)
+		{
+			runDescriptorUpdateBenchmark();
+		}
+		if (benchmarkReadback)
+		{
+			runReadbackBenchmark();
+		}
+		return benchmarkInstancing || benchmarkPerDraw || benchmarkReplay || benchmarkVariants || benchmarkShaderLoading || benchmarkDescriptorUpdates || benchmarkReadback;
+	}
+
 	void setupDescriptorPool()
 	{
 		// We need to tell the API the number of max. requested descriptors per type
-		VkDescriptorPoolSize typeCounts[1];
-		// This example only uses one descriptor type (uniform buffer) and only
-		// requests one descriptor of this type
-		typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		typeCounts[0].descriptorCount = 1;
-		// For additional types you need to add new entries in the type count list
-		// E.g. for two combined image samplers :
-		// typeCounts[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		// typeCounts[1].descriptorCount = 2;
-
-		// Create the global descriptor pool
-		// All descriptors used in this example are allocated from this pool
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
-		descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		descriptorPoolInfo.pNext = NULL;
-		descriptorPoolInfo.poolSizeCount = 1;
-		descriptorPoolInfo.pPoolSizes = typeCounts;
-		// Set the max. number of sets that can be requested
-		// Requesting descriptors beyond maxSets will result in an error
-		descriptorPoolInfo.maxSets = 1;
-
-		VkResult vkRes = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
-		assert(!vkRes);
+		// The allocator sizes its pools from the expected number of descriptors
+		// of each type per set, and adds pools when they are exhausted
+		// This example mostly uses uniform buffers (up to two per set for the
+		// per-draw benchmark), and a single dynamic uniform buffer
+		// For additional types you need to add new entries in the ratio list
+		// E.g. for two combined image samplers per set :
+		// { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f }
+		descriptorAllocator.init(device,
+		{
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0.125f }
+		});
+		descriptorSetCache.init(device, &descriptorAllocator);
 	}
 
 	void setupDescriptorSetLayout()
@@ -438,66 +1969,64 @@ public:
 		// So every shader binding should map to one descriptor set layout
 		// binding
 
+		// The layouts are generated from the resources used by the shaders
 		// Binding 0 : Uniform buffer (Vertex shader)
-		VkDescriptorSetLayoutBinding layoutBinding = {};
-		layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		layoutBinding.descriptorCount = 1;
-		layoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		layoutBinding.pImmutableSamplers = NULL;
-
-		VkDescriptorSetLayoutCreateInfo descriptorLayout = {};
-		descriptorLayout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		descriptorLayout.pNext = NULL;
-		descriptorLayout.bindingCount = 1;
-		descriptorLayout.pBindings = &layoutBinding;
-
-		VkResult err = vkCreateDescriptorSetLayout(device, &descriptorLayout, NULL, &descriptorSetLayout);
-		assert(!err);
+		const vkReflection::ShaderInterface &vertexShader = layoutCache.reflectFile("./../data/shaders/triangle.vert.spv");
+		const vkReflection::ShaderInterface &fragmentShader = layoutCache.reflectFile("./../data/shaders/triangle.frag.spv");
 
 		// Create the pipeline layout that is used to generate the rendering pipelines that
 		// are based on this descriptor set layout
-		// In a more complex scenario you would have different pipeline layouts for different
-		// descriptor set layouts that could be reused
-		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = {};
-		pPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pPipelineLayoutCreateInfo.pNext = NULL;
-		pPipelineLayoutCreateInfo.setLayoutCount = 1;
-		pPipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+		// Pipelines whose shaders use the same resources share the same layouts
+		std::vector<VkDescriptorSetLayout> setLayouts;
+		pipelineLayout = layoutCache.pipelineLayout({ &vertexShader, &fragmentShader }, &setLayouts);
+		assert(setLayouts.size() == 1);
+		descriptorSetLayout = setLayouts[0];
 
-		err = vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout);
-		assert(!err);
+		if (usePushConstants || benchmarkPerDraw || goldenTests)
+		{
+			// Per-draw data is delivered through a push constant range
+			// Same descriptor set layout as the other pipelines, plus the push constant block of the shader
+			const vkReflection::ShaderInterface &pushConstantShader = layoutCache.reflectFile("./../data/shaders/pushconstants.vert.spv");
+			assert(pushConstantShader.pushConstantRange.size == sizeof(InstanceData));
+			// Its size is limited by the device (maxPushConstantsSize is at least 128 bytes)
+			uint32_t pushConstantSize = pushConstantShader.pushConstantRange.size;
+			if (pushConstantSize > deviceProperties.limits.maxPushConstantsSize)
+			{
+				vkTools::exitFatal("Per-draw data of " + std::to_string(pushConstantSize) + " bytes exceeds maxPushConstantsSize", "Fatal error");
+			}
+			pushConstantPipelineLayout = layoutCache.pipelineLayout({ &pushConstantShader, &fragmentShader });
+
+			setTransform2D(pushConstants.modelMatrix, 0.0f, 0.0f, 1.0f, 0.0f);
+			std::fill(pushConstants.color, pushConstants.color + 4, 1.0f);
+		}
+
+		if (benchmarkPerDraw)
+		{
+			setupPerDrawBenchmarkLayouts();
+		}
 	}
 
 	void setupDescriptorSet()
 	{
+		CPU_PROFILE_SCOPE("setupDescriptorSet");
 		// Update descriptor sets determining the shader binding points
 		// For every binding point used in a shader there needs to be one
 		// descriptor set matching that binding point
-		VkWriteDescriptorSet writeDescriptorSet = {};
-
-		VkDescriptorSetAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = descriptorPool;
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = &descriptorSetLayout;
-
-		VkResult vkRes = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
-		assert(!vkRes);
-
-		// Binding 0 : Uniform buffer
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.dstSet = descriptorSet;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		writeDescriptorSet.pBufferInfo = &uniformDataVS.descriptor;
-		// Binds this uniform buffer to binding point 0
-		writeDescriptorSet.dstBinding = 0;
-
-		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, NULL);
+		// The cache only allocates and writes a set the first time a
+		// combination of layout and resources is requested
+		descriptorSet = descriptorSetCache.get(descriptorSetLayout,
+		{
+			// Binds this uniform buffer to binding point 0
+			VulkanDescriptorSetCache::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformDataVS.descriptor)
+		});
+		// The set is bound by the pre-recorded draw command buffers, which are submitted
+		// every frame without calling get(), so it must not age out of the cache
+		descriptorSetCache.pin(descriptorSet);
 	}
 
 	void preparePipelines()
 	{
+		CPU_PROFILE_SCOPE("preparePipelines");
 		// Create our rendering pipeline used in this example
 		// Vulkan uses the concept of rendering pipelines to encapsulate
 		// fixed states
@@ -514,8 +2043,6 @@ public:
 
 		VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
 
-		VkResult err;
-
 		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		// The layout used for this pipeline
 		pipelineCreateInfo.layout = pipelineLayout;
@@ -608,6 +2135,14 @@ public:
 		shaderStages[0] = loadShader("./../data/shaders/triangle.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader("./../data/shaders/triangle.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 #endif
+		// Same fragment shader with its grayscale branch enabled by a specialization constant
+		// Used by all pipelines below
+		VulkanSpecializationConstants fragmentConstants;
+		if (useGrayscale)
+		{
+			fragmentConstants.declare("GRAYSCALE", 0, true);
+			shaderStages[1] = loadShader("./../data/shaders/variants.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT, fragmentConstants);
+		}
 
 		// Assign states
 		// Two shader stages
@@ -625,8 +2160,177 @@ public:
 		pipelineCreateInfo.pDynamicState = &dynamicState;
 
 		// Create rendering pipeline
-		err = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.solid);
-		assert(!err);
+		// Compiled right away as it's also the placeholder for the other pipelines
+		pipelines.solid = pipelineRegistry.acquire(pipelineCreateInfo, false).get();
+		if (pipelines.solid == VK_NULL_HANDLE)
+		{
+			vkTools::exitFatal("Could not create the rendering pipeline", "Fatal error");
+		}
+		if (hotReloadShaders)
+		{
+			shaderReloader.track(pipelineCreateInfo, &pipelines.solid);
+		}
+
+		if (benchmarkVariants)
+		{
+			createVariantPipelines(pipelineCreateInfo);
+		}
+
+		// Instanced rendering pipeline
+		// Same states but different shader and vertex input (per-vertex and per-instance bindings)
+		if (useInstancing || benchmarkInstancing || goldenTests)
+		{
+			shaderStages[0] = loadShader("./../data/shaders/instancing.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			pipelineCreateInfo.pVertexInputState = &instances.vi;
+			compilePipeline(pipelineCreateInfo, &pipelines.instanced);
+		}
+
+		// Push constant pipeline
+		// Per-draw transform and color come from push constants instead of a uniform buffer
+		pipelineCreateInfo.pVertexInputState = &vertices.vi;
+		if (usePushConstants || benchmarkPerDraw || goldenTests)
+		{
+			shaderStages[0] = loadShader("./../data/shaders/pushconstants.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			pipelineCreateInfo.layout = pushConstantPipelineLayout;
+			compilePipeline(pipelineCreateInfo, &pipelines.pushConstants);
+		}
+
+		// Per-draw uniform buffer pipelines used by the benchmark
+		// Both use the same shader, only the descriptor type of binding 1 differs
+		if (benchmarkPerDraw)
+		{
+			shaderStages[0] = loadShader("./../data/shaders/perdrawubo.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			pipelineCreateInfo.layout = perDrawBenchmark.dynamicPipelineLayout;
+			compilePipeline(pipelineCreateInfo, &perDrawBenchmark.dynamicPipeline);
+			pipelineCreateInfo.layout = perDrawBenchmark.staticPipelineLayout;
+			compilePipeline(pipelineCreateInfo, &perDrawBenchmark.staticPipeline);
+			if (descriptorIndexingEnabled)
+			{
+				shaderStages[0] = loadShader("./../data/shaders/bindless.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+				pipelineCreateInfo.layout = perDrawBenchmark.bindlessPipelineLayout;
+				compilePipeline(pipelineCreateInfo, &perDrawBenchmark.bindlessPipeline);
+			}
+		}
+	}
+
+	// Compile every permutation of the variants fragment shader from a single module
+	// with the states of the given pipeline and store the compile time of each variant
+	// Variants are requested twice, the second time they should all be registry hits
+	void createVariantPipelines(VkGraphicsPipelineCreateInfo pipelineCreateInfo)
+	{
+		VkPipelineShaderStageCreateInfo shaderStages[2] = { pipelineCreateInfo.pStages[0], {} };
+		pipelineCreateInfo.pStages = shaderStages;
+		VkPipelineShaderStageCreateInfo fragmentStage = loadShader("./../data/shaders/variants.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VulkanSpecializationConstants constants;
+		constants.declare("GRAYSCALE", 0, false);
+		constants.declare("INVERT", 1, false);
+		constants.declare("BRIGHTNESS", 2, 1.0f);
+		std::vector<VulkanSpecializationConstants> variants;
+		for (float brightness : { 0.5f, 1.0f })
+		{
+			constants.set("BRIGHTNESS", brightness);
+			std::vector<VulkanSpecializationConstants> permutations = constants.permutations({ "GRAYSCALE", "INVERT" });
+			variants.insert(variants.end(), permutations.begin(), permutations.end());
+		}
+
+		for (uint32_t pass = 0; pass < 2; pass++)
+		{
+			for (auto& variant : variants)
+			{
+				shaderStages[1] = variant.apply(fragmentStage);
+				auto tStart = std::chrono::high_resolution_clock::now();
+				pipelineRegistry.acquire(pipelineCreateInfo, false).get();
+				auto tEnd = std::chrono::high_resolution_clock::now();
+				variantCompileTimes.push_back(std::make_pair(
+					variant.toString() + (pass == 0 ? "" : " (again)"),
+					std::chrono::duration<double, std::milli>(tEnd - tStart).count()));
+			}
+		}
+	}
+
+	// Report the compile times measured by createVariantPipelines
+	void runVariantBenchmark()
+	{
+		std::cout << "Shader variant benchmark (" << variantCompileTimes.size() / 2 << " variants of one module)\n";
+		std::cout << "variant\tms\n";
+		for (auto& variant : variantCompileTimes)
+		{
+			std::cout << variant.first << "\t" << variant.second << "\n";
+		}
+		printPipelineStats();
+	}
+
+	// Get a pipeline from the registry, compiled on the worker threads (or right away with "-sync-pipelines")
+	// The pipeline is stored in target right away if it already exists
+	// or by resolvePendingPipelines once compiled
+	void compilePipeline(const VkGraphicsPipelineCreateInfo &pipelineCreateInfo, VkPipeline *target)
+	{
+		std::shared_future<VkPipeline> pipeline = pipelineRegistry.acquire(pipelineCreateInfo, !syncPipelineCompilation);
+		if (hotReloadShaders)
+		{
+			shaderReloader.track(pipelineCreateInfo, target);
+		}
+		if (VulkanPipelineCompiler::isReady(pipeline))
+		{
+			storePipeline(pipeline.get(), target);
+			return;
+		}
+		pendingPipelines.push_back(std::make_pair(pipeline, target));
+	}
+
+	// Store a compiled pipeline, exits if it could not be created
+	void storePipeline(VkPipeline pipeline, VkPipeline *target)
+	{
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			vkTools::exitFatal("Could not create a pipeline", "Fatal error");
+		}
+		*target = pipeline;
+	}
+
+	void printPipelineStats()
+	{
+		std::cout << "Pipeline registry : " << pipelineRegistry.size() << " pipelines, "
+			<< pipelineRegistry.stats.hits << " hits, " << pipelineRegistry.stats.misses << " misses, "
+			<< pipelineRegistry.compileTime() << " ms compiling\n";
+		std::cout << "Shader modules : " << shaderModuleCache.stats.misses << " created, "
+			<< shaderModuleCache.stats.hits << " shared, " << shaderModuleCache.stats.destroyed << " destroyed, "
+			<< shaderModuleCache.size() << " alive\n";
+	}
+
+	// Store the pipelines that have finished compiling
+	// Blocks until all pipelines are compiled if wait is set
+	// Returns true if at least one pipeline has been stored
+	bool resolvePendingPipelines(bool wait)
+	{
+		CPU_PROFILE_SCOPE("resolvePendingPipelines");
+		bool resolved = false;
+		for (auto it = pendingPipelines.begin(); it != pendingPipelines.end();)
+		{
+			if (wait || VulkanPipelineCompiler::isReady(it->first))
+			{
+				storePipeline(it->first.get(), it->second);
+				it = pendingPipelines.erase(it);
+				resolved = true;
+			}
+			else
+			{
+				++it;
+			}
+		}
+		if (resolved)
+		{
+			// Modules only used by compiled pipelines can go
+			pipelineRegistry.releaseShaderModules();
+		}
+		if (resolved && pendingPipelines.empty())
+		{
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			std::cout << "All pipelines compiled after " << std::chrono::duration<double, std::milli>(tEnd - pipelineCompileStart).count() << " ms\n";
+			printPipelineStats();
+		}
+		return resolved;
 	}
 
 	void prepareUniformBuffers()
@@ -689,25 +2393,101 @@ public:
 
 	void prepare()
 	{
+		CPU_PROFILE_SCOPE("prepare");
 		VulkanExampleBase::prepare();
+		layoutCache.init(device, &shaderArchive);
 		prepareVertices();
+		if (useInstancing || benchmarkInstancing || goldenTests)
+		{
+			prepareInstancing();
+		}
+		if (useIndirectDraw)
+		{
+			prepareIndirectCommands();
+		}
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
+		// Cold : compiled from scratch, warm : found in the cache saved by a previous run
+		// Variants are compiled on the worker threads, rendering starts with placeholders
+		if (!syncPipelineCompilation)
+		{
+			pipelineCompiler.init(device, pipelineCache);
+		}
+		pipelineRegistry.init(device, pipelineCache, syncPipelineCompilation ? nullptr : &pipelineCompiler, &shaderModuleCache);
+		shaderReloader.init(&shaderModuleCache, &pipelineRegistry);
+		pipelineCompileStart = std::chrono::high_resolution_clock::now();
 		preparePipelines();
+		// The registry keeps the modules of the pipelines still compiling
+		// and the shader reloader those of the pipelines it tracks
+		releaseShaderModules();
+		if (hotReloadShaders)
+		{
+			shaderReloader.start();
+		}
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		std::cout << "Pipeline creation (" << (persistentPipelineCache.loaded ? "warm" : "cold") << " cache) : "
+			<< std::chrono::duration<double, std::milli>(tEnd - pipelineCompileStart).count() << " ms";
+		if (!pendingPipelines.empty())
+		{
+			std::cout << ", " << pendingPipelines.size() << " pipelines compiling on " << pipelineCompiler.threadCount() << " threads\n";
+		}
+		else
+		{
+			std::cout << "\n";
+			printPipelineStats();
+		}
 		setupDescriptorPool();
 		setupDescriptorSet();
+		if (benchmarkPerDraw)
+		{
+			setupPerDrawBenchmarkDescriptors();
+		}
 		buildCommandBuffers();
-		prepared = true;
+		// Setup commands recorded by the base class may still be executing
+		// Start rendering once they (and anything recorded since) have completed
+		setupContext.onComplete([this]() { prepared = true; });
+		submitSetupCommandBuffer();
 	}
 
 	virtual void render()
 	{
+		CPU_PROFILE_SCOPE("render");
 		if (!prepared)
+		{
+			// Runs the completion callbacks of finished setup batches
+			setupContext.poll();
 			return;
-		vkDeviceWaitIdle(device);
+		}
+		waitDeviceIdle();
+		descriptorSetCache.nextFrame();
+		// Swap placeholders for the pipelines that have finished compiling
+		// and pipelines rebuilt with reloaded shaders
+		bool pipelinesChanged = resolvePendingPipelines(false);
+		if (hotReloadShaders && shaderReloader.update())
+		{
+			pipelinesChanged = true;
+		}
+		if (pipelinesChanged)
+		{
+			buildCommandBuffers();
+		}
 		draw();
-		vkDeviceWaitIdle(device);
+		waitDeviceIdle();
+		updatePipelineCache();
+		if (gpuProfiling && (++gpuProfileFrame % GPU_PROFILE_PRINT_INTERVAL == 0))
+		{
+			printGpuProfile();
+		}
+
+	}
 
+	virtual void prepareFixedFrameBenchmark()
+	{
+		// Measure the actual pipelines, not placeholders swapped during the measured frames
+		if (resolvePendingPipelines(true))
+		{
+			buildCommandBuffers();
+		}
 	}
 
 	virtual void viewChanged()
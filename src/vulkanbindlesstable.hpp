@@ -0,0 +1,294 @@
+/*
+* Class managing a global bindless resource table (VK_EXT_descriptor_indexing)
+*
+* A single descriptor set holds large, partially bound arrays of sampled images
+* (binding 0) and storage buffers (binding 1)
+* Resources are added to the table once and referenced by their handle (index
+* into the array), e.g. passed to the shaders as a push constant or in a buffer
+* The set is bound once per command buffer and serves all draws, whatever
+* resources they use
+*
+* Shader side (GLSL, with GL_EXT_nonuniform_qualifier) :
+*   layout (set = N, binding = 0) uniform sampler2D textures[];
+*   layout (set = N, binding = 1) buffer Buffers { ... } buffers[];
+*
+* Descriptors are written in batches by update() (once per frame), and can be
+* written while the set is bound to pending command buffers (update after bind)
+* The handle of a removed resource is reused only after framesInFlight updates
+*
+* Note : Requires the device to have been created with descriptor indexing
+* enabled (see VulkanExampleBase::descriptorIndexingEnabled)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <algorithm>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+#include "vulkanextensions.h"
+
+class VulkanBindlessTable
+{
+public:
+	static const uint32_t SAMPLED_IMAGE_BINDING = 0;
+	static const uint32_t STORAGE_BUFFER_BINDING = 1;
+
+private:
+	// Handles of one array
+	struct Slots
+	{
+		uint32_t capacity = 0;
+		// Handles below next have been used at least once
+		uint32_t next = 0;
+		std::vector<uint32_t> free;
+		// Removed handles and the update they were removed at
+		std::vector<std::pair<uint64_t, uint32_t>> retired;
+
+		uint32_t acquire()
+		{
+			if (!free.empty())
+			{
+				uint32_t handle = free.back();
+				free.pop_back();
+				return handle;
+			}
+			// The table is full
+			assert(next < capacity);
+			return next++;
+		}
+
+		void recycle(uint64_t frame, uint32_t framesInFlight)
+		{
+			auto it = retired.begin();
+			for (; (it != retired.end()) && (it->first + framesInFlight <= frame); ++it)
+			{
+				free.push_back(it->second);
+			}
+			retired.erase(retired.begin(), it);
+		}
+	};
+
+	template <typename Info>
+	struct PendingWrite
+	{
+		uint32_t handle;
+		Info info;
+	};
+
+	VkDevice device;
+	uint32_t framesInFlight;
+	uint64_t frame = 0;
+
+	Slots imageSlots;
+	Slots bufferSlots;
+	std::vector<PendingWrite<VkDescriptorImageInfo>> pendingImages;
+	std::vector<PendingWrite<VkDescriptorBufferInfo>> pendingBuffers;
+
+	// Writes of consecutive handles are merged into one write of several array elements
+	template <typename Info>
+	void appendWrites(uint32_t binding, VkDescriptorType type, std::vector<PendingWrite<Info>> &pending,
+		std::vector<Info> &infos, std::vector<VkWriteDescriptorSet> &writeDescriptorSets, std::vector<uint32_t> &infoOffsets)
+	{
+		// A handle written twice in the same batch keeps its last value
+		std::stable_sort(pending.begin(), pending.end(),
+			[](const PendingWrite<Info> &a, const PendingWrite<Info> &b) { return a.handle < b.handle; });
+		for (size_t i = 0; i < pending.size(); i++)
+		{
+			if ((i + 1 < pending.size()) && (pending[i + 1].handle == pending[i].handle))
+			{
+				continue;
+			}
+			bool extends = !writeDescriptorSets.empty() &&
+				(writeDescriptorSets.back().dstBinding == binding) &&
+				(writeDescriptorSets.back().dstArrayElement + writeDescriptorSets.back().descriptorCount == pending[i].handle);
+			if (extends)
+			{
+				writeDescriptorSets.back().descriptorCount++;
+			}
+			else
+			{
+				VkWriteDescriptorSet writeDescriptorSet = {};
+				writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writeDescriptorSet.dstSet = descriptorSet;
+				writeDescriptorSet.dstBinding = binding;
+				writeDescriptorSet.dstArrayElement = pending[i].handle;
+				writeDescriptorSet.descriptorCount = 1;
+				writeDescriptorSet.descriptorType = type;
+				writeDescriptorSets.push_back(writeDescriptorSet);
+				infoOffsets.push_back((uint32_t)infos.size());
+			}
+			infos.push_back(pending[i].info);
+		}
+		pending.clear();
+	}
+
+public:
+	// Part of the pipeline layouts of the pipelines using the table
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+	struct Stats
+	{
+		uint32_t images = 0;
+		uint32_t buffers = 0;
+		// Descriptors written and vkWriteDescriptorSet structures used for them
+		uint32_t descriptorsWritten = 0;
+		uint32_t writes = 0;
+	} stats;
+
+	// The array sizes must be below the device's update after bind limits
+	// (at least 500000 per stage if descriptor indexing is supported)
+	void init(VkDevice device, uint32_t maxSampledImages = 16384, uint32_t maxStorageBuffers = 16384, uint32_t framesInFlight = 2)
+	{
+		this->device = device;
+		this->framesInFlight = framesInFlight;
+		imageSlots.capacity = maxSampledImages;
+		bufferSlots.capacity = maxStorageBuffers;
+
+		VkResult err;
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings =
+		{
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL, SAMPLED_IMAGE_BINDING),
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL, STORAGE_BUFFER_BINDING)
+		};
+		setLayoutBindings[0].descriptorCount = maxSampledImages;
+		setLayoutBindings[1].descriptorCount = maxStorageBuffers;
+
+		// Unused elements don't need to be valid, elements not used by pending
+		// command buffers can be written after the set has been bound
+		VkDescriptorBindingFlagsEXT bindingFlags =
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+		std::vector<VkDescriptorBindingFlagsEXT> setLayoutBindingFlags(setLayoutBindings.size(), bindingFlags);
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = (uint32_t)setLayoutBindingFlags.size();
+		bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo descriptorLayout =
+			vkTools::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), (uint32_t)setLayoutBindings.size());
+		descriptorLayout.pNext = &bindingFlagsInfo;
+		descriptorLayout.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		err = vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &setLayout);
+		assert(!err);
+
+		std::vector<VkDescriptorPoolSize> poolSizes =
+		{
+			vkTools::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxSampledImages),
+			vkTools::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxStorageBuffers)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo =
+			vkTools::initializers::descriptorPoolCreateInfo((uint32_t)poolSizes.size(), poolSizes.data(), 1);
+		descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		err = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(!err);
+
+		VkDescriptorSetAllocateInfo allocInfo = vkTools::initializers::descriptorSetAllocateInfo(descriptorPool, &setLayout, 1);
+		err = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+		assert(!err);
+	}
+
+	// Add an image to the table, the returned handle is valid once update() has been called
+	uint32_t addImage(const VkDescriptorImageInfo &imageInfo)
+	{
+		uint32_t handle = imageSlots.acquire();
+		pendingImages.push_back({ handle, imageInfo });
+		stats.images++;
+		return handle;
+	}
+
+	// Add a buffer (or a range of it) to the table, the returned handle is valid once update() has been called
+	uint32_t addBuffer(const VkDescriptorBufferInfo &bufferInfo)
+	{
+		uint32_t handle = bufferSlots.acquire();
+		pendingBuffers.push_back({ handle, bufferInfo });
+		stats.buffers++;
+		return handle;
+	}
+
+	// Point an existing handle at another resource
+	// The handle must not be used by pending command buffers
+	void setImage(uint32_t handle, const VkDescriptorImageInfo &imageInfo)
+	{
+		assert(handle < imageSlots.next);
+		pendingImages.push_back({ handle, imageInfo });
+	}
+
+	void setBuffer(uint32_t handle, const VkDescriptorBufferInfo &bufferInfo)
+	{
+		assert(handle < bufferSlots.next);
+		pendingBuffers.push_back({ handle, bufferInfo });
+	}
+
+	// The handle is reused once command buffers of the current frame have completed
+	void removeImage(uint32_t handle)
+	{
+		imageSlots.retired.push_back({ frame, handle });
+		stats.images--;
+	}
+
+	void removeBuffer(uint32_t handle)
+	{
+		bufferSlots.retired.push_back({ frame, handle });
+		stats.buffers--;
+	}
+
+	// Write the descriptors added or changed since the last update, call once per frame
+	// before submitting command buffers using the new handles
+	void update()
+	{
+		if (!pendingImages.empty() || !pendingBuffers.empty())
+		{
+			std::vector<VkDescriptorImageInfo> imageInfos;
+			std::vector<VkDescriptorBufferInfo> bufferInfos;
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+			std::vector<uint32_t> infoOffsets;
+			appendWrites(SAMPLED_IMAGE_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pendingImages, imageInfos, writeDescriptorSets, infoOffsets);
+			size_t imageWriteCount = writeDescriptorSets.size();
+			appendWrites(STORAGE_BUFFER_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, pendingBuffers, bufferInfos, writeDescriptorSets, infoOffsets);
+			// Info pointers are set once the info arrays are complete
+			for (size_t i = 0; i < writeDescriptorSets.size(); i++)
+			{
+				if (i < imageWriteCount)
+				{
+					writeDescriptorSets[i].pImageInfo = &imageInfos[infoOffsets[i]];
+				}
+				else
+				{
+					writeDescriptorSets[i].pBufferInfo = &bufferInfos[infoOffsets[i]];
+				}
+				stats.descriptorsWritten += writeDescriptorSets[i].descriptorCount;
+			}
+			vkUpdateDescriptorSets(device, (uint32_t)writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+			stats.writes += (uint32_t)writeDescriptorSets.size();
+		}
+
+		frame++;
+		imageSlots.recycle(frame, framesInFlight);
+		bufferSlots.recycle(frame, framesInFlight);
+	}
+
+	void bind(VkCommandBuffer cmdBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t set)
+	{
+		vkCmdBindDescriptorSets(cmdBuffer, bindPoint, pipelineLayout, set, 1, &descriptorSet, 0, NULL);
+	}
+
+	void cleanup()
+	{
+		if (descriptorPool != VK_NULL_HANDLE)
+		{
+			vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+			vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+		}
+		descriptorPool = VK_NULL_HANDLE;
+		setLayout = VK_NULL_HANDLE;
+		descriptorSet = VK_NULL_HANDLE;
+	}
+};
@@ -0,0 +1,748 @@
+/*
+* Compact binary capture and replay of command buffer contents
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkancommandstream.h"
+
+#include <assert.h>
+#include <string.h>
+#include <fstream>
+
+using namespace vkCommandStream;
+
+// File header : magic, version, object count, command count, data size
+static const uint32_t streamMagic = 0x53434b56; // "VKCS" in little endian
+static const uint32_t streamVersion = 1;
+
+void VulkanCommandStream::clear()
+{
+	objects.clear();
+	data.clear();
+	commandCount = 0;
+}
+
+bool VulkanCommandStream::save(const std::string &fileName) const
+{
+	std::ofstream file(fileName, std::ios::out | std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	uint32_t header[5] = { streamMagic, streamVersion, (uint32_t)objects.size(), commandCount, (uint32_t)data.size() };
+	file.write((const char*)header, sizeof(header));
+	for (auto& object : objects)
+	{
+		uint8_t type = object.type;
+		uint16_t nameLength = (uint16_t)object.name.size();
+		file.write((const char*)&type, sizeof(type));
+		file.write((const char*)&nameLength, sizeof(nameLength));
+		file.write(object.name.data(), nameLength);
+	}
+	file.write((const char*)data.data(), data.size());
+	return file.good();
+}
+
+bool VulkanCommandStream::load(const std::string &fileName)
+{
+	clear();
+
+	std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	uint64_t remaining = (uint64_t)file.tellg();
+	file.seekg(0);
+
+	uint32_t header[5];
+	if (remaining < sizeof(header))
+	{
+		return false;
+	}
+	file.read((char*)header, sizeof(header));
+	remaining -= sizeof(header);
+	if (!file.good() || header[0] != streamMagic || header[1] != streamVersion)
+	{
+		return false;
+	}
+
+	// The counts of the header are checked against the file size before allocating anything
+	const uint64_t objectHeaderSize = sizeof(uint8_t) + sizeof(uint16_t);
+	if ((uint64_t)header[2] * objectHeaderSize + header[4] > remaining)
+	{
+		return false;
+	}
+	objects.resize(header[2]);
+	for (auto& object : objects)
+	{
+		uint8_t type;
+		uint16_t nameLength;
+		if (remaining < objectHeaderSize)
+		{
+			clear();
+			return false;
+		}
+		file.read((char*)&type, sizeof(type));
+		file.read((char*)&nameLength, sizeof(nameLength));
+		remaining -= objectHeaderSize;
+		if (!file.good() || type > OBJECT_IMAGE || nameLength > remaining)
+		{
+			clear();
+			return false;
+		}
+		object.type = (ObjectType)type;
+		object.name.resize(nameLength);
+		file.read(&object.name[0], nameLength);
+		remaining -= nameLength;
+	}
+	if (header[4] != remaining)
+	{
+		clear();
+		return false;
+	}
+	commandCount = header[3];
+	data.resize(header[4]);
+	file.read((char*)data.data(), data.size());
+	if (!file.good())
+	{
+		clear();
+		return false;
+	}
+	return true;
+}
+
+void VulkanCommandRecorder::writeBytes(const void *bytes, size_t size)
+{
+	if (stream == nullptr)
+	{
+		return;
+	}
+	stream->data.insert(stream->data.end(), (const uint8_t*)bytes, (const uint8_t*)bytes + size);
+}
+
+void VulkanCommandRecorder::writeCount(uint32_t count)
+{
+	// Counts and first indices of the recorded commands are stored in a single byte
+	assert(count <= UINT8_MAX);
+	write<uint8_t>((uint8_t)count);
+}
+
+void VulkanCommandRecorder::writeOpcode(Opcode opcode)
+{
+	if (stream == nullptr)
+	{
+		return;
+	}
+	write<uint8_t>(opcode);
+	stream->commandCount++;
+}
+
+void VulkanCommandRecorder::writeObject(ObjectType type, uint64_t handle)
+{
+	if (stream == nullptr)
+	{
+		return;
+	}
+	auto it = objectIds.find(handle);
+	if (it == objectIds.end())
+	{
+		// First reference to this object, add an unnamed entry
+		uint32_t id = (uint32_t)stream->objects.size();
+		stream->objects.push_back({ type, "" });
+		it = objectIds.insert(std::make_pair(handle, id)).first;
+	}
+	assert(stream->objects[it->second].type == type);
+	write<uint32_t>(it->second);
+}
+
+void VulkanCommandRecorder::begin(VulkanCommandStream *stream, VkCommandBuffer cmdBuffer)
+{
+	this->stream = stream;
+	this->cmdBuffer = cmdBuffer;
+	objectIds.clear();
+	if (stream != nullptr)
+	{
+		stream->clear();
+	}
+}
+
+void VulkanCommandRecorder::end()
+{
+	stream = nullptr;
+	cmdBuffer = VK_NULL_HANDLE;
+}
+
+uint32_t VulkanCommandRecorder::registerObject(ObjectType type, uint64_t handle, const std::string &name)
+{
+	if (stream == nullptr)
+	{
+		return 0;
+	}
+	auto it = objectIds.find(handle);
+	if (it != objectIds.end())
+	{
+		stream->objects[it->second].name = name;
+		return it->second;
+	}
+	uint32_t id = (uint32_t)stream->objects.size();
+	stream->objects.push_back({ type, name });
+	objectIds[handle] = id;
+	return id;
+}
+
+void VulkanCommandRecorder::beginRenderPass(const VkRenderPassBeginInfo *pRenderPassBegin, VkSubpassContents contents)
+{
+	writeOpcode(OP_BEGIN_RENDER_PASS);
+	writeObject(OBJECT_RENDER_PASS, (uint64_t)pRenderPassBegin->renderPass);
+	writeObject(OBJECT_FRAMEBUFFER, (uint64_t)pRenderPassBegin->framebuffer);
+	write(pRenderPassBegin->renderArea);
+	writeCount(pRenderPassBegin->clearValueCount);
+	writeBytes(pRenderPassBegin->pClearValues, pRenderPassBegin->clearValueCount * sizeof(VkClearValue));
+	write<uint8_t>((uint8_t)contents);
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdBeginRenderPass(cmdBuffer, pRenderPassBegin, contents);
+	}
+}
+
+void VulkanCommandRecorder::endRenderPass()
+{
+	writeOpcode(OP_END_RENDER_PASS);
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdEndRenderPass(cmdBuffer);
+	}
+}
+
+void VulkanCommandRecorder::bindPipeline(VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline)
+{
+	writeOpcode(OP_BIND_PIPELINE);
+	write<uint8_t>((uint8_t)pipelineBindPoint);
+	writeObject(OBJECT_PIPELINE, (uint64_t)pipeline);
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdBindPipeline(cmdBuffer, pipelineBindPoint, pipeline);
+	}
+}
+
+void VulkanCommandRecorder::bindDescriptorSets(
+	VkPipelineBindPoint pipelineBindPoint,
+	VkPipelineLayout layout,
+	uint32_t firstSet,
+	uint32_t descriptorSetCount,
+	const VkDescriptorSet *pDescriptorSets,
+	uint32_t dynamicOffsetCount,
+	const uint32_t *pDynamicOffsets)
+{
+	writeOpcode(OP_BIND_DESCRIPTOR_SETS);
+	write<uint8_t>((uint8_t)pipelineBindPoint);
+	writeObject(OBJECT_PIPELINE_LAYOUT, (uint64_t)layout);
+	writeCount(firstSet);
+	writeCount(descriptorSetCount);
+	for (uint32_t i = 0; i < descriptorSetCount; i++)
+	{
+		writeObject(OBJECT_DESCRIPTOR_SET, (uint64_t)pDescriptorSets[i]);
+	}
+	writeCount(dynamicOffsetCount);
+	writeBytes(pDynamicOffsets, dynamicOffsetCount * sizeof(uint32_t));
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdBindDescriptorSets(cmdBuffer, pipelineBindPoint, layout, firstSet, descriptorSetCount, pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
+	}
+}
+
+void VulkanCommandRecorder::bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer *pBuffers, const VkDeviceSize *pOffsets)
+{
+	writeOpcode(OP_BIND_VERTEX_BUFFERS);
+	writeCount(firstBinding);
+	writeCount(bindingCount);
+	for (uint32_t i = 0; i < bindingCount; i++)
+	{
+		writeObject(OBJECT_BUFFER, (uint64_t)pBuffers[i]);
+		write(pOffsets[i]);
+	}
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdBindVertexBuffers(cmdBuffer, firstBinding, bindingCount, pBuffers, pOffsets);
+	}
+}
+
+void VulkanCommandRecorder::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+	writeOpcode(OP_BIND_INDEX_BUFFER);
+	writeObject(OBJECT_BUFFER, (uint64_t)buffer);
+	write(offset);
+	write<uint8_t>((uint8_t)indexType);
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdBindIndexBuffer(cmdBuffer, buffer, offset, indexType);
+	}
+}
+
+void VulkanCommandRecorder::setViewport(uint32_t firstViewport, uint32_t viewportCount, const VkViewport *pViewports)
+{
+	writeOpcode(OP_SET_VIEWPORT);
+	writeCount(firstViewport);
+	writeCount(viewportCount);
+	writeBytes(pViewports, viewportCount * sizeof(VkViewport));
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdSetViewport(cmdBuffer, firstViewport, viewportCount, pViewports);
+	}
+}
+
+void VulkanCommandRecorder::setScissor(uint32_t firstScissor, uint32_t scissorCount, const VkRect2D *pScissors)
+{
+	writeOpcode(OP_SET_SCISSOR);
+	writeCount(firstScissor);
+	writeCount(scissorCount);
+	writeBytes(pScissors, scissorCount * sizeof(VkRect2D));
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdSetScissor(cmdBuffer, firstScissor, scissorCount, pScissors);
+	}
+}
+
+void VulkanCommandRecorder::pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void *pValues)
+{
+	writeOpcode(OP_PUSH_CONSTANTS);
+	writeObject(OBJECT_PIPELINE_LAYOUT, (uint64_t)layout);
+	write(stageFlags);
+	// Push constant offsets and sizes are limited to maxPushConstantsSize
+	assert((offset <= UINT16_MAX) && (size <= UINT16_MAX));
+	write<uint16_t>((uint16_t)offset);
+	write<uint16_t>((uint16_t)size);
+	writeBytes(pValues, size);
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdPushConstants(cmdBuffer, layout, stageFlags, offset, size, pValues);
+	}
+}
+
+void VulkanCommandRecorder::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+	writeOpcode(OP_DRAW);
+	uint32_t args[4] = { vertexCount, instanceCount, firstVertex, firstInstance };
+	writeBytes(args, sizeof(args));
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdDraw(cmdBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+	}
+}
+
+void VulkanCommandRecorder::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+{
+	writeOpcode(OP_DRAW_INDEXED);
+	// Same layout as the indirect command structure
+	VkDrawIndexedIndirectCommand args = { indexCount, instanceCount, firstIndex, vertexOffset, firstInstance };
+	write(args);
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdDrawIndexed(cmdBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+	}
+}
+
+void VulkanCommandRecorder::drawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+{
+	writeOpcode(OP_DRAW_INDEXED_INDIRECT);
+	writeObject(OBJECT_BUFFER, (uint64_t)buffer);
+	write(offset);
+	write(drawCount);
+	write(stride);
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdDrawIndexedIndirect(cmdBuffer, buffer, offset, drawCount, stride);
+	}
+}
+
+void VulkanCommandRecorder::pipelineBarrier(
+	VkPipelineStageFlags srcStageMask,
+	VkPipelineStageFlags dstStageMask,
+	VkDependencyFlags dependencyFlags,
+	uint32_t memoryBarrierCount,
+	const VkMemoryBarrier *pMemoryBarriers,
+	uint32_t bufferMemoryBarrierCount,
+	const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+	uint32_t imageMemoryBarrierCount,
+	const VkImageMemoryBarrier *pImageMemoryBarriers)
+{
+	writeOpcode(OP_PIPELINE_BARRIER);
+	write(srcStageMask);
+	write(dstStageMask);
+	write(dependencyFlags);
+	writeCount(memoryBarrierCount);
+	for (uint32_t i = 0; i < memoryBarrierCount; i++)
+	{
+		write(pMemoryBarriers[i].srcAccessMask);
+		write(pMemoryBarriers[i].dstAccessMask);
+	}
+	writeCount(bufferMemoryBarrierCount);
+	for (uint32_t i = 0; i < bufferMemoryBarrierCount; i++)
+	{
+		const VkBufferMemoryBarrier &barrier = pBufferMemoryBarriers[i];
+		write(barrier.srcAccessMask);
+		write(barrier.dstAccessMask);
+		write(barrier.srcQueueFamilyIndex);
+		write(barrier.dstQueueFamilyIndex);
+		writeObject(OBJECT_BUFFER, (uint64_t)barrier.buffer);
+		write(barrier.offset);
+		write(barrier.size);
+	}
+	writeCount(imageMemoryBarrierCount);
+	for (uint32_t i = 0; i < imageMemoryBarrierCount; i++)
+	{
+		const VkImageMemoryBarrier &barrier = pImageMemoryBarriers[i];
+		write(barrier.srcAccessMask);
+		write(barrier.dstAccessMask);
+		write(barrier.oldLayout);
+		write(barrier.newLayout);
+		write(barrier.srcQueueFamilyIndex);
+		write(barrier.dstQueueFamilyIndex);
+		writeObject(OBJECT_IMAGE, (uint64_t)barrier.image);
+		write(barrier.subresourceRange);
+	}
+	if (cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			srcStageMask,
+			dstStageMask,
+			dependencyFlags,
+			memoryBarrierCount, pMemoryBarriers,
+			bufferMemoryBarrierCount, pBufferMemoryBarriers,
+			imageMemoryBarrierCount, pImageMemoryBarriers);
+	}
+}
+
+void VulkanCommandReplayer::init(const VulkanCommandStream *stream)
+{
+	this->stream = stream;
+	handles.assign(stream->objects.size(), 0);
+	validated = false;
+}
+
+void VulkanCommandReplayer::setObject(uint32_t id, uint64_t handle)
+{
+	assert(id < handles.size());
+	handles[id] = handle;
+	validated = false;
+}
+
+bool VulkanCommandReplayer::setObject(const std::string &name, uint64_t handle)
+{
+	for (uint32_t id = 0; id < stream->objects.size(); id++)
+	{
+		if (stream->objects[id].name == name)
+		{
+			handles[id] = handle;
+			validated = false;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Sequential reader over the encoded commands
+// Reads past the end of the data return zeros and mark the reader as failed
+class StreamReader
+{
+private:
+	const uint8_t *current;
+	const uint8_t *end;
+	bool failed = false;
+
+	bool consume(size_t size)
+	{
+		if (failed || (size > (size_t)(end - current)))
+		{
+			failed = true;
+			return false;
+		}
+		return true;
+	}
+
+public:
+	StreamReader(const uint8_t *data, size_t size) : current(data), end(data + size) {}
+
+	template<typename T> T read()
+	{
+		T value = {};
+		if (consume(sizeof(T)))
+		{
+			memcpy(&value, current, sizeof(T));
+			current += sizeof(T);
+		}
+		return value;
+	}
+
+	// Returns a pointer to size bytes inside the stream
+	// Only used for arrays of types with alignment 4, which the stream does not guarantee,
+	// so the data is copied into the scratch storage provided
+	template<typename T> const T *readArray(uint32_t count, std::vector<T> &storage)
+	{
+		storage.resize(count);
+		if (count > 0)
+		{
+			if (consume(count * sizeof(T)))
+			{
+				memcpy(storage.data(), current, count * sizeof(T));
+				current += count * sizeof(T);
+			}
+		}
+		return storage.data();
+	}
+
+	// Marks the reader as failed
+	void fail()
+	{
+		failed = true;
+	}
+
+	bool good() const
+	{
+		return !failed;
+	}
+
+	bool atEnd() const
+	{
+		return current == end;
+	}
+};
+
+bool VulkanCommandReplayer::validate()
+{
+	assert(stream != nullptr);
+	if (!validated)
+	{
+		validated = decode(VK_NULL_HANDLE);
+	}
+	return validated;
+}
+
+bool VulkanCommandReplayer::replay(VkCommandBuffer cmdBuffer)
+{
+	assert(cmdBuffer != VK_NULL_HANDLE);
+	// Nothing is recorded unless the whole stream can be decoded
+	if (!validate())
+	{
+		return false;
+	}
+	return decode(cmdBuffer);
+}
+
+bool VulkanCommandReplayer::decode(VkCommandBuffer cmdBuffer)
+{
+	StreamReader reader(stream->data.data(), stream->data.size());
+	uint32_t commandCount = 0;
+
+	// Resolve an object ID read from the stream into a live handle
+	// IDs outside of the object table, of another type or not bound by setObject() fail the reader
+	auto readObject = [&](ObjectType type) -> uint64_t
+	{
+		uint32_t id = reader.read<uint32_t>();
+		if (!reader.good() || (id >= handles.size()) || (stream->objects[id].type != type) || (handles[id] == 0))
+		{
+			reader.fail();
+			return 0;
+		}
+		return handles[id];
+	};
+#define READ_OBJECT(type, objectType) (type)readObject(objectType)
+// Only record a command once all its arguments have been read successfully
+#define RECORD(command) if (reader.good() && (cmdBuffer != VK_NULL_HANDLE)) { command; }
+
+	std::vector<VkClearValue> clearValues;
+	std::vector<uint32_t> dynamicOffsets;
+	std::vector<VkDeviceSize> offsets;
+	std::vector<VkViewport> viewports;
+	std::vector<VkRect2D> scissors;
+	std::vector<uint8_t> pushConstantValues;
+
+	while (!reader.atEnd())
+	{
+		Opcode opcode = (Opcode)reader.read<uint8_t>();
+		switch (opcode)
+		{
+		case OP_BEGIN_RENDER_PASS:
+		{
+			VkRenderPassBeginInfo renderPassBeginInfo = {};
+			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassBeginInfo.renderPass = READ_OBJECT(VkRenderPass, OBJECT_RENDER_PASS);
+			renderPassBeginInfo.framebuffer = READ_OBJECT(VkFramebuffer, OBJECT_FRAMEBUFFER);
+			renderPassBeginInfo.renderArea = reader.read<VkRect2D>();
+			renderPassBeginInfo.clearValueCount = reader.read<uint8_t>();
+			renderPassBeginInfo.pClearValues = reader.readArray(renderPassBeginInfo.clearValueCount, clearValues);
+			VkSubpassContents contents = (VkSubpassContents)reader.read<uint8_t>();
+			RECORD(vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, contents));
+			break;
+		}
+		case OP_END_RENDER_PASS:
+			RECORD(vkCmdEndRenderPass(cmdBuffer));
+			break;
+		case OP_BIND_PIPELINE:
+		{
+			VkPipelineBindPoint bindPoint = (VkPipelineBindPoint)reader.read<uint8_t>();
+			VkPipeline pipeline = READ_OBJECT(VkPipeline, OBJECT_PIPELINE);
+			RECORD(vkCmdBindPipeline(cmdBuffer, bindPoint, pipeline));
+			break;
+		}
+		case OP_BIND_DESCRIPTOR_SETS:
+		{
+			VkPipelineBindPoint bindPoint = (VkPipelineBindPoint)reader.read<uint8_t>();
+			VkPipelineLayout layout = READ_OBJECT(VkPipelineLayout, OBJECT_PIPELINE_LAYOUT);
+			uint32_t firstSet = reader.read<uint8_t>();
+			uint32_t setCount = reader.read<uint8_t>();
+			descriptorSets.resize(setCount);
+			for (uint32_t i = 0; i < setCount; i++)
+			{
+				descriptorSets[i] = READ_OBJECT(VkDescriptorSet, OBJECT_DESCRIPTOR_SET);
+			}
+			uint32_t dynamicOffsetCount = reader.read<uint8_t>();
+			const uint32_t *pDynamicOffsets = reader.readArray(dynamicOffsetCount, dynamicOffsets);
+			RECORD(vkCmdBindDescriptorSets(cmdBuffer, bindPoint, layout, firstSet, setCount, descriptorSets.data(), dynamicOffsetCount, pDynamicOffsets));
+			break;
+		}
+		case OP_BIND_VERTEX_BUFFERS:
+		{
+			uint32_t firstBinding = reader.read<uint8_t>();
+			uint32_t bindingCount = reader.read<uint8_t>();
+			buffers.resize(bindingCount);
+			offsets.resize(bindingCount);
+			for (uint32_t i = 0; i < bindingCount; i++)
+			{
+				buffers[i] = READ_OBJECT(VkBuffer, OBJECT_BUFFER);
+				offsets[i] = reader.read<VkDeviceSize>();
+			}
+			RECORD(vkCmdBindVertexBuffers(cmdBuffer, firstBinding, bindingCount, buffers.data(), offsets.data()));
+			break;
+		}
+		case OP_BIND_INDEX_BUFFER:
+		{
+			VkBuffer buffer = READ_OBJECT(VkBuffer, OBJECT_BUFFER);
+			VkDeviceSize offset = reader.read<VkDeviceSize>();
+			VkIndexType indexType = (VkIndexType)reader.read<uint8_t>();
+			RECORD(vkCmdBindIndexBuffer(cmdBuffer, buffer, offset, indexType));
+			break;
+		}
+		case OP_SET_VIEWPORT:
+		{
+			uint32_t first = reader.read<uint8_t>();
+			uint32_t count = reader.read<uint8_t>();
+			const VkViewport *pViewports = reader.readArray(count, viewports);
+			RECORD(vkCmdSetViewport(cmdBuffer, first, count, pViewports));
+			break;
+		}
+		case OP_SET_SCISSOR:
+		{
+			uint32_t first = reader.read<uint8_t>();
+			uint32_t count = reader.read<uint8_t>();
+			const VkRect2D *pScissors = reader.readArray(count, scissors);
+			RECORD(vkCmdSetScissor(cmdBuffer, first, count, pScissors));
+			break;
+		}
+		case OP_PUSH_CONSTANTS:
+		{
+			VkPipelineLayout layout = READ_OBJECT(VkPipelineLayout, OBJECT_PIPELINE_LAYOUT);
+			VkShaderStageFlags stageFlags = reader.read<VkShaderStageFlags>();
+			uint32_t offset = reader.read<uint16_t>();
+			uint32_t size = reader.read<uint16_t>();
+			const uint8_t *pValues = reader.readArray(size, pushConstantValues);
+			RECORD(vkCmdPushConstants(cmdBuffer, layout, stageFlags, offset, size, pValues));
+			break;
+		}
+		case OP_DRAW:
+		{
+			uint32_t args[4];
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				args[i] = reader.read<uint32_t>();
+			}
+			RECORD(vkCmdDraw(cmdBuffer, args[0], args[1], args[2], args[3]));
+			break;
+		}
+		case OP_DRAW_INDEXED:
+		{
+			VkDrawIndexedIndirectCommand args = reader.read<VkDrawIndexedIndirectCommand>();
+			RECORD(vkCmdDrawIndexed(cmdBuffer, args.indexCount, args.instanceCount, args.firstIndex, args.vertexOffset, args.firstInstance));
+			break;
+		}
+		case OP_DRAW_INDEXED_INDIRECT:
+		{
+			VkBuffer buffer = READ_OBJECT(VkBuffer, OBJECT_BUFFER);
+			VkDeviceSize offset = reader.read<VkDeviceSize>();
+			uint32_t drawCount = reader.read<uint32_t>();
+			uint32_t stride = reader.read<uint32_t>();
+			RECORD(vkCmdDrawIndexedIndirect(cmdBuffer, buffer, offset, drawCount, stride));
+			break;
+		}
+		case OP_PIPELINE_BARRIER:
+		{
+			VkPipelineStageFlags srcStageMask = reader.read<VkPipelineStageFlags>();
+			VkPipelineStageFlags dstStageMask = reader.read<VkPipelineStageFlags>();
+			VkDependencyFlags dependencyFlags = reader.read<VkDependencyFlags>();
+
+			memoryBarriers.resize(reader.read<uint8_t>());
+			for (auto& barrier : memoryBarriers)
+			{
+				barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				barrier.srcAccessMask = reader.read<VkAccessFlags>();
+				barrier.dstAccessMask = reader.read<VkAccessFlags>();
+			}
+			bufferBarriers.resize(reader.read<uint8_t>());
+			for (auto& barrier : bufferBarriers)
+			{
+				barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				barrier.srcAccessMask = reader.read<VkAccessFlags>();
+				barrier.dstAccessMask = reader.read<VkAccessFlags>();
+				barrier.srcQueueFamilyIndex = reader.read<uint32_t>();
+				barrier.dstQueueFamilyIndex = reader.read<uint32_t>();
+				barrier.buffer = READ_OBJECT(VkBuffer, OBJECT_BUFFER);
+				barrier.offset = reader.read<VkDeviceSize>();
+				barrier.size = reader.read<VkDeviceSize>();
+			}
+			imageBarriers.resize(reader.read<uint8_t>());
+			for (auto& barrier : imageBarriers)
+			{
+				barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask = reader.read<VkAccessFlags>();
+				barrier.dstAccessMask = reader.read<VkAccessFlags>();
+				barrier.oldLayout = reader.read<VkImageLayout>();
+				barrier.newLayout = reader.read<VkImageLayout>();
+				barrier.srcQueueFamilyIndex = reader.read<uint32_t>();
+				barrier.dstQueueFamilyIndex = reader.read<uint32_t>();
+				barrier.image = READ_OBJECT(VkImage, OBJECT_IMAGE);
+				barrier.subresourceRange = reader.read<VkImageSubresourceRange>();
+			}
+			RECORD(vkCmdPipelineBarrier(
+				cmdBuffer,
+				srcStageMask,
+				dstStageMask,
+				dependencyFlags,
+				(uint32_t)memoryBarriers.size(), memoryBarriers.data(),
+				(uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+				(uint32_t)imageBarriers.size(), imageBarriers.data()));
+			break;
+		}
+		default:
+			// Corrupted stream or stream written by a newer version
+			reader.fail();
+			break;
+		}
+		if (!reader.good())
+		{
+			return false;
+		}
+		commandCount++;
+	}
+
+#undef RECORD
+#undef READ_OBJECT
+
+	return commandCount == stream->commandCount;
+}
@@ -0,0 +1,180 @@
+/*
+* Compact binary capture and replay of command buffer contents
+*
+* VulkanCommandRecorder encodes vkCmd* calls into a VulkanCommandStream,
+* optionally forwarding them to a real command buffer at the same time
+* Object handles are replaced by small IDs so a stream can be saved to disk
+* and replayed later (or in another process) by VulkanCommandReplayer,
+* which maps the IDs back to live handles and re-encodes the commands
+* into fresh command buffers
+* This gives repeatable workloads for measuring command encoding cost
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+
+namespace vkCommandStream
+{
+	// Opcodes of the encoded commands, stored as one byte before the arguments
+	enum Opcode : uint8_t
+	{
+		OP_BEGIN_RENDER_PASS = 1,
+		OP_END_RENDER_PASS,
+		OP_BIND_PIPELINE,
+		OP_BIND_DESCRIPTOR_SETS,
+		OP_BIND_VERTEX_BUFFERS,
+		OP_BIND_INDEX_BUFFER,
+		OP_SET_VIEWPORT,
+		OP_SET_SCISSOR,
+		OP_PUSH_CONSTANTS,
+		OP_DRAW,
+		OP_DRAW_INDEXED,
+		OP_DRAW_INDEXED_INDIRECT,
+		OP_PIPELINE_BARRIER,
+	};
+
+	// Types of the objects referenced by a stream
+	enum ObjectType : uint8_t
+	{
+		OBJECT_RENDER_PASS = 0,
+		OBJECT_FRAMEBUFFER,
+		OBJECT_PIPELINE,
+		OBJECT_PIPELINE_LAYOUT,
+		OBJECT_DESCRIPTOR_SET,
+		OBJECT_BUFFER,
+		OBJECT_IMAGE,
+	};
+
+	struct Object
+	{
+		ObjectType type;
+		// Optional, used to bind objects by name when replaying in another process
+		std::string name;
+	};
+}
+
+// Encoded commands and the table of objects they reference
+class VulkanCommandStream
+{
+public:
+	// Object table, object IDs are indices into this table
+	std::vector<vkCommandStream::Object> objects;
+	// Encoded commands
+	std::vector<uint8_t> data;
+	uint32_t commandCount = 0;
+
+	void clear();
+
+	// Save to / load from a binary file
+	// Returns false if the file can't be opened or has an invalid header
+	bool save(const std::string &fileName) const;
+	bool load(const std::string &fileName);
+};
+
+class VulkanCommandRecorder
+{
+private:
+	VulkanCommandStream *stream = nullptr;
+	// Commands are also recorded into this command buffer if set
+	VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+	// Maps handles to object IDs
+	std::unordered_map<uint64_t, uint32_t> objectIds;
+
+	template<typename T> void write(const T &value)
+	{
+		if (stream == nullptr)
+		{
+			return;
+		}
+		const uint8_t *bytes = (const uint8_t*)&value;
+		stream->data.insert(stream->data.end(), bytes, bytes + sizeof(T));
+	}
+	void writeBytes(const void *bytes, size_t size);
+	void writeCount(uint32_t count);
+	void writeOpcode(vkCommandStream::Opcode opcode);
+	void writeObject(vkCommandStream::ObjectType type, uint64_t handle);
+
+public:
+	// Start recording into a stream
+	// If cmdBuffer is not VK_NULL_HANDLE the commands are also recorded into it
+	// If stream is null the commands are only forwarded to cmdBuffer (to measure the recording overhead)
+	void begin(VulkanCommandStream *stream, VkCommandBuffer cmdBuffer = VK_NULL_HANDLE);
+	void end();
+
+	// Assign a name to an object so it can be bound by name when replaying
+	// Returns the ID of the object
+	uint32_t registerObject(vkCommandStream::ObjectType type, uint64_t handle, const std::string &name);
+
+	void beginRenderPass(const VkRenderPassBeginInfo *pRenderPassBegin, VkSubpassContents contents);
+	void endRenderPass();
+	void bindPipeline(VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline);
+	void bindDescriptorSets(
+		VkPipelineBindPoint pipelineBindPoint,
+		VkPipelineLayout layout,
+		uint32_t firstSet,
+		uint32_t descriptorSetCount,
+		const VkDescriptorSet *pDescriptorSets,
+		uint32_t dynamicOffsetCount,
+		const uint32_t *pDynamicOffsets);
+	void bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer *pBuffers, const VkDeviceSize *pOffsets);
+	void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+	void setViewport(uint32_t firstViewport, uint32_t viewportCount, const VkViewport *pViewports);
+	void setScissor(uint32_t firstScissor, uint32_t scissorCount, const VkRect2D *pScissors);
+	void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void *pValues);
+	void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+	void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+	void drawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride);
+	void pipelineBarrier(
+		VkPipelineStageFlags srcStageMask,
+		VkPipelineStageFlags dstStageMask,
+		VkDependencyFlags dependencyFlags,
+		uint32_t memoryBarrierCount,
+		const VkMemoryBarrier *pMemoryBarriers,
+		uint32_t bufferMemoryBarrierCount,
+		const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+		uint32_t imageMemoryBarrierCount,
+		const VkImageMemoryBarrier *pImageMemoryBarriers);
+};
+
+class VulkanCommandReplayer
+{
+private:
+	const VulkanCommandStream *stream = nullptr;
+	// Live handles indexed by object ID
+	std::vector<uint64_t> handles;
+	// Scratch storage reused between commands to avoid allocations while replaying
+	std::vector<VkDescriptorSet> descriptorSets;
+	std::vector<VkBuffer> buffers;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	std::vector<VkMemoryBarrier> memoryBarriers;
+	// The stream has been decoded successfully with the current handles
+	bool validated = false;
+
+	// Decode all commands of the stream, re-encoding them into cmdBuffer unless it is VK_NULL_HANDLE
+	// Stops at the first command that can't be decoded and returns false
+	bool decode(VkCommandBuffer cmdBuffer);
+
+public:
+	void init(const VulkanCommandStream *stream);
+
+	// Bind a live handle to an object ID or to a named object of the stream
+	void setObject(uint32_t id, uint64_t handle);
+	bool setObject(const std::string &name, uint64_t handle);
+
+	// Check that the stream is complete and that all objects it references are bound
+	// to a handle of the right type, only done again after the handles change
+	bool validate();
+
+	// Re-encode all commands of the stream into a command buffer (in recording state)
+	// Returns false without recording anything if the stream is not valid (see validate())
+	bool replay(VkCommandBuffer cmdBuffer);
+};
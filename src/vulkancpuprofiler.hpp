@@ -0,0 +1,225 @@
+/*
+* CPU profiler recording named zones per thread and exporting them as a Chrome trace
+*
+* CPU_PROFILE_SCOPE("name") records the time spent until the end of the enclosing
+* scope, CPU_PROFILE_THREAD("name") names the calling thread in the trace
+* Each thread writes its zones to its own fixed size buffer, so recording takes
+* no lock (only the first zone or name of a thread registers its buffer)
+* The zones of a buffer are allocated by the first zone recorded by its thread,
+* naming a thread takes no memory for zones
+* Zones are only recorded between start() and stop(), writeChromeTrace() writes
+* them in the trace event format loaded by chrome://tracing and Perfetto
+*
+* Note : Zone names must be string literals (or outlive the profiler), only their
+* pointer is stored
+* Note : The macros compile to nothing if ENABLE_CPU_PROFILER is not defined
+* (see the ENABLE_CPU_PROFILER CMake option)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class VulkanCpuProfiler
+{
+private:
+	struct Zone
+	{
+		const char *name;
+		// Nanoseconds since the profiler was first used
+		int64_t begin;
+		int64_t end;
+	};
+
+	struct ThreadBuffer
+	{
+		uint32_t id;
+		std::string name;
+		// Allocated by the first recorded zone
+		std::unique_ptr<Zone[]> zones;
+		uint32_t capacity = 0;
+		// Number of zones written, published by the owning thread
+		std::atomic<uint32_t> count{ 0 };
+		// Zones not recorded because the buffer was full
+		std::atomic<uint32_t> dropped{ 0 };
+	};
+
+	struct State
+	{
+		// Only taken to register threads, name them and write the trace
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> threads;
+		std::atomic<bool> recording{ false };
+		std::atomic<uint32_t> zonesPerThread{ 65536 };
+		std::chrono::high_resolution_clock::time_point origin = std::chrono::high_resolution_clock::now();
+	};
+
+	static State &state()
+	{
+		static State instance;
+		return instance;
+	}
+
+	static ThreadBuffer *threadBuffer()
+	{
+		static thread_local ThreadBuffer *buffer = nullptr;
+		if (buffer == nullptr)
+		{
+			State &profiler = state();
+			std::lock_guard<std::mutex> lock(profiler.mutex);
+			ThreadBuffer *newBuffer = new ThreadBuffer();
+			newBuffer->id = (uint32_t)profiler.threads.size() + 1;
+			newBuffer->name = "thread " + std::to_string(newBuffer->id);
+			profiler.threads.push_back(std::unique_ptr<ThreadBuffer>(newBuffer));
+			buffer = newBuffer;
+		}
+		return buffer;
+	}
+
+public:
+	// Records a zone from its construction to its destruction, see CPU_PROFILE_SCOPE
+	class Scope
+	{
+	private:
+		const char *name;
+		int64_t begin;
+		bool active;
+
+	public:
+		Scope(const char *name) : name(name), active(recording())
+		{
+			if (active)
+			{
+				begin = now();
+			}
+		}
+
+		~Scope()
+		{
+			if (active)
+			{
+				record(name, begin, now());
+			}
+		}
+	};
+
+	// Nanoseconds since the profiler was first used
+	static int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - state().origin).count();
+	}
+
+	// Start recording, each thread can record up to zonesPerThread zones
+	// Threads that already recorded zones keep the size of their buffer
+	static void start(uint32_t zonesPerThread = 65536)
+	{
+		state().zonesPerThread = zonesPerThread;
+		state().recording = true;
+	}
+
+	static void stop()
+	{
+		state().recording = false;
+	}
+
+	static bool recording()
+	{
+		return state().recording.load(std::memory_order_relaxed);
+	}
+
+	// Name of the calling thread in the trace
+	static void setThreadName(const std::string &name)
+	{
+		ThreadBuffer *buffer = threadBuffer();
+		std::lock_guard<std::mutex> lock(state().mutex);
+		buffer->name = name;
+	}
+
+	static void record(const char *name, int64_t begin, int64_t end)
+	{
+		ThreadBuffer *buffer = threadBuffer();
+		if (!buffer->zones)
+		{
+			// Only the owning thread writes them, readers don't access them before the first count is published
+			buffer->capacity = state().zonesPerThread;
+			buffer->zones.reset(new Zone[buffer->capacity]);
+		}
+		uint32_t index = buffer->count.load(std::memory_order_relaxed);
+		if (index >= buffer->capacity)
+		{
+			buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		buffer->zones[index] = { name, begin, end };
+		// The zone is complete before the reader sees the new count
+		buffer->count.store(index + 1, std::memory_order_release);
+	}
+
+	// Number of zones recorded and dropped by all threads
+	static void counts(uint64_t *recorded, uint64_t *dropped)
+	{
+		std::lock_guard<std::mutex> lock(state().mutex);
+		*recorded = 0;
+		*dropped = 0;
+		for (auto& thread : state().threads)
+		{
+			*recorded += thread->count.load(std::memory_order_acquire);
+			*dropped += thread->dropped.load(std::memory_order_relaxed);
+		}
+	}
+
+	// Write the zones recorded so far as a Chrome trace event JSON file
+	// Zones still being recorded by other threads are written if they are complete
+	// Returns false if the file could not be written
+	static bool writeChromeTrace(const std::string &fileName)
+	{
+		std::ofstream file(fileName);
+		if (!file)
+		{
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(state().mutex);
+		// Nanosecond precision, without exponents
+		file << std::fixed << std::setprecision(3);
+		file << "{\"traceEvents\": [\n";
+		bool first = true;
+		for (auto& thread : state().threads)
+		{
+			file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread->id
+				<< ", \"args\": {\"name\": \"" << thread->name << "\"}}";
+			first = false;
+			uint32_t count = thread->count.load(std::memory_order_acquire);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const Zone &zone = thread->zones[i];
+				// Times in microseconds
+				file << ",\n{\"name\": \"" << zone.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread->id
+					<< ", \"ts\": " << zone.begin / 1000.0 << ", \"dur\": " << (zone.end - zone.begin) / 1000.0 << "}";
+			}
+		}
+		file << "\n],\n\"displayTimeUnit\": \"ms\"}\n";
+		return (bool)file;
+	}
+};
+
+#ifdef ENABLE_CPU_PROFILER
+#define CPU_PROFILE_CONCAT_(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_(a, b)
+// Record the time spent until the end of the enclosing scope as a zone
+#define CPU_PROFILE_SCOPE(name) VulkanCpuProfiler::Scope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+// Name the calling thread in the trace
+#define CPU_PROFILE_THREAD(name) VulkanCpuProfiler::setThreadName(name)
+#else
+#define CPU_PROFILE_SCOPE(name)
+#define CPU_PROFILE_THREAD(name)
+#endif
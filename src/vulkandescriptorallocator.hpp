@@ -0,0 +1,186 @@
+/*
+* Class allocating descriptor sets from a growing list of descriptor pools
+*
+* Pools are sized by the expected number of descriptors of each type per set
+* (ratios) times the number of sets per pool
+* When the current pool is exhausted (VK_ERROR_OUT_OF_POOL_MEMORY / VK_ERROR_FRAGMENTED_POOL,
+* or any error on Vulkan 1.0 drivers), a new pool is created, each one larger than the previous
+* Sets are never freed one by one : reset() recycles all pools at once, e.g. with one
+* allocator per frame in flight for transient sets, reset once the frame has completed
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <algorithm>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+#include "vulkanextensions.h"
+
+class VulkanDescriptorAllocator
+{
+public:
+	// Expected number of descriptors of a type per set
+	struct PoolSizeRatio
+	{
+		VkDescriptorType type;
+		float ratio;
+	};
+
+private:
+	// Each new pool holds growthFactor times more sets than the previous one, up to maxSetsPerPool
+	static const uint32_t growthFactor = 2;
+	static const uint32_t maxSetsPerPool = 4096;
+
+	VkDevice device;
+	std::vector<PoolSizeRatio> ratios;
+	uint32_t setsPerPool;
+
+	// Pool allocations are made from, VK_NULL_HANDLE until the first allocation
+	VkDescriptorPool currentPool = VK_NULL_HANDLE;
+	// Number of sets allocated from the current pool
+	uint32_t currentPoolSets = 0;
+	// Exhausted pools
+	std::vector<VkDescriptorPool> fullPools;
+	// Pools that have been reset, used before new ones are created
+	std::vector<VkDescriptorPool> readyPools;
+
+	VkDescriptorPool createPool(uint32_t maxSets)
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (auto& ratio : ratios)
+		{
+			uint32_t descriptorCount = std::max(1u, (uint32_t)(ratio.ratio * maxSets));
+			poolSizes.push_back(vkTools::initializers::descriptorPoolSize(ratio.type, descriptorCount));
+		}
+		VkDescriptorPoolCreateInfo descriptorPoolInfo =
+			vkTools::initializers::descriptorPoolCreateInfo((uint32_t)poolSizes.size(), poolSizes.data(), maxSets);
+		VkDescriptorPool pool;
+		VkResult err = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &pool);
+		assert(!err);
+		stats.poolsCreated++;
+		return pool;
+	}
+
+	// Retire the current pool and continue with a reset or a new (larger) one
+	void nextPool()
+	{
+		if (currentPool != VK_NULL_HANDLE)
+		{
+			fullPools.push_back(currentPool);
+			setsPerPool = std::min(setsPerPool * growthFactor, (uint32_t)maxSetsPerPool);
+		}
+		if (!readyPools.empty())
+		{
+			currentPool = readyPools.back();
+			readyPools.pop_back();
+		}
+		else
+		{
+			currentPool = createPool(setsPerPool);
+		}
+		currentPoolSets = 0;
+	}
+
+public:
+	struct Stats
+	{
+		uint32_t poolsCreated = 0;
+		uint32_t setsAllocated = 0;
+		// Allocations that had to move on to another pool
+		uint32_t poolSwitches = 0;
+	} stats;
+
+	// ratios give the number of descriptors of each type per set
+	// setsPerPool is the size of the first pool
+	void init(VkDevice device, const std::vector<PoolSizeRatio> &ratios, uint32_t setsPerPool = 16)
+	{
+		assert(!ratios.empty() && (setsPerPool > 0));
+		this->device = device;
+		this->ratios = ratios;
+		this->setsPerPool = std::min(setsPerPool, (uint32_t)maxSetsPerPool);
+	}
+
+	// Allocate a descriptor set, growing the pool list if needed
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout)
+	{
+		if (currentPool == VK_NULL_HANDLE)
+		{
+			nextPool();
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo = vkTools::initializers::descriptorSetAllocateInfo(currentPool, &layout, 1);
+		VkDescriptorSet descriptorSet;
+		VkResult err = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+		if (err != VK_SUCCESS)
+		{
+			// Before VK_KHR_maintenance1 an exhausted pool may report any error,
+			// so every failure of a pool that has been used is treated as exhaustion
+			assert((err == VK_ERROR_OUT_OF_POOL_MEMORY_KHR) || (err == RESULT_ERROR_FRAGMENTED_POOL) || (currentPoolSets > 0));
+			nextPool();
+			stats.poolSwitches++;
+			allocInfo.descriptorPool = currentPool;
+			err = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+			// A fresh pool is too small for a single set if the ratios don't match the layout
+			assert(!err);
+		}
+		currentPoolSets++;
+		stats.setsAllocated++;
+		return descriptorSet;
+	}
+
+	// Allocate count descriptor sets with the same layout
+	void allocate(VkDescriptorSetLayout layout, uint32_t count, VkDescriptorSet *descriptorSets)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			descriptorSets[i] = allocate(layout);
+		}
+	}
+
+	// Number of pools owned by the allocator
+	uint32_t poolCount()
+	{
+		return (uint32_t)(fullPools.size() + readyPools.size()) + (currentPool != VK_NULL_HANDLE ? 1 : 0);
+	}
+
+	// Free all sets allocated so far by resetting the pools
+	// The sets must not be in use by the device anymore
+	void reset()
+	{
+		for (auto& pool : fullPools)
+		{
+			vkResetDescriptorPool(device, pool, 0);
+			readyPools.push_back(pool);
+		}
+		fullPools.clear();
+		if (currentPool != VK_NULL_HANDLE)
+		{
+			vkResetDescriptorPool(device, currentPool, 0);
+			currentPoolSets = 0;
+		}
+	}
+
+	void cleanup()
+	{
+		for (auto& pool : fullPools)
+		{
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+		for (auto& pool : readyPools)
+		{
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+		if (currentPool != VK_NULL_HANDLE)
+		{
+			vkDestroyDescriptorPool(device, currentPool, nullptr);
+		}
+		fullPools.clear();
+		readyPools.clear();
+		currentPool = VK_NULL_HANDLE;
+	}
+};
@@ -0,0 +1,451 @@
+/*
+* Class caching descriptor sets by layout and bound resources
+*
+* get() hashes the layout and the resources bound to each binding, and returns
+* the set already written with them on a hit, so identical combinations are
+* allocated and written once
+* The cache holds up to capacity sets, the least recently used ones are evicted
+* and their sets reused for later misses with the same layout
+* Sets referencing a destroyed resource must be invalidated
+*
+* Note : A set is only evicted and rewritten once it has not been used for
+* framesInFlight frames (see nextFrame()), the cache grows beyond its capacity
+* if all sets are more recent
+* A set counts as used by the frame of its last get(), sets bound by command
+* buffers that are submitted again without calling get() (e.g. pre-recorded
+* ones) must be pinned, pinned sets are never evicted
+* Invalidated sets are removed from the cache at once, but only rewritten
+* once they have aged by framesInFlight frames as well
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+#include "vulkandescriptorallocator.hpp"
+
+class VulkanDescriptorSetCache
+{
+public:
+	// Resource bound to one binding of a set
+	// Only the member matching the descriptor type is used
+	struct Binding
+	{
+		uint32_t binding;
+		VkDescriptorType type;
+		VkDescriptorBufferInfo buffer;
+		VkDescriptorImageInfo image;
+		VkBufferView texelBufferView;
+	};
+
+	static Binding buffer(uint32_t binding, VkDescriptorType type, const VkDescriptorBufferInfo &bufferInfo)
+	{
+		Binding result = {};
+		result.binding = binding;
+		result.type = type;
+		result.buffer = bufferInfo;
+		return result;
+	}
+
+	static Binding image(uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo &imageInfo)
+	{
+		Binding result = {};
+		result.binding = binding;
+		result.type = type;
+		result.image = imageInfo;
+		return result;
+	}
+
+	static Binding texelBuffer(uint32_t binding, VkDescriptorType type, VkBufferView bufferView)
+	{
+		Binding result = {};
+		result.binding = binding;
+		result.type = type;
+		result.texelBufferView = bufferView;
+		return result;
+	}
+
+private:
+	struct Entry
+	{
+		uint64_t hash;
+		VkDescriptorSetLayout layout;
+		std::vector<Binding> bindings;
+		VkDescriptorSet descriptorSet;
+		uint64_t lastUsedFrame;
+		uint32_t pinCount;
+	};
+
+	// Set removed from the cache that may still be used by the device
+	struct RetiredSet
+	{
+		VkDescriptorSetLayout layout;
+		VkDescriptorSet descriptorSet;
+		uint64_t lastUsedFrame;
+	};
+
+	// Member of a binding holding its resource
+	enum ResourceKind { RESOURCE_BUFFER, RESOURCE_IMAGE, RESOURCE_TEXEL_BUFFER };
+
+	VkDevice device;
+	VulkanDescriptorAllocator *allocator = nullptr;
+	uint32_t capacity;
+	uint32_t framesInFlight;
+	uint64_t frame = 0;
+
+	// Most recently used first
+	std::list<Entry> entries;
+	std::unordered_multimap<uint64_t, std::list<Entry>::iterator> lookup;
+	// Evicted or invalidated sets by layout, rewritten before new ones are allocated
+	std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> freeSets;
+	// Removed sets waiting for framesInFlight frames before they are added to freeSets
+	std::vector<RetiredSet> retiredSets;
+
+	static ResourceKind resourceKind(VkDescriptorType type)
+	{
+		switch (type)
+		{
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+			return RESOURCE_BUFFER;
+		case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+			return RESOURCE_TEXEL_BUFFER;
+		case VK_DESCRIPTOR_TYPE_SAMPLER:
+		case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+		case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+		case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+		case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+			return RESOURCE_IMAGE;
+		default:
+			// Descriptor types added by extensions are not supported
+			assert(false);
+			return RESOURCE_IMAGE;
+		}
+	}
+
+	static bool equal(const Binding &a, const Binding &b)
+	{
+		if ((a.binding != b.binding) || (a.type != b.type))
+		{
+			return false;
+		}
+		switch (resourceKind(a.type))
+		{
+		case RESOURCE_BUFFER:
+			return (a.buffer.buffer == b.buffer.buffer) && (a.buffer.offset == b.buffer.offset) && (a.buffer.range == b.buffer.range);
+		case RESOURCE_TEXEL_BUFFER:
+			return a.texelBufferView == b.texelBufferView;
+		default:
+			return (a.image.sampler == b.image.sampler) && (a.image.imageView == b.image.imageView) && (a.image.imageLayout == b.image.imageLayout);
+		}
+	}
+
+	static bool equal(const Entry &entry, VkDescriptorSetLayout layout, const std::vector<Binding> &bindings)
+	{
+		if ((entry.layout != layout) || (entry.bindings.size() != bindings.size()))
+		{
+			return false;
+		}
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			if (!equal(entry.bindings[i], bindings[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <typename T>
+	static uint64_t combine(uint64_t hash, const T &value)
+	{
+		return vkTools::hashBytes(&value, sizeof(value), hash);
+	}
+
+	// Only the members compared by equal() are hashed, the others may hold anything
+	static uint64_t hashKey(VkDescriptorSetLayout layout, const std::vector<Binding> &bindings)
+	{
+		uint64_t hash = combine(vkTools::hashBytesSeed, layout);
+		for (auto& binding : bindings)
+		{
+			hash = combine(hash, binding.binding);
+			hash = combine(hash, binding.type);
+			switch (resourceKind(binding.type))
+			{
+			case RESOURCE_BUFFER:
+				hash = combine(hash, binding.buffer.buffer);
+				hash = combine(hash, binding.buffer.offset);
+				hash = combine(hash, binding.buffer.range);
+				break;
+			case RESOURCE_TEXEL_BUFFER:
+				hash = combine(hash, binding.texelBufferView);
+				break;
+			default:
+				hash = combine(hash, binding.image.sampler);
+				hash = combine(hash, binding.image.imageView);
+				hash = combine(hash, binding.image.imageLayout);
+				break;
+			}
+		}
+		return hash;
+	}
+
+	void unlink(std::list<Entry>::iterator entry)
+	{
+		auto range = lookup.equal_range(entry->hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second == entry)
+			{
+				lookup.erase(it);
+				break;
+			}
+		}
+	}
+
+	// Remove an entry and keep its set for reuse once the device is done with it
+	void remove(std::list<Entry>::iterator entry)
+	{
+		unlink(entry);
+		// A pinned set may have been used by the current frame
+		uint64_t lastUsedFrame = entry->pinCount > 0 ? frame : entry->lastUsedFrame;
+		retiredSets.push_back({ entry->layout, entry->descriptorSet, lastUsedFrame });
+		entries.erase(entry);
+	}
+
+	std::list<Entry>::iterator find(VkDescriptorSet descriptorSet)
+	{
+		for (auto it = entries.begin(); it != entries.end(); ++it)
+		{
+			if (it->descriptorSet == descriptorSet)
+			{
+				return it;
+			}
+		}
+		return entries.end();
+	}
+
+	// Move the retired sets not used for framesInFlight frames to the free sets
+	void releaseRetiredSets()
+	{
+		for (size_t i = 0; i < retiredSets.size();)
+		{
+			if (retiredSets[i].lastUsedFrame + framesInFlight > frame)
+			{
+				i++;
+				continue;
+			}
+			freeSets[retiredSets[i].layout].push_back(retiredSets[i].descriptorSet);
+			retiredSets[i] = retiredSets.back();
+			retiredSets.pop_back();
+		}
+	}
+
+	void evict()
+	{
+		// Least recently used first, skipping the pinned sets
+		auto next = entries.end();
+		while ((entries.size() >= capacity) && (next != entries.begin()))
+		{
+			auto entry = std::prev(next);
+			if (entry->pinCount > 0)
+			{
+				next = entry;
+				continue;
+			}
+			if (entry->lastUsedFrame + framesInFlight > frame)
+			{
+				// Possibly still in use by the device, and so are the more recent ones
+				break;
+			}
+			remove(entry);
+			stats.evictions++;
+		}
+		// Evicted sets are old enough to be reused at once
+		releaseRetiredSets();
+	}
+
+	// Remove the entries with a binding matching a predicate
+	template <typename Predicate>
+	void invalidate(Predicate predicate)
+	{
+		for (auto it = entries.begin(); it != entries.end();)
+		{
+			auto next = std::next(it);
+			for (auto& binding : it->bindings)
+			{
+				if (predicate(binding))
+				{
+					remove(it);
+					stats.invalidations++;
+					break;
+				}
+			}
+			it = next;
+		}
+	}
+
+public:
+	struct Stats
+	{
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+		uint32_t evictions = 0;
+		uint32_t invalidations = 0;
+		// Misses served by rewriting an evicted or invalidated set
+		uint32_t reused = 0;
+	} stats;
+
+	// Sets are allocated from allocator, which must outlive the cache
+	// framesInFlight is the number of frames a set may still be used by the device after its last get()
+	void init(VkDevice device, VulkanDescriptorAllocator *allocator, uint32_t capacity = 256, uint32_t framesInFlight = 2)
+	{
+		assert(capacity > 0);
+		this->device = device;
+		this->allocator = allocator;
+		this->capacity = capacity;
+		this->framesInFlight = framesInFlight;
+	}
+
+	// Returns a set of the layout with the given resources bound, writing it on a miss
+	VkDescriptorSet get(VkDescriptorSetLayout layout, const std::vector<Binding> &bindings)
+	{
+		uint64_t hash = hashKey(layout, bindings);
+		auto range = lookup.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (equal(*it->second, layout, bindings))
+			{
+				// Move to the front of the LRU list
+				entries.splice(entries.begin(), entries, it->second);
+				it->second->lastUsedFrame = frame;
+				stats.hits++;
+				return it->second->descriptorSet;
+			}
+		}
+
+		stats.misses++;
+		evict();
+		VkDescriptorSet descriptorSet;
+		std::vector<VkDescriptorSet> &layoutFreeSets = freeSets[layout];
+		if (!layoutFreeSets.empty())
+		{
+			descriptorSet = layoutFreeSets.back();
+			layoutFreeSets.pop_back();
+			stats.reused++;
+		}
+		else
+		{
+			descriptorSet = allocator->allocate(layout);
+		}
+
+		entries.push_front({ hash, layout, bindings, descriptorSet, frame, 0 });
+		lookup.insert({ hash, entries.begin() });
+
+		// The writes point at the copy of the bindings stored in the entry
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		for (auto& binding : entries.front().bindings)
+		{
+			switch (resourceKind(binding.type))
+			{
+			case RESOURCE_BUFFER:
+				writeDescriptorSets.push_back(vkTools::initializers::writeDescriptorSet(descriptorSet, binding.type, binding.binding, &binding.buffer));
+				break;
+			case RESOURCE_TEXEL_BUFFER:
+				writeDescriptorSets.push_back(vkTools::initializers::writeDescriptorSet(descriptorSet, binding.type, binding.binding, &binding.texelBufferView));
+				break;
+			default:
+				writeDescriptorSets.push_back(vkTools::initializers::writeDescriptorSet(descriptorSet, binding.type, binding.binding, &binding.image));
+				break;
+			}
+		}
+		vkUpdateDescriptorSets(device, (uint32_t)writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		return descriptorSet;
+	}
+
+	// Keep a set returned by get() until unpin(), for sets bound by command buffers
+	// that are submitted again without calling get()
+	// Pins are counted, the set must still be in the cache
+	void pin(VkDescriptorSet descriptorSet)
+	{
+		auto entry = find(descriptorSet);
+		assert(entry != entries.end());
+		entry->pinCount++;
+	}
+
+	// The set can be evicted once it has not been used for framesInFlight frames
+	// Sets invalidated while pinned are no longer in the cache and are ignored
+	void unpin(VkDescriptorSet descriptorSet)
+	{
+		auto entry = find(descriptorSet);
+		if (entry == entries.end())
+		{
+			return;
+		}
+		assert(entry->pinCount > 0);
+		entry->pinCount--;
+		entry->lastUsedFrame = frame;
+	}
+
+	// Call once per frame, sets not used for framesInFlight frames can then be evicted
+	// and invalidated sets reused
+	void nextFrame()
+	{
+		frame++;
+		releaseRetiredSets();
+	}
+
+	// Forget the sets referencing a resource, call before destroying it
+	void invalidateBuffer(VkBuffer buffer)
+	{
+		invalidate([buffer](const Binding &binding) { return (resourceKind(binding.type) == RESOURCE_BUFFER) && (binding.buffer.buffer == buffer); });
+	}
+
+	void invalidateBufferView(VkBufferView bufferView)
+	{
+		invalidate([bufferView](const Binding &binding) { return (resourceKind(binding.type) == RESOURCE_TEXEL_BUFFER) && (binding.texelBufferView == bufferView); });
+	}
+
+	void invalidateImageView(VkImageView imageView)
+	{
+		invalidate([imageView](const Binding &binding) { return (resourceKind(binding.type) == RESOURCE_IMAGE) && (binding.image.imageView == imageView); });
+	}
+
+	void invalidateSampler(VkSampler sampler)
+	{
+		invalidate([sampler](const Binding &binding) { return (resourceKind(binding.type) == RESOURCE_IMAGE) && (binding.image.sampler == sampler); });
+	}
+
+	uint32_t size() const
+	{
+		return (uint32_t)entries.size();
+	}
+
+	// Fraction of the lookups served from the cache
+	float hitRate() const
+	{
+		uint32_t lookups = stats.hits + stats.misses;
+		return lookups > 0 ? (float)stats.hits / lookups : 0.0f;
+	}
+
+	// The sets themselves are owned by the allocator
+	void cleanup()
+	{
+		entries.clear();
+		lookup.clear();
+		freeSets.clear();
+		retiredSets.clear();
+	}
+};
@@ -0,0 +1,213 @@
+/*
+* Class updating descriptor sets of one layout from packed structures
+*
+* The entries describe where the descriptor infos (VkDescriptorBufferInfo,
+* VkDescriptorImageInfo or VkBufferView) of each binding are in the structure
+* With VK_KHR_descriptor_update_template they are compiled once into a template
+* and the driver reads the structure directly
+* Otherwise the writes of all updated sets are built from the entries and
+* submitted in a single vkUpdateDescriptorSets call
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "vulkanextensions.h"
+
+class VulkanDescriptorUpdateTemplate
+{
+public:
+	struct Entry
+	{
+		uint32_t binding;
+		uint32_t arrayElement;
+		uint32_t descriptorCount;
+		VkDescriptorType type;
+		// Position of the first info in the structure and distance between consecutive infos, in bytes
+		size_t offset;
+		size_t stride;
+	};
+
+	// Entry for descriptorCount consecutive infos at offset (e.g. offsetof a member)
+	static Entry entry(uint32_t binding, VkDescriptorType type, size_t offset, uint32_t descriptorCount = 1, uint32_t arrayElement = 0)
+	{
+		return { binding, arrayElement, descriptorCount, type, offset, infoSize(type) };
+	}
+
+private:
+	VkDevice device;
+	std::vector<Entry> entries;
+	VkDescriptorUpdateTemplateKHR updateTemplate = VK_NULL_HANDLE;
+
+	PFN_vkCreateDescriptorUpdateTemplateKHR fpCreateDescriptorUpdateTemplateKHR = nullptr;
+	PFN_vkDestroyDescriptorUpdateTemplateKHR fpDestroyDescriptorUpdateTemplateKHR = nullptr;
+	PFN_vkUpdateDescriptorSetWithTemplateKHR fpUpdateDescriptorSetWithTemplateKHR = nullptr;
+
+	// Writes of the fallback path, kept to avoid reallocating them for every update
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+
+	enum InfoType { BUFFER_INFO, TEXEL_BUFFER_VIEW, IMAGE_INFO };
+
+	static InfoType infoType(VkDescriptorType type)
+	{
+		switch (type)
+		{
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+			return BUFFER_INFO;
+		case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+			return TEXEL_BUFFER_VIEW;
+		default:
+			return IMAGE_INFO;
+		}
+	}
+
+	static size_t infoSize(VkDescriptorType type)
+	{
+		switch (infoType(type))
+		{
+		case BUFFER_INFO:
+			return sizeof(VkDescriptorBufferInfo);
+		case TEXEL_BUFFER_VIEW:
+			return sizeof(VkBufferView);
+		default:
+			return sizeof(VkDescriptorImageInfo);
+		}
+	}
+
+	// Point a write at its infos
+	static void setInfos(VkWriteDescriptorSet &writeDescriptorSet, const uint8_t *infos)
+	{
+		switch (infoType(writeDescriptorSet.descriptorType))
+		{
+		case BUFFER_INFO:
+			writeDescriptorSet.pBufferInfo = (const VkDescriptorBufferInfo*)infos;
+			break;
+		case TEXEL_BUFFER_VIEW:
+			writeDescriptorSet.pTexelBufferView = (const VkBufferView*)infos;
+			break;
+		default:
+			writeDescriptorSet.pImageInfo = (const VkDescriptorImageInfo*)infos;
+			break;
+		}
+	}
+
+	void appendWrites(VkDescriptorSet descriptorSet, const uint8_t *data)
+	{
+		for (auto& entry : entries)
+		{
+			VkWriteDescriptorSet writeDescriptorSet = {};
+			writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeDescriptorSet.dstSet = descriptorSet;
+			writeDescriptorSet.dstBinding = entry.binding;
+			writeDescriptorSet.descriptorType = entry.type;
+			if (entry.stride == infoSize(entry.type))
+			{
+				// Tightly packed infos are written at once
+				writeDescriptorSet.dstArrayElement = entry.arrayElement;
+				writeDescriptorSet.descriptorCount = entry.descriptorCount;
+				setInfos(writeDescriptorSet, data + entry.offset);
+				writeDescriptorSets.push_back(writeDescriptorSet);
+				continue;
+			}
+			writeDescriptorSet.descriptorCount = 1;
+			for (uint32_t i = 0; i < entry.descriptorCount; i++)
+			{
+				writeDescriptorSet.dstArrayElement = entry.arrayElement + i;
+				setInfos(writeDescriptorSet, data + entry.offset + i * entry.stride);
+				writeDescriptorSets.push_back(writeDescriptorSet);
+			}
+		}
+	}
+
+public:
+	// Templates are used if VK_KHR_descriptor_update_template has been enabled on the device
+	void init(VkDevice device, bool descriptorUpdateTemplateEnabled)
+	{
+		this->device = device;
+		if (descriptorUpdateTemplateEnabled)
+		{
+			fpCreateDescriptorUpdateTemplateKHR = (PFN_vkCreateDescriptorUpdateTemplateKHR)vkGetDeviceProcAddr(device, "vkCreateDescriptorUpdateTemplateKHR");
+			fpDestroyDescriptorUpdateTemplateKHR = (PFN_vkDestroyDescriptorUpdateTemplateKHR)vkGetDeviceProcAddr(device, "vkDestroyDescriptorUpdateTemplateKHR");
+			fpUpdateDescriptorSetWithTemplateKHR = (PFN_vkUpdateDescriptorSetWithTemplateKHR)vkGetDeviceProcAddr(device, "vkUpdateDescriptorSetWithTemplateKHR");
+		}
+	}
+
+	// Describe the structure sets of layout are updated from
+	// Compiles the template if templates are supported
+	void create(VkDescriptorSetLayout layout, const std::vector<Entry> &entries)
+	{
+		assert(updateTemplate == VK_NULL_HANDLE);
+		this->entries = entries;
+		if (fpCreateDescriptorUpdateTemplateKHR == nullptr)
+		{
+			return;
+		}
+
+		std::vector<VkDescriptorUpdateTemplateEntryKHR> templateEntries;
+		for (auto& entry : entries)
+		{
+			templateEntries.push_back({ entry.binding, entry.arrayElement, entry.descriptorCount, entry.type, entry.offset, entry.stride });
+		}
+		VkDescriptorUpdateTemplateCreateInfoKHR templateCreateInfo = {};
+		templateCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+		templateCreateInfo.descriptorUpdateEntryCount = (uint32_t)templateEntries.size();
+		templateCreateInfo.pDescriptorUpdateEntries = templateEntries.data();
+		templateCreateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+		templateCreateInfo.descriptorSetLayout = layout;
+		VkResult err = fpCreateDescriptorUpdateTemplateKHR(device, &templateCreateInfo, nullptr, &updateTemplate);
+		assert(!err);
+	}
+
+	// True if updates go through the template, false if they use write arrays
+	bool usesTemplate() const
+	{
+		return updateTemplate != VK_NULL_HANDLE;
+	}
+
+	// Update a set from a structure laid out as described by the entries
+	void update(VkDescriptorSet descriptorSet, const void *data)
+	{
+		update(1, &descriptorSet, data, 0);
+	}
+
+	// Update several sets, the structure of set i is at data + i * dataStride
+	void update(uint32_t setCount, const VkDescriptorSet *descriptorSets, const void *data, size_t dataStride)
+	{
+		const uint8_t *setData = (const uint8_t*)data;
+		if (usesTemplate())
+		{
+			for (uint32_t i = 0; i < setCount; i++)
+			{
+				fpUpdateDescriptorSetWithTemplateKHR(device, descriptorSets[i], updateTemplate, setData + i * dataStride);
+			}
+			return;
+		}
+
+		writeDescriptorSets.clear();
+		for (uint32_t i = 0; i < setCount; i++)
+		{
+			appendWrites(descriptorSets[i], setData + i * dataStride);
+		}
+		vkUpdateDescriptorSets(device, (uint32_t)writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+	}
+
+	void cleanup()
+	{
+		if (updateTemplate != VK_NULL_HANDLE)
+		{
+			fpDestroyDescriptorUpdateTemplateKHR(device, updateTemplate, nullptr);
+			updateTemplate = VK_NULL_HANDLE;
+		}
+		entries.clear();
+	}
+};
@@ -8,6 +8,11 @@
 
 #include "vulkanexamplebase.h"
 
+#include <fstream>
+
+std::vector<const char*> VulkanExampleBase::args;
+bool VulkanExampleBase::headless = false;
+
 VkResult VulkanExampleBase::createInstance(bool enableValidation)
 {
 	this->enableValidation = enableValidation;
@@ -20,17 +25,28 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	// todo : Use VK_API_VERSION 
 	appInfo.apiVersion = VK_MAKE_VERSION(1, 0, 2);
 
-	std::vector<const char*> enabledExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+	std::vector<const char*> enabledExtensions;
 
+	if (!headless)
+	{
+		enabledExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #ifdef _WIN32
-	enabledExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #else
-	// todo : linux/android
-	enabledExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+		// todo : linux/android
+		enabledExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #endif
+	}
 
 	// todo : check if all extensions are present
 
+	// Needed to query the features of device extensions (e.g. descriptor indexing)
+	if (vkTools::checkGlobalExtensionPresent(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+	{
+		enabledExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		physicalDeviceProperties2Enabled = true;
+	}
+
 	VkInstanceCreateInfo instanceCreateInfo = {};
 	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instanceCreateInfo.pNext = NULL;
@@ -54,14 +70,74 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 
 VkResult VulkanExampleBase::createDevice(VkDeviceQueueCreateInfo requestedQueues, bool enableValidation)
 {
-	std::vector<const char*> enabledExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	std::vector<const char*> enabledExtensions;
+	if (!headless)
+	{
+		enabledExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
+
+	// Indirect drawing : enable drawing multiple commands per call if supported
+	// and let the draw count be sourced from a buffer if the extension is present
+	enabledFeatures.multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+	enabledFeatures.drawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance;
+	if (vkTools::checkDeviceExtensionPresent(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+	{
+		enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		drawIndirectCountEnabled = true;
+	}
+	// Descriptor update templates : update sets from packed structures
+	if (vkTools::checkDeviceExtensionPresent(physicalDevice, VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME))
+	{
+		enabledExtensions.push_back(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+		descriptorUpdateTemplateEnabled = true;
+	}
 
 	VkDeviceCreateInfo deviceCreateInfo = {};
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	deviceCreateInfo.pNext = NULL;
+
+	// Descriptor indexing : enable update after bind, partially bound and runtime sized
+	// arrays of sampled images and storage buffers for bindless resource tables if supported
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures = {};
+	descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	if (physicalDeviceProperties2Enabled &&
+		vkTools::checkDeviceExtensionPresent(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+		vkTools::checkDeviceExtensionPresent(physicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME))
+	{
+		PFN_vkGetPhysicalDeviceFeatures2KHR fpGetPhysicalDeviceFeatures2KHR =
+			(PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+		supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &supported;
+		fpGetPhysicalDeviceFeatures2KHR(physicalDevice, &features2);
+		// bindless.vert indexes the storage buffer array with a push constant, which needs the core dynamic indexing feature
+		if (deviceFeatures.shaderStorageBufferArrayDynamicIndexing &&
+			supported.runtimeDescriptorArray && supported.descriptorBindingPartiallyBound &&
+			supported.descriptorBindingUpdateUnusedWhilePending &&
+			supported.descriptorBindingSampledImageUpdateAfterBind &&
+			supported.descriptorBindingStorageBufferUpdateAfterBind)
+		{
+			enabledFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+			descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+			// Lets shaders index with values that differ between invocations (e.g. per instance)
+			descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = supported.shaderSampledImageArrayNonUniformIndexing;
+			descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing = supported.shaderStorageBufferArrayNonUniformIndexing;
+			enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			deviceCreateInfo.pNext = &descriptorIndexingFeatures;
+			descriptorIndexingEnabled = true;
+		}
+	}
+
 	deviceCreateInfo.queueCreateInfoCount = 1;
 	deviceCreateInfo.pQueueCreateInfos = &requestedQueues;
-	deviceCreateInfo.pEnabledFeatures = NULL;
+	deviceCreateInfo.pEnabledFeatures = &enabledFeatures;
 
 	if (enabledExtensions.size() > 0)
 	{
@@ -119,102 +195,171 @@ void VulkanExampleBase::createCommandBuffers()
 
 void VulkanExampleBase::destroyCommandBuffers()
 {
+	// Not created when headless
+	if (drawCmdBuffers.empty())
+	{
+		return;
+	}
 	vkFreeCommandBuffers(device, cmdPool, (uint32_t)drawCmdBuffers.size(), drawCmdBuffers.data());
 	vkFreeCommandBuffers(device, cmdPool, 1, &postPresentCmdBuffer);
 }
 
 void VulkanExampleBase::createSetupCommandBuffer()
 {
-	if (setupCmdBuffer != VK_NULL_HANDLE)
-	{
-		vkFreeCommandBuffers(device, cmdPool, 1, &setupCmdBuffer);
-		setupCmdBuffer = VK_NULL_HANDLE; // todo : check if still necessary
-	}
-
-	VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-		vkTools::initializers::commandBufferAllocateInfo(
-			cmdPool,
-			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-			1);
-
-	VkResult vkRes = vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &setupCmdBuffer);
-	assert(!vkRes);
-
-	// todo : Command buffer is also started here, better put somewhere else
-	// todo : Check if necessaray at all...
-	VkCommandBufferBeginInfo cmdBufInfo = {};
-	cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	// todo : check null handles, flags?
-
-	vkRes = vkBeginCommandBuffer(setupCmdBuffer, &cmdBufInfo);
-	assert(!vkRes);
+	// Setup commands are appended to the batch currently recorded by the setup context
+	// so several setup steps end up in a single submission
+	setupCmdBuffer = setupContext.commandBuffer();
 }
 
 void VulkanExampleBase::flushSetupCommandBuffer()
 {
-	VkResult err;
-
 	if (setupCmdBuffer == VK_NULL_HANDLE)
 		return;
 
-	err = vkEndCommandBuffer(setupCmdBuffer);
-	assert(!err);
-
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &setupCmdBuffer;
-
-	err = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-	assert(!err);
-
-	err = vkQueueWaitIdle(queue);
-	assert(!err);
+	// Only wait for the setup batch instead of draining the whole queue
+	setupContext.wait(submitSetupCommandBuffer());
+}
 
-	vkFreeCommandBuffers(device, cmdPool, 1, &setupCmdBuffer);
-	setupCmdBuffer = VK_NULL_HANDLE; // todo : check if still necessary
+uint64_t VulkanExampleBase::submitSetupCommandBuffer()
+{
+	uint64_t value = setupContext.submit();
+	setupCmdBuffer = VK_NULL_HANDLE;
+	return value;
 }
 
 void VulkanExampleBase::createPipelineCache()
 {
-	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
-	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	VkResult err = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
-	assert(!err);
+	CPU_PROFILE_SCOPE("createPipelineCache");
+	// Reuse the pipelines compiled by previous runs if the file matches this device
+	persistentPipelineCache.init(device, deviceProperties);
+	persistentPipelineCache.create(usePipelineCacheFile ? name + "_pipelinecache.bin" : "");
+	pipelineCache = persistentPipelineCache.cache;
+}
+
+void VulkanExampleBase::updatePipelineCache()
+{
+	persistentPipelineCache.saveIfDue();
 }
 
 void VulkanExampleBase::prepare()
 {
+	CPU_PROFILE_SCOPE("VulkanExampleBase::prepare");
 	if (enableValidation)
 	{
 		vkDebug::setupDebugging(instance, VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT, NULL);
 	}
 
 	createCommandPool();
+	setupContext.init(device, queue, cmdPool);
+	shaderModuleCache.init(device);
+	if (useShaderArchive && !shaderArchive.open("./../data/shaders/shaders.vksa"))
+	{
+		std::cout << "Shader archive not found or invalid, loading shaders from their files\n";
+	}
+	if (shaderArchive.isOpen())
+	{
+		// A stale archive would silently shadow the rebuilt shader files
+		std::string newerFile = shaderArchive.newerShaderFile("./../data/shaders/");
+		if (!newerFile.empty())
+		{
+			std::cout << "Shader archive is older than " << newerFile << " (repack it with the shaders build target), loading shaders from their files\n";
+			shaderArchive.close();
+		}
+	}
 	createSetupCommandBuffer();
-	setupSwapChain();
-	createCommandBuffers();
+	if (!headless)
+	{
+		setupSwapChain();
+		createCommandBuffers();
+	}
+	if (gpuProfiling)
+	{
+		gpuProfiler.init(device, deviceProperties.limits.timestampPeriod, timestampValidBits, (uint32_t)drawCmdBuffers.size() + 1);
+		if (!gpuProfiler.enabled())
+		{
+			std::cout << "Timestamps are not supported by the graphics queue, GPU profiler disabled\n";
+		}
+	}
 	setupDepthStencil();
 	setupRenderPass();
 	createPipelineCache();
-	setupFrameBuffer();
-	flushSetupCommandBuffer();
+	if (!headless)
+	{
+		setupFrameBuffer();
+	}
+	// Don't wait for the layout transitions, they can drain while the
+	// derived class prepares its resources
+	submitSetupCommandBuffer();
 	// Recreate setup command buffer for derived class
 	createSetupCommandBuffer();
 }
 
 VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(const char * fileName, VkShaderStageFlagBits stage)
 {
+	CPU_PROFILE_SCOPE("loadShader");
 	VkPipelineShaderStageCreateInfo shaderStage = {};
 	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStage.stage = stage;
-	shaderStage.module = vkTools::loadShader(fileName, device, stage);
+	size_t codeSize = 0;
+	uint64_t codeHash;
+	const uint32_t *code = shaderArchive.find(VulkanShaderArchive::shaderName(fileName), &codeSize, &codeHash);
+	// Code served by the archive comes with the hash the module cache is keyed by
+	bool codeHashed = code != nullptr;
+	VulkanMappedFile file;
+	if ((code == nullptr) && optimizeShaders)
+	{
+		if (!file.open(fileName) || !file.isSpirv())
+		{
+			vkTools::exitFatal(std::string("Could not load shader file ") + fileName, "Fatal error");
+		}
+		code = (const uint32_t*)file.data();
+		codeSize = file.size();
+	}
+	std::vector<uint32_t> optimizedCode;
+	vkSpirvOptimizer::Report report;
+	if ((code != nullptr) && optimizeShaders && vkSpirvOptimizer::optimize(code, codeSize, &optimizedCode, &report))
+	{
+		std::cout << "Optimized " << fileName << " : " << vkSpirvOptimizer::toString(report) << "\n";
+		code = optimizedCode.data();
+		codeSize = optimizedCode.size() * sizeof(uint32_t);
+		codeHashed = false;
+	}
+	if (code == nullptr)
+	{
+		shaderStage.module = shaderModuleCache.acquireFile(fileName);
+	}
+	else
+	{
+		shaderStage.module = codeHashed ? shaderModuleCache.acquire(code, codeSize, codeHash, fileName) : shaderModuleCache.acquire(code, codeSize, fileName);
+	}
 	shaderStage.pName = "main"; // todo : make param
 	assert(shaderStage.module != NULL);
 	shaderModules.push_back(shaderStage.module);
 	return shaderStage;
 }
 
+VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(const char * fileName, VkShaderStageFlagBits stage, VulkanSpecializationConstants &constants)
+{
+	return constants.apply(loadShader(fileName, stage));
+}
+
+void VulkanExampleBase::releaseShaderModules()
+{
+	for (auto& shaderModule : shaderModules)
+	{
+		// GLSL modules are not shared
+		if (shaderModuleCache.contains(shaderModule))
+		{
+			shaderModuleCache.release(shaderModule);
+		}
+		else
+		{
+			vkDestroyShaderModule(device, shaderModule, nullptr);
+		}
+	}
+	shaderModules.clear();
+}
+
 VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShaderGLSL(const char * fileName, VkShaderStageFlagBits stage)
 {
 	VkPipelineShaderStageCreateInfo shaderStage = {};
@@ -335,6 +480,9 @@ void VulkanExampleBase::submitPostPresentBarrier(VkImage image)
 
 	VkImageMemoryBarrier postPresentBarrier = vkTools::postPresentBarrier(image);
 
+	uint32_t postPresentSlot = (uint32_t)drawCmdBuffers.size();
+	gpuProfiler.beginSlot(postPresentCmdBuffer, postPresentSlot);
+	uint32_t scope = gpuProfiler.begin(postPresentCmdBuffer, "post present barrier");
 	vkCmdPipelineBarrier(
 		postPresentCmdBuffer,
 		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
@@ -343,6 +491,7 @@ void VulkanExampleBase::submitPostPresentBarrier(VkImage image)
 		0, NULL, // No memory barriers,
 		0, NULL, // No buffer barriers,
 		1, &postPresentBarrier);
+	gpuProfiler.end(postPresentCmdBuffer, scope);
 
 	vkRes = vkEndCommandBuffer(postPresentCmdBuffer);
 	assert(!vkRes);
@@ -354,9 +503,167 @@ void VulkanExampleBase::submitPostPresentBarrier(VkImage image)
 
 	vkRes = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
 	assert(!vkRes);
+	gpuProfiler.submitted(postPresentSlot);
 
-	vkRes = vkQueueWaitIdle(queue);
-	assert(!vkRes);
+	// Also waits for the frame submitted before the barrier
+	waitQueueIdle();
+}
+
+void VulkanExampleBase::advanceTimer(float frameTime)
+{
+	frameTimer = frameTime;
+	// Convert to clamped timer value
+	if (!paused)
+	{
+		timer += timerSpeed * frameTimer;
+		if (timer > 1.0)
+		{
+			timer -= 1.0f;
+		}
+	}
+}
+
+void VulkanExampleBase::waitDeviceIdle()
+{
+	CPU_PROFILE_SCOPE("waitDeviceIdle");
+	auto tStart = std::chrono::high_resolution_clock::now();
+	VkResult err = vkDeviceWaitIdle(device);
+	assert(!err);
+	deviceWaitTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+}
+
+void VulkanExampleBase::printGpuProfile()
+{
+	if (!gpuProfiler.enabled())
+	{
+		return;
+	}
+	std::cout << "GPU :";
+	for (auto& scope : gpuProfiler.averages())
+	{
+		std::cout << " " << scope.first << " " << scope.second << " ms,";
+	}
+	std::cout << " " << gpuProfiler.stats.notReady << " results dropped\n";
+}
+
+void VulkanExampleBase::waitQueueIdle()
+{
+	CPU_PROFILE_SCOPE("waitQueueIdle");
+	auto tStart = std::chrono::high_resolution_clock::now();
+	VkResult err = vkQueueWaitIdle(queue);
+	assert(!err);
+	deviceWaitTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+}
+
+void VulkanExampleBase::updateCpuProfile()
+{
+	if (!cpuProfile.file.empty() && (++cpuProfile.frame == cpuProfile.frameCount))
+	{
+		writeCpuProfile();
+	}
+}
+
+void VulkanExampleBase::writeCpuProfile()
+{
+	if (cpuProfile.file.empty())
+	{
+		return;
+	}
+	VulkanCpuProfiler::stop();
+	uint64_t recorded, dropped;
+	VulkanCpuProfiler::counts(&recorded, &dropped);
+	if (VulkanCpuProfiler::writeChromeTrace(cpuProfile.file))
+	{
+		std::cout << "CPU profile of " << cpuProfile.frame << " frames written to " << cpuProfile.file
+			<< " (" << recorded << " zones, " << dropped << " dropped)\n";
+	}
+	else
+	{
+		std::cout << "Could not write the CPU profile to " << cpuProfile.file << "\n";
+	}
+	// Written once
+	cpuProfile.file.clear();
+}
+
+bool VulkanExampleBase::runFixedFrameBenchmark()
+{
+	if (!fixedFrameBenchmark.enabled)
+	{
+		return false;
+	}
+
+	// Start from the same state in every run
+	setupContext.waitAll();
+	while (!prepared)
+	{
+		render();
+	}
+	prepareFixedFrameBenchmark();
+	timer = 0.0f;
+	paused = false;
+
+	// Frames are rendered one at a time, so the frame time is the sum of
+	// the time the host spent on it and the time it waited for the device
+	VulkanFrameTimes frameTimes;
+	VulkanFrameTimes cpuTimes;
+	VulkanFrameTimes gpuTimes;
+	uint32_t totalFrameCount = fixedFrameBenchmark.warmupFrames + fixedFrameBenchmark.frameCount;
+	for (uint32_t frame = 0; frame < totalFrameCount; frame++)
+	{
+		// Animations advance by the same step whatever the actual frame time
+		advanceTimer(fixedFrameBenchmark.deltaTime);
+		deviceWaitTime = 0.0;
+		auto tStart = std::chrono::high_resolution_clock::now();
+		render();
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		updateCpuProfile();
+		if (frame < fixedFrameBenchmark.warmupFrames)
+		{
+			continue;
+		}
+		double frameTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		frameTimes.add(frameTime);
+		cpuTimes.add(frameTime - deviceWaitTime);
+		gpuTimes.add(deviceWaitTime);
+	}
+
+	const char *names[3] = { "frame", "cpu", "gpu wait" };
+	const char *keys[3] = { "frame", "cpu", "gpu_wait" };
+	VulkanFrameTimes::Summary summaries[3] = { frameTimes.summary(), cpuTimes.summary(), gpuTimes.summary() };
+	std::cout << "Fixed frame benchmark (" << fixedFrameBenchmark.warmupFrames << " warm-up frames, " << fixedFrameBenchmark.frameCount
+		<< " frames, " << fixedFrameBenchmark.deltaTime * 1000.0f << " ms per frame)\n";
+	std::cout << "ms\tmin\tavg\tp50\tp95\tp99\tmax\n";
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const VulkanFrameTimes::Summary &summary = summaries[i];
+		std::cout << names[i] << "\t" << summary.min << "\t" << summary.mean << "\t" << summary.median << "\t"
+			<< summary.p95 << "\t" << summary.p99 << "\t" << summary.max << "\n";
+	}
+	printGpuProfile();
+
+	if (!fixedFrameBenchmark.outputFile.empty())
+	{
+		std::ofstream file(fixedFrameBenchmark.outputFile);
+		file << "{\n\"name\": \"" << name << "\",\n\"warmup_frames\": " << fixedFrameBenchmark.warmupFrames
+			<< ",\n\"delta_time\": " << fixedFrameBenchmark.deltaTime << ",\n";
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			file << "\"" << keys[i] << "\": { ";
+			VulkanFrameTimes::writeJson(file, summaries[i]);
+			file << " }" << (i < 2 ? ",\n" : "\n");
+		}
+		file << "}\n";
+		if (!file)
+		{
+			std::cout << "Could not write " << fixedFrameBenchmark.outputFile << "\n";
+		}
+	}
+	return true;
+}
+
+void VulkanExampleBase::prepareFixedFrameBenchmark()
+{
+	// For overriding on derived class
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -371,9 +678,75 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 		}
 	}
 #endif
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		std::string arg = args[i];
+		if (arg == std::string("-validation"))
+		{
+			enableValidation = true;
+		}
+		if (arg == std::string("-no-pipeline-cache"))
+		{
+			usePipelineCacheFile = false;
+		}
+		if (arg == std::string("-no-shader-archive"))
+		{
+			useShaderArchive = false;
+		}
+		if (arg == std::string("-optimize-shaders"))
+		{
+			optimizeShaders = true;
+		}
+		if ((arg == std::string("-cpu-profile")) && (i + 1 < args.size()))
+		{
+			cpuProfile.file = args[++i];
+		}
+		if ((arg == std::string("-cpu-profile-frames")) && (i + 1 < args.size()))
+		{
+			cpuProfile.frameCount = (uint32_t)atoi(args[++i]);
+		}
+		if (arg == std::string("-gpu-profiler"))
+		{
+			gpuProfiling = true;
+		}
+		if (arg == std::string("-benchmark"))
+		{
+			fixedFrameBenchmark.enabled = true;
+		}
+		if ((arg == std::string("-benchmark-warmup")) && (i + 1 < args.size()))
+		{
+			fixedFrameBenchmark.warmupFrames = (uint32_t)atoi(args[++i]);
+		}
+		if ((arg == std::string("-benchmark-frames")) && (i + 1 < args.size()))
+		{
+			fixedFrameBenchmark.frameCount = (uint32_t)atoi(args[++i]);
+		}
+		if ((arg == std::string("-benchmark-delta")) && (i + 1 < args.size()))
+		{
+			fixedFrameBenchmark.deltaTime = (float)atof(args[++i]);
+		}
+		if ((arg == std::string("-benchmark-output")) && (i + 1 < args.size()))
+		{
+			fixedFrameBenchmark.outputFile = args[++i];
+		}
+	}
+
+	// Started before initialization to capture the whole startup
+	if (!cpuProfile.file.empty())
+	{
+#ifdef ENABLE_CPU_PROFILER
+		VulkanCpuProfiler::start();
+		CPU_PROFILE_THREAD("render");
+#else
+		std::cout << "CPU profiler zones are compiled out (ENABLE_CPU_PROFILER is not defined), the profile will be empty\n";
+#endif
+	}
 
 #ifndef _WIN32
-	initxcbConnection();
+	if (!headless)
+	{
+		initxcbConnection();
+	}
 #endif
 	initVulkan(enableValidation);
 	// Enable console if validation is active
@@ -388,14 +761,16 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	// Exited before the profiled frames have been rendered
+	writeCpuProfile();
 	// Clean up Vulkan resources
-	swapChain.cleanup();
-	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-	if (setupCmdBuffer != VK_NULL_HANDLE) 
+	if (!headless)
 	{
-		vkFreeCommandBuffers(device, cmdPool, 1, &setupCmdBuffer);
-
+		swapChain.cleanup();
 	}
+	descriptorAllocator.cleanup();
+	// Waits for pending setup batches and frees their command buffers
+	setupContext.cleanup();
 	destroyCommandBuffers();
 	vkDestroyRenderPass(device, renderPass, nullptr);
 	for (uint32_t i = 0; i < frameBuffers.size(); i++)
@@ -403,15 +778,16 @@ VulkanExampleBase::~VulkanExampleBase()
 		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
 	}
 
-	for (auto& shaderModule : shaderModules)
-	{
-		vkDestroyShaderModule(device, shaderModule, nullptr);
-	}
+	releaseShaderModules();
+	shaderModuleCache.cleanup();
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.mem, nullptr);
 
-	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+	gpuProfiler.cleanup();
+
+	// Saves the cache to disk before destroying it
+	persistentPipelineCache.cleanup();
 
 	vkDestroyCommandPool(device, cmdPool, nullptr);
 
@@ -425,13 +801,17 @@ VulkanExampleBase::~VulkanExampleBase()
 	vkDestroyInstance(instance, nullptr);
 
 #ifndef _WIN32
-	xcb_destroy_window(connection, window);
-	xcb_disconnect(connection);
+	if (!headless)
+	{
+		xcb_destroy_window(connection, window);
+		xcb_disconnect(connection);
+	}
 #endif 
 }
 
 void VulkanExampleBase::initVulkan(bool enableValidation)
 {
+	CPU_PROFILE_SCOPE("initVulkan");
 	VkResult err;
 
 	// Vulkan instance
@@ -451,7 +831,6 @@ void VulkanExampleBase::initVulkan(bool enableValidation)
 	}
 
 	// Find a queue that supports graphics operations
-	uint32_t graphicsQueueIndex = 0;
 	uint32_t queueCount;
 	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, NULL);
 	assert(queueCount >= 1);
@@ -466,6 +845,12 @@ void VulkanExampleBase::initVulkan(bool enableValidation)
 			break;
 	}
 	assert(graphicsQueueIndex < queueCount);
+	timestampValidBits = queueProps[graphicsQueueIndex].timestampValidBits;
+
+	// Store properties (including limits) and features of the physical device
+	// so examples can check them and enable optional features
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
 
 	// Vulkan device
 	std::array<float, 1> queuePriorities = { 0.0f };
@@ -503,7 +888,10 @@ void VulkanExampleBase::initVulkan(bool enableValidation)
 
 	assert(depthFormatFound);
 
-	swapChain.init(instance, physicalDevice, device);
+	if (!headless)
+	{
+		swapChain.init(instance, physicalDevice, device);
+	}
 }
 
 #ifdef _WIN32 
@@ -855,7 +1243,7 @@ void VulkanExampleBase::createCommandPool()
 {
 	VkCommandPoolCreateInfo cmdPoolInfo = {};
 	cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
+	cmdPoolInfo.queueFamilyIndex = headless ? graphicsQueueIndex : swapChain.queueNodeIndex;
 	cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	VkResult vkRes = vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &cmdPool);
 	assert(!vkRes);
@@ -1001,6 +1389,7 @@ void VulkanExampleBase::setupRenderPass()
 
 void VulkanExampleBase::initSwapchain()
 {
+	CPU_PROFILE_SCOPE("initSwapchain");
 #ifdef _WIN32
 	swapChain.initSwapChain(windowInstance, window);
 #else
@@ -28,8 +28,19 @@
 
 #include "vulkantools.h"
 #include "vulkandebug.h"
+#include "vulkanextensions.h"
 
 #include "vulkanswapchain.hpp"
+#include "vulkansetupcontext.hpp"
+#include "vulkanpipelinecache.hpp"
+#include "vulkanspecialization.hpp"
+#include "vulkanshadermodulecache.hpp"
+#include "vulkanshaderarchive.hpp"
+#include "vulkanspirvoptimizer.h"
+#include "vulkandescriptorallocator.hpp"
+#include "vulkanframetimes.hpp"
+#include "vulkangpuprofiler.hpp"
+#include "vulkancpuprofiler.hpp"
 
 #define deg_to_rad(deg) deg * float(3.14 / 180)
 
@@ -45,16 +56,39 @@ private:
 protected:
 	// Last frame time, measured using a high performance timer (if available)
 	float frameTimer = 1.0f;
+	// Time spent in waitDeviceIdle and waitQueueIdle in milliseconds
+	// Reset by the fixed frame benchmark before each frame
+	double deviceWaitTime = 0.0;
 	// Vulkan instance, stores all per-application states
 	VkInstance instance;
 	// Physical device (GPU) that Vulkan will ise
 	VkPhysicalDevice physicalDevice;
+	// Stores physical device properties (for e.g. checking device limits)
+	VkPhysicalDeviceProperties deviceProperties;
+	// Stores the features available on the selected physical device
+	VkPhysicalDeviceFeatures deviceFeatures;
+	// Features that have been enabled on the logical device
+	VkPhysicalDeviceFeatures enabledFeatures = {};
+	// Set if VK_KHR_draw_indirect_count has been enabled on the logical device
+	bool drawIndirectCountEnabled = false;
+	// Set if VK_KHR_descriptor_update_template has been enabled on the logical device
+	bool descriptorUpdateTemplateEnabled = false;
+	// Set if VK_KHR_get_physical_device_properties2 has been enabled on the instance
+	bool physicalDeviceProperties2Enabled = false;
+	// Number of meaningful bits of the timestamps written on the graphics queue, 0 if not supported
+	uint32_t timestampValidBits = 0;
+	// Set if VK_EXT_descriptor_indexing has been enabled on the logical device
+	// with the features needed by bindless tables (see VulkanBindlessTable), including the core
+	// shaderStorageBufferArrayDynamicIndexing feature
+	bool descriptorIndexingEnabled = false;
 	// Stores all available memory (type) properties for the physical device
 	VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
 	// Logical device, application's view of the physical device (GPU)
 	VkDevice device;
 	// Handle to the device graphics queue that command buffers are submitted to
 	VkQueue queue;
+	// Queue family of the graphics queue
+	uint32_t graphicsQueueIndex = 0;
 	// Color buffer format
 	VkFormat colorformat = VK_FORMAT_B8G8R8A8_UNORM;
 	// Depth buffer format
@@ -63,7 +97,10 @@ protected:
 	// Command buffer pool
 	VkCommandPool cmdPool;
 	// Command buffer used for setup
+	// Belongs to the batch currently recorded by the setup context
 	VkCommandBuffer setupCmdBuffer = VK_NULL_HANDLE;
+	// Batches setup command buffers into asynchronous, fence tracked submissions
+	VulkanSetupContext setupContext;
 	// Command buffer for submitting a post present barrier
 	VkCommandBuffer postPresentCmdBuffer = VK_NULL_HANDLE;
 	// Command buffers used for rendering
@@ -74,15 +111,41 @@ protected:
 	std::vector<VkFramebuffer>frameBuffers;
 	// Active frame buffer index
 	uint32_t currentBuffer = 0;
-	// Descriptor set pool
-	VkDescriptorPool descriptorPool;
-	// List of shader modules created (stored for cleanup)
+	// Descriptor set allocator, adds pools as needed
+	VulkanDescriptorAllocator descriptorAllocator;
+	// Archive containing all SPIR-V shaders, mapped once at startup
+	// Shaders it doesn't contain are loaded from their files
+	VulkanShaderArchive shaderArchive;
+	// Use the shader archive, disabled with the "-no-shader-archive" command line argument
+	bool useShaderArchive = true;
+	// Strip debug information and dead code from shaders before creating their modules
+	// Enabled with the "-optimize-shaders" command line argument
+	bool optimizeShaders = false;
+	// Shader modules shared by all pipelines using the same SPIR-V code
+	VulkanShaderModuleCache shaderModuleCache;
+	// References to the shader modules loaded by loadShader, held until releaseShaderModules
 	std::vector<VkShaderModule> shaderModules;
 	// Pipeline cache object
 	VkPipelineCache pipelineCache;
+	// Owns the pipeline cache and persists it to disk between runs
+	VulkanPipelineCache persistentPipelineCache;
+	// Load and save the pipeline cache file, disabled with the "-no-pipeline-cache" command line argument
+	bool usePipelineCacheFile = true;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
+	// GPU time of named scopes, one slot per draw command buffer plus one for the post present
+	// barrier (slot drawCmdBuffers.size())
+	// Enabled with the "-gpu-profiler" command line argument, does nothing otherwise
+	VulkanGpuProfiler gpuProfiler;
+	bool gpuProfiling = false;
 public: 
+	// Command line arguments, filled by main before the example is created
+	static std::vector<const char*> args;
+	// Render offscreen only, without window, surface and swap chain (e.g. for tests on machines without display)
+	// The frame buffers and draw command buffers are then empty
+	// Set by main before the example is created
+	static bool headless;
+
 	bool prepared = false;
 	uint32_t width = 1280;
 	uint32_t height = 720;
@@ -99,6 +162,30 @@ public:
 	
 	bool paused = false;
 
+	// Render a fixed number of frames with a fixed animation time step instead of the window loop
+	// and report their times, so runs are comparable (see runFixedFrameBenchmark)
+	// Enabled with the "-benchmark" command line argument
+	struct {
+		bool enabled = false;
+		// Frames rendered before measuring, set with the "-benchmark-warmup <count>" command line argument
+		uint32_t warmupFrames = 60;
+		// Frames measured, set with the "-benchmark-frames <count>" command line argument
+		uint32_t frameCount = 600;
+		// Virtual frame time in seconds, set with the "-benchmark-delta <seconds>" command line argument
+		float deltaTime = 1.0f / 60.0f;
+		// JSON report, set with the "-benchmark-output <file>" command line argument
+		std::string outputFile;
+	} fixedFrameBenchmark;
+
+	// Record the CPU profiler zones from startup and write them as a Chrome trace after frameCount frames
+	// Enabled with the "-cpu-profile <file>" command line argument (see VulkanCpuProfiler)
+	struct {
+		std::string file;
+		// Set with the "-cpu-profile-frames <count>" command line argument
+		uint32_t frameCount = 300;
+		uint32_t frame = 0;
+	} cpuProfile;
+
 	// Use to adjust mouse rotation speed
 	float rotationSpeed = 1.0f;
 	// Use to adjust mouse zoom speed
@@ -150,6 +237,28 @@ public:
 //#endif
 	// Pure virtual render function (override in derived class)
 	virtual void render() = 0;
+	// Advance the animation timer by a frame time in seconds, unless paused
+	// Called with the measured frame time by the window loop and a fixed one by the fixed frame benchmark
+	void advanceTimer(float frameTime);
+	// vkDeviceWaitIdle and vkQueueWaitIdle, adding the time spent waiting to deviceWaitTime
+	void waitDeviceIdle();
+	void waitQueueIdle();
+	// Print the average GPU time of the profiled scopes (if the GPU profiler is enabled)
+	void printGpuProfile();
+	// Render warmupFrames + frameCount frames with fixed time steps and print the min, average, median,
+	// 95th and 99th percentile and max of the frame times, split into the time spent waiting for the
+	// device (GPU) and the rest of the frame (CPU)
+	// Returns false if the benchmark has not been enabled on the command line
+	bool runFixedFrameBenchmark();
+	// Called by runFixedFrameBenchmark once prepared, before the warm-up frames
+	// Can be overriden in derived class to finish work still running in the background
+	// (e.g. pipelines compiling), so that it doesn't change the frames being measured
+	virtual void prepareFixedFrameBenchmark();
+	// Count a rendered frame, writes the CPU profile once cpuProfile.frameCount frames have been rendered
+	// Call once per frame
+	void updateCpuProfile();
+	// Stop recording and write the CPU profile (if enabled and not written yet)
+	void writeCpuProfile();
 	// Called when view change occurs
 	// Can be overriden in derived class to e.g. update uniform buffers 
 	// Containing view dependant matrices
@@ -182,19 +291,36 @@ public:
 	// Create command buffer for setup commands
 	void createSetupCommandBuffer();
 	// Finalize setup command bufferm submit it to the queue and remove it
+	// Waits for the setup commands to complete
 	void flushSetupCommandBuffer();
+	// Finalize setup command buffer and submit it to the queue without waiting
+	// Returns the setup context value reached once the commands have completed
+	uint64_t submitSetupCommandBuffer();
 
 	// Create a cache pool for rendering pipelines
+	// Filled with the pipelines saved by the previous run if available
 	void createPipelineCache();
+	// Save the pipeline cache to disk if the save interval has elapsed
+	// Call once per frame
+	void updatePipelineCache();
 
 	// Prepare commonly used Vulkan functions
 	void prepare();
 
 	// Load a SPIR-V shader
+	// Served by the shader archive if it contains a shader with the same file name
+	// Shaders with the same code share one module
 	VkPipelineShaderStageCreateInfo loadShader(const char* fileName, VkShaderStageFlagBits stage);
+	// Load a SPIR-V shader variant with specialization constants
+	// constants must stay alive until the pipeline has been created
+	VkPipelineShaderStageCreateInfo loadShader(const char* fileName, VkShaderStageFlagBits stage, VulkanSpecializationConstants &constants);
 	// Load a GLSL shader
 	// NOTE : This may not work with any IHV and requires some magic
 	VkPipelineShaderStageCreateInfo loadShaderGLSL(const char* fileName, VkShaderStageFlagBits stage);
+	// Give back the shader modules loaded so far
+	// Call once the pipelines using them have been requested, modules are destroyed
+	// when no pipeline waiting to be compiled uses them anymore
+	void releaseShaderModules();
 
 	// Create a buffer, fill it with data and bind buffer memory
 	// Can be used for e.g. vertex or index buffer based on mesh data
@@ -0,0 +1,154 @@
+/*
+* Declarations for Vulkan extensions that are newer than the bundled SDK headers
+*
+* The headers in third-party/include/vulkan are from SDK 1.0.3, so extension
+* entry points and structures used by the examples are declared here and
+* function pointers are fetched at runtime via vkGetDeviceProcAddr
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// VK_KHR_draw_indirect_count
+// Lets the draw count of an indirect draw be sourced from a buffer
+#ifndef VK_KHR_draw_indirect_count
+#define VK_KHR_draw_indirect_count 1
+#define VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME "VK_KHR_draw_indirect_count"
+typedef void (VKAPI_PTR *PFN_vkCmdDrawIndexedIndirectCountKHR)(
+	VkCommandBuffer commandBuffer,
+	VkBuffer buffer,
+	VkDeviceSize offset,
+	VkBuffer countBuffer,
+	VkDeviceSize countBufferOffset,
+	uint32_t maxDrawCount,
+	uint32_t stride);
+#endif
+
+// Result codes of descriptor pool allocations that are newer than the bundled headers
+// VK_ERROR_FRAGMENTED_POOL was added to the core enum after 1.0.3, as an enumerant it can't be
+// tested by the preprocessor, so the value is defined under a name of its own that works with any headers
+#define RESULT_ERROR_FRAGMENTED_POOL ((VkResult)-12)
+// VK_KHR_maintenance1's VK_ERROR_OUT_OF_POOL_MEMORY_KHR
+#ifndef VK_KHR_maintenance1
+#define VK_ERROR_OUT_OF_POOL_MEMORY_KHR ((VkResult)-1000069000)
+#endif
+
+// VK_KHR_get_physical_device_properties2 (instance extension)
+// Lets extension feature structures be queried through a pNext chain
+#ifndef VK_KHR_get_physical_device_properties2
+#define VK_KHR_get_physical_device_properties2 1
+#define VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME "VK_KHR_get_physical_device_properties2"
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR ((VkStructureType)1000059000)
+typedef struct VkPhysicalDeviceFeatures2KHR {
+	VkStructureType sType;
+	void* pNext;
+	VkPhysicalDeviceFeatures features;
+} VkPhysicalDeviceFeatures2KHR;
+typedef void (VKAPI_PTR *PFN_vkGetPhysicalDeviceFeatures2KHR)(
+	VkPhysicalDevice physicalDevice,
+	VkPhysicalDeviceFeatures2KHR* pFeatures);
+#endif
+
+// VK_KHR_maintenance3, required by VK_EXT_descriptor_indexing
+#ifndef VK_KHR_maintenance3
+#define VK_KHR_maintenance3 1
+#define VK_KHR_MAINTENANCE3_EXTENSION_NAME "VK_KHR_maintenance3"
+#endif
+
+// VK_EXT_descriptor_indexing
+// Large, partially bound descriptor arrays that can be updated after being bound (bindless resources)
+#ifndef VK_EXT_descriptor_indexing
+#define VK_EXT_descriptor_indexing 1
+#define VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME "VK_EXT_descriptor_indexing"
+#define VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT ((VkStructureType)1000161000)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT ((VkStructureType)1000161001)
+#define VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT ((VkDescriptorSetLayoutCreateFlags)0x00000002)
+#define VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT ((VkDescriptorPoolCreateFlags)0x00000002)
+typedef VkFlags VkDescriptorBindingFlagsEXT;
+#define VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT ((VkDescriptorBindingFlagsEXT)0x00000001)
+#define VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT ((VkDescriptorBindingFlagsEXT)0x00000002)
+#define VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT ((VkDescriptorBindingFlagsEXT)0x00000004)
+#define VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT ((VkDescriptorBindingFlagsEXT)0x00000008)
+typedef struct VkDescriptorSetLayoutBindingFlagsCreateInfoEXT {
+	VkStructureType sType;
+	const void* pNext;
+	uint32_t bindingCount;
+	const VkDescriptorBindingFlagsEXT* pBindingFlags;
+} VkDescriptorSetLayoutBindingFlagsCreateInfoEXT;
+typedef struct VkPhysicalDeviceDescriptorIndexingFeaturesEXT {
+	VkStructureType sType;
+	void* pNext;
+	VkBool32 shaderInputAttachmentArrayDynamicIndexing;
+	VkBool32 shaderUniformTexelBufferArrayDynamicIndexing;
+	VkBool32 shaderStorageTexelBufferArrayDynamicIndexing;
+	VkBool32 shaderUniformBufferArrayNonUniformIndexing;
+	VkBool32 shaderSampledImageArrayNonUniformIndexing;
+	VkBool32 shaderStorageBufferArrayNonUniformIndexing;
+	VkBool32 shaderStorageImageArrayNonUniformIndexing;
+	VkBool32 shaderInputAttachmentArrayNonUniformIndexing;
+	VkBool32 shaderUniformTexelBufferArrayNonUniformIndexing;
+	VkBool32 shaderStorageTexelBufferArrayNonUniformIndexing;
+	VkBool32 descriptorBindingUniformBufferUpdateAfterBind;
+	VkBool32 descriptorBindingSampledImageUpdateAfterBind;
+	VkBool32 descriptorBindingStorageImageUpdateAfterBind;
+	VkBool32 descriptorBindingStorageBufferUpdateAfterBind;
+	VkBool32 descriptorBindingUniformTexelBufferUpdateAfterBind;
+	VkBool32 descriptorBindingStorageTexelBufferUpdateAfterBind;
+	VkBool32 descriptorBindingUpdateUnusedWhilePending;
+	VkBool32 descriptorBindingPartiallyBound;
+	VkBool32 descriptorBindingVariableDescriptorCount;
+	VkBool32 runtimeDescriptorArray;
+} VkPhysicalDeviceDescriptorIndexingFeaturesEXT;
+#endif
+
+// VK_KHR_descriptor_update_template
+// Descriptor sets are updated from a packed structure described by a template created once per layout
+#ifndef VK_KHR_descriptor_update_template
+#define VK_KHR_descriptor_update_template 1
+#define VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME "VK_KHR_descriptor_update_template"
+#define VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR ((VkStructureType)1000085000)
+VK_DEFINE_NON_DISPATCHABLE_HANDLE(VkDescriptorUpdateTemplateKHR)
+typedef VkFlags VkDescriptorUpdateTemplateCreateFlagsKHR;
+typedef enum VkDescriptorUpdateTemplateTypeKHR {
+	VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR = 0,
+	VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR = 1,
+	VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_MAX_ENUM_KHR = 0x7FFFFFFF
+} VkDescriptorUpdateTemplateTypeKHR;
+typedef struct VkDescriptorUpdateTemplateEntryKHR {
+	uint32_t dstBinding;
+	uint32_t dstArrayElement;
+	uint32_t descriptorCount;
+	VkDescriptorType descriptorType;
+	size_t offset;
+	size_t stride;
+} VkDescriptorUpdateTemplateEntryKHR;
+typedef struct VkDescriptorUpdateTemplateCreateInfoKHR {
+	VkStructureType sType;
+	const void* pNext;
+	VkDescriptorUpdateTemplateCreateFlagsKHR flags;
+	uint32_t descriptorUpdateEntryCount;
+	const VkDescriptorUpdateTemplateEntryKHR* pDescriptorUpdateEntries;
+	VkDescriptorUpdateTemplateTypeKHR templateType;
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkPipelineBindPoint pipelineBindPoint;
+	VkPipelineLayout pipelineLayout;
+	uint32_t set;
+} VkDescriptorUpdateTemplateCreateInfoKHR;
+typedef VkResult (VKAPI_PTR *PFN_vkCreateDescriptorUpdateTemplateKHR)(
+	VkDevice device,
+	const VkDescriptorUpdateTemplateCreateInfoKHR* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator,
+	VkDescriptorUpdateTemplateKHR* pDescriptorUpdateTemplate);
+typedef void (VKAPI_PTR *PFN_vkDestroyDescriptorUpdateTemplateKHR)(
+	VkDevice device,
+	VkDescriptorUpdateTemplateKHR descriptorUpdateTemplate,
+	const VkAllocationCallbacks* pAllocator);
+typedef void (VKAPI_PTR *PFN_vkUpdateDescriptorSetWithTemplateKHR)(
+	VkDevice device,
+	VkDescriptorSet descriptorSet,
+	VkDescriptorUpdateTemplateKHR descriptorUpdateTemplate,
+	const void* pData);
+#endif
@@ -0,0 +1,326 @@
+/*
+* Class writing captured frames to disk on a dedicated thread
+*
+* push() only copies the color of a readback into a buffer of a bounded queue,
+* the conversion and the file writes happen on the writer thread
+* When the queue is full push() waits for the writer (back-pressure), so the
+* memory used stays bounded if the disk is slower than rendering
+* Frames are written as :
+*	PPM : one binary PPM file per frame (<path>_<frame>.ppm)
+*	Y4M : a single YUV4MPEG2 stream (4:4:4, BT.601), readable by most video tools
+*	RAW : tightly packed RGB frames appended to <path>, with <path>.idx listing
+*	      the frame number, offset and size of each frame
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "vulkanreadbackring.hpp"
+#include "vulkangoldenimage.hpp"
+#include "vulkancpuprofiler.hpp"
+
+class VulkanFrameCapture
+{
+public:
+	enum Format { PPM, Y4M, RAW };
+
+	// Returns false if the name is not "ppm", "y4m" or "raw"
+	static bool parseFormat(const std::string &name, Format *format)
+	{
+		if (name == "ppm")
+		{
+			*format = PPM;
+		}
+		else if (name == "y4m")
+		{
+			*format = Y4M;
+		}
+		else if (name == "raw")
+		{
+			*format = RAW;
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+private:
+	struct Frame
+	{
+		uint64_t number;
+		std::vector<uint8_t> color;
+	};
+
+	std::string path;
+	Format format;
+	uint32_t width;
+	uint32_t height;
+	VkFormat colorFormat;
+	uint32_t queueCapacity;
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable frameAvailable;
+	std::condition_variable spaceAvailable;
+	std::deque<Frame*> queue;
+	// Written frames, their buffers are reused by push()
+	std::vector<Frame*> freeFrames;
+	bool stopping = false;
+
+	FILE *stream = nullptr;
+	FILE *index = nullptr;
+	uint64_t streamOffset = 0;
+	std::chrono::time_point<std::chrono::high_resolution_clock> tOpen;
+	// Time from open() to the end of the last write
+	std::atomic<int64_t> writeTimeMicroseconds{ 0 };
+
+	// Encoding buffers, only used by the writer thread
+	VulkanGoldenImage image;
+	std::vector<uint8_t> planes;
+
+	bool writeFrame(const Frame &frame)
+	{
+		CPU_PROFILE_SCOPE("write frame");
+		if (!image.fromPixels(frame.color.data(), width, height, colorFormat))
+		{
+			return false;
+		}
+		switch (format)
+		{
+		case PPM:
+		{
+			char fileName[32];
+			snprintf(fileName, sizeof(fileName), "_%06llu.ppm", (unsigned long long)frame.number);
+			if (!image.save(path + fileName))
+			{
+				return false;
+			}
+			stats.bytesWritten += image.pixels.size();
+			return true;
+		}
+		case Y4M:
+		{
+			// Full resolution Y, U and V planes
+			size_t pixelCount = (size_t)width * height;
+			planes.resize(pixelCount * 3);
+			for (size_t i = 0; i < pixelCount; i++)
+			{
+				float r = image.pixels[i * 3 + 0];
+				float g = image.pixels[i * 3 + 1];
+				float b = image.pixels[i * 3 + 2];
+				planes[i] = (uint8_t)(16.0f + 0.257f * r + 0.504f * g + 0.098f * b + 0.5f);
+				planes[pixelCount + i] = (uint8_t)(128.0f - 0.148f * r - 0.291f * g + 0.439f * b + 0.5f);
+				planes[pixelCount * 2 + i] = (uint8_t)(128.0f + 0.439f * r - 0.368f * g - 0.071f * b + 0.5f);
+			}
+			bool written = (fputs("FRAME\n", stream) >= 0) && (fwrite(planes.data(), 1, planes.size(), stream) == planes.size());
+			stats.bytesWritten += planes.size() + 6;
+			return written;
+		}
+		default:
+		{
+			bool written =
+				(fwrite(image.pixels.data(), 1, image.pixels.size(), stream) == image.pixels.size()) &&
+				(fprintf(index, "%llu %llu %llu\n", (unsigned long long)frame.number, (unsigned long long)streamOffset, (unsigned long long)image.pixels.size()) > 0);
+			streamOffset += image.pixels.size();
+			stats.bytesWritten += image.pixels.size();
+			return written;
+		}
+		}
+	}
+
+	void writerLoop()
+	{
+		CPU_PROFILE_THREAD("capture writer");
+		while (true)
+		{
+			Frame *frame;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				frameAvailable.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (queue.empty())
+				{
+					return;
+				}
+				frame = queue.front();
+				queue.pop_front();
+			}
+
+			if (writeFrame(*frame))
+			{
+				stats.framesWritten++;
+			}
+			else
+			{
+				stats.writeErrors++;
+			}
+			writeTimeMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - tOpen).count();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				freeFrames.push_back(frame);
+			}
+			spaceAvailable.notify_one();
+		}
+	}
+
+public:
+	struct Stats
+	{
+		std::atomic<uint64_t> framesQueued{ 0 };
+		std::atomic<uint64_t> framesWritten{ 0 };
+		// Frames not queued by push() because the queue was full and waiting was not allowed
+		std::atomic<uint64_t> framesDropped{ 0 };
+		std::atomic<uint64_t> writeErrors{ 0 };
+		std::atomic<uint64_t> bytesWritten{ 0 };
+		// Number of push() calls that waited for the writer, and the time spent waiting in milliseconds
+		std::atomic<uint64_t> stalls{ 0 };
+		double stallTime = 0.0;
+	} stats;
+
+	~VulkanFrameCapture()
+	{
+		close();
+	}
+
+	// Start writing frames of the given size and 8 bit RGBA or BGRA color format
+	// At most queueCapacity frames wait for the writer, each holds width * height * 4 bytes
+	// Returns false if the output files can't be created
+	bool open(const std::string &path, Format format, uint32_t width, uint32_t height, VkFormat colorFormat, uint32_t queueCapacity = 8)
+	{
+		assert(!writer.joinable());
+		assert(queueCapacity > 0);
+		this->path = path;
+		this->format = format;
+		this->width = width;
+		this->height = height;
+		this->colorFormat = colorFormat;
+		this->queueCapacity = queueCapacity;
+		streamOffset = 0;
+
+		if (format == Y4M)
+		{
+			stream = fopen(path.c_str(), "wb");
+			if (stream == nullptr)
+			{
+				return false;
+			}
+			// Progressive, square pixels, no subsampling
+			fprintf(stream, "YUV4MPEG2 W%u H%u F60:1 Ip A1:1 C444\n", width, height);
+		}
+		if (format == RAW)
+		{
+			stream = fopen(path.c_str(), "wb");
+			index = fopen((path + ".idx").c_str(), "w");
+			if ((stream == nullptr) || (index == nullptr))
+			{
+				close();
+				return false;
+			}
+			fprintf(index, "# %u x %u RGB, frame offset size\n", width, height);
+		}
+
+		for (uint32_t i = 0; i < queueCapacity; i++)
+		{
+			freeFrames.push_back(new Frame{ 0, std::vector<uint8_t>((size_t)width * height * 4) });
+		}
+		stopping = false;
+		tOpen = std::chrono::high_resolution_clock::now();
+		writer = std::thread(&VulkanFrameCapture::writerLoop, this);
+		return true;
+	}
+
+	// Queue the color of a readback for writing
+	// If the queue is full, waits for the writer if wait is true, drops the frame and returns false otherwise
+	bool push(const VulkanReadbackRing::Readback &readback, bool wait = true)
+	{
+		assert((readback.width == width) && (readback.height == height));
+		Frame *frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (freeFrames.empty())
+			{
+				if (!wait)
+				{
+					stats.framesDropped++;
+					return false;
+				}
+				stats.stalls++;
+				auto tStart = std::chrono::high_resolution_clock::now();
+				spaceAvailable.wait(lock, [this]() { return !freeFrames.empty(); });
+				stats.stallTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			}
+			frame = freeFrames.back();
+			freeFrames.pop_back();
+		}
+
+		// Copied outside of the lock, the readback memory is reused once its slot comes around again
+		frame->number = readback.frame;
+		memcpy(frame->color.data(), readback.color, frame->color.size());
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(frame);
+		}
+		stats.framesQueued++;
+		frameAvailable.notify_one();
+		return true;
+	}
+
+	// Frames written per second since open(), measured up to the last completed write
+	double writeRate() const
+	{
+		return writeTimeMicroseconds > 0 ? stats.framesWritten / (writeTimeMicroseconds / 1000000.0) : 0.0;
+	}
+
+	// Bytes written per second since open(), in MB
+	double writeThroughput() const
+	{
+		return writeTimeMicroseconds > 0 ? stats.bytesWritten / (1024.0 * 1024.0) / (writeTimeMicroseconds / 1000000.0) : 0.0;
+	}
+
+	// Write the queued frames, stop the writer and close the files
+	// Does nothing if the capture is not open, so it can be called more than once
+	void close()
+	{
+		if (writer.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			frameAvailable.notify_all();
+			writer.join();
+		}
+		if (stream != nullptr)
+		{
+			fclose(stream);
+			stream = nullptr;
+		}
+		if (index != nullptr)
+		{
+			fclose(index);
+			index = nullptr;
+		}
+		for (auto& frame : freeFrames)
+		{
+			delete frame;
+		}
+		freeFrames.clear();
+	}
+};
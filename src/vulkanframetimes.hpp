@@ -0,0 +1,85 @@
+/*
+* Class collecting frame times and summarizing them
+*
+* Percentiles are more stable than the mean when a few frames are delayed by
+* the system, the median is used to detect performance regressions
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+class VulkanFrameTimes
+{
+public:
+	struct Summary
+	{
+		uint32_t frameCount = 0;
+		double mean = 0.0;
+		double median = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double min = 0.0;
+		double max = 0.0;
+	};
+
+	// Frame times in milliseconds, in submission order
+	std::vector<double> times;
+
+	void add(double milliseconds)
+	{
+		times.push_back(milliseconds);
+	}
+
+	void clear()
+	{
+		times.clear();
+	}
+
+	Summary summary() const
+	{
+		Summary result;
+		if (times.empty())
+		{
+			return result;
+		}
+		std::vector<double> sorted = times;
+		std::sort(sorted.begin(), sorted.end());
+		result.frameCount = (uint32_t)sorted.size();
+		for (double time : sorted)
+		{
+			result.mean += time;
+		}
+		result.mean /= sorted.size();
+		result.median = percentile(sorted, 0.5);
+		result.p95 = percentile(sorted, 0.95);
+		result.p99 = percentile(sorted, 0.99);
+		result.min = sorted.front();
+		result.max = sorted.back();
+		return result;
+	}
+
+	// Write a summary as the members of a JSON object (without the braces)
+	static void writeJson(std::ostream &stream, const Summary &summary)
+	{
+		stream << "\"frames\": " << summary.frameCount
+			<< ", \"mean_ms\": " << summary.mean
+			<< ", \"median_ms\": " << summary.median
+			<< ", \"p95_ms\": " << summary.p95
+			<< ", \"p99_ms\": " << summary.p99
+			<< ", \"min_ms\": " << summary.min
+			<< ", \"max_ms\": " << summary.max;
+	}
+
+private:
+	// Nearest rank percentile of sorted times
+	static double percentile(const std::vector<double> &sorted, double fraction)
+	{
+		size_t rank = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(rank, sorted.size() - 1)];
+	}
+};
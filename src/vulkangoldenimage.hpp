@@ -0,0 +1,133 @@
+/*
+* Class holding an 8 bit RGB image read back from the device or from a golden image file
+*
+* Golden images are stored as binary PPM (P6) files, which need no image library
+* and can be opened by most viewers
+* compare() counts the pixels with a channel differing by more than a tolerance,
+* software and hardware rasterizers don't produce bit exact results
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+class VulkanGoldenImage
+{
+public:
+	struct Comparison
+	{
+		// False if the sizes differ, the other members are then meaningless
+		bool sameSize = false;
+		uint32_t differingPixels = 0;
+		// Largest channel difference over all pixels
+		uint32_t maxDifference = 0;
+		float differingFraction = 0.0f;
+	};
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// Tightly packed RGB rows
+	std::vector<uint8_t> pixels;
+
+	// Convert 4 byte pixels of the given format, the alpha channel is dropped
+	// Returns false if the format is not an 8 bit RGBA or BGRA format
+	bool fromPixels(const uint8_t *data, uint32_t width, uint32_t height, VkFormat format)
+	{
+		bool bgra;
+		switch (format)
+		{
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			bgra = true;
+			break;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			bgra = false;
+			break;
+		default:
+			return false;
+		}
+		this->width = width;
+		this->height = height;
+		pixels.resize((size_t)width * height * 3);
+		for (size_t i = 0; i < (size_t)width * height; i++)
+		{
+			pixels[i * 3 + 0] = data[i * 4 + (bgra ? 2 : 0)];
+			pixels[i * 3 + 1] = data[i * 4 + 1];
+			pixels[i * 3 + 2] = data[i * 4 + (bgra ? 0 : 2)];
+		}
+		return true;
+	}
+
+	// Returns false if the file does not exist or is not a binary 8 bit PPM file
+	bool load(const std::string &fileName)
+	{
+		FILE *file = fopen(fileName.c_str(), "rb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		char magic[3] = {};
+		uint32_t maxValue = 0;
+		bool valid =
+			(fscanf(file, "%2s %u %u %u", magic, &width, &height, &maxValue) == 4) &&
+			(std::string(magic) == "P6") && (maxValue == 255) &&
+			// Single whitespace before the pixel data
+			(fgetc(file) != EOF);
+		if (valid)
+		{
+			pixels.resize((size_t)width * height * 3);
+			valid = fread(pixels.data(), 1, pixels.size(), file) == pixels.size();
+		}
+		fclose(file);
+		return valid;
+	}
+
+	bool save(const std::string &fileName) const
+	{
+		FILE *file = fopen(fileName.c_str(), "wb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		fprintf(file, "P6\n%u %u\n255\n", width, height);
+		bool written = fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+		fclose(file);
+		return written;
+	}
+
+	// Pixels with a channel differing by more than tolerance are counted as different
+	Comparison compare(const VulkanGoldenImage &other, uint32_t tolerance) const
+	{
+		Comparison comparison;
+		if ((width != other.width) || (height != other.height))
+		{
+			return comparison;
+		}
+		comparison.sameSize = true;
+		for (size_t i = 0; i < (size_t)width * height; i++)
+		{
+			uint32_t pixelDifference = 0;
+			for (size_t c = 0; c < 3; c++)
+			{
+				uint32_t difference = (uint32_t)abs((int)pixels[i * 3 + c] - (int)other.pixels[i * 3 + c]);
+				pixelDifference = difference > pixelDifference ? difference : pixelDifference;
+			}
+			if (pixelDifference > tolerance)
+			{
+				comparison.differingPixels++;
+			}
+			comparison.maxDifference = pixelDifference > comparison.maxDifference ? pixelDifference : comparison.maxDifference;
+		}
+		comparison.differingFraction = (width * height) > 0 ? (float)comparison.differingPixels / (width * height) : 0.0f;
+		return comparison;
+	}
+};
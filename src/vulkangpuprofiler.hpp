@@ -0,0 +1,245 @@
+/*
+* Class measuring the GPU time of named scopes with timestamp queries
+*
+* Each slot (e.g. a pre-recorded command buffer or a frame in flight) owns
+* a query pool, the scopes recorded into a command buffer of the slot write
+* a timestamp at their beginning and end
+* Results are read with vkGetQueryPoolResults without waiting, just before
+* the queries of the slot are reused, so a few frames after they were written
+* Durations are converted to milliseconds with the device's timestampPeriod
+* and averaged per scope name over the last historyLength results
+*
+* Note : All methods do nothing if the profiler has not been initialized or
+* timestamps are not supported by the queue
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+class VulkanGpuProfiler
+{
+private:
+	struct Scope
+	{
+		uint32_t nameIndex;
+		// The end timestamp is the next query
+		uint32_t beginQuery;
+	};
+
+	struct Slot
+	{
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		// Scopes recorded since the last beginSlot(), in query order
+		std::vector<Scope> scopes;
+		// Submitted and not yet collected
+		bool pending = false;
+	};
+
+	// Last historyLength durations of a scope name
+	struct History
+	{
+		std::string name;
+		std::vector<double> durations;
+		uint32_t next = 0;
+		double sum = 0.0;
+	};
+
+	VkDevice device;
+	double timestampPeriod;
+	uint64_t timestampMask;
+	uint32_t maxScopesPerSlot;
+	uint32_t historyLength;
+	std::vector<Slot> slots;
+	std::vector<History> histories;
+	std::unordered_map<std::string, uint32_t> nameIndices;
+	// Slot recorded by begin() and end()
+	Slot *recording = nullptr;
+	std::vector<uint64_t> timestamps;
+
+	void addDuration(History &history, double duration)
+	{
+		if (history.durations.size() < historyLength)
+		{
+			history.durations.push_back(duration);
+		}
+		else
+		{
+			history.sum -= history.durations[history.next];
+			history.durations[history.next] = duration;
+			history.next = (history.next + 1) % historyLength;
+		}
+		history.sum += duration;
+	}
+
+public:
+	struct Stats
+	{
+		// Submissions of a slot whose results have been read
+		uint32_t collected = 0;
+		// Submissions whose results were not available when the slot was reused and have been dropped
+		uint32_t notReady = 0;
+	} stats;
+
+	// timestampPeriod is VkPhysicalDeviceLimits::timestampPeriod, timestampValidBits is the
+	// VkQueueFamilyProperties member of the queue the command buffers are submitted to
+	// slotCount query pools of 2 * maxScopesPerSlot timestamps are created
+	void init(VkDevice device, float timestampPeriod, uint32_t timestampValidBits, uint32_t slotCount, uint32_t maxScopesPerSlot = 16, uint32_t historyLength = 64)
+	{
+		this->device = device;
+		this->timestampPeriod = timestampPeriod;
+		this->maxScopesPerSlot = maxScopesPerSlot;
+		this->historyLength = historyLength;
+		if (timestampValidBits == 0)
+		{
+			// Timestamps not supported
+			return;
+		}
+		timestampMask = timestampValidBits >= 64 ? ~0ULL : ((1ULL << timestampValidBits) - 1);
+		timestamps.resize(maxScopesPerSlot * 2);
+
+		slots.resize(slotCount);
+		for (auto& slot : slots)
+		{
+			VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+			queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolCreateInfo.queryCount = maxScopesPerSlot * 2;
+			VkResult err = vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &slot.queryPool);
+			assert(!err);
+		}
+	}
+
+	bool enabled() const
+	{
+		return !slots.empty();
+	}
+
+	// Start recording the scopes of a slot into a command buffer, outside of a render pass
+	// Collects the previous results of the slot and records the reset of its queries
+	void beginSlot(VkCommandBuffer cmdBuffer, uint32_t slotIndex)
+	{
+		if (!enabled())
+		{
+			return;
+		}
+		collect(slotIndex);
+		Slot &slot = slots[slotIndex];
+		slot.scopes.clear();
+		vkCmdResetQueryPool(cmdBuffer, slot.queryPool, 0, maxScopesPerSlot * 2);
+		recording = &slot;
+	}
+
+	// Write the begin timestamp of a scope, returns the scope to pass to end()
+	// Scopes past maxScopesPerSlot in a slot are ignored
+	uint32_t begin(VkCommandBuffer cmdBuffer, const std::string &name, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
+	{
+		if (!enabled() || (recording == nullptr) || (recording->scopes.size() >= maxScopesPerSlot))
+		{
+			return UINT32_MAX;
+		}
+		auto nameIndex = nameIndices.find(name);
+		if (nameIndex == nameIndices.end())
+		{
+			nameIndex = nameIndices.insert({ name, (uint32_t)histories.size() }).first;
+			histories.push_back(History());
+			histories.back().name = name;
+		}
+		Scope scope = { nameIndex->second, (uint32_t)recording->scopes.size() * 2 };
+		vkCmdWriteTimestamp(cmdBuffer, stage, recording->queryPool, scope.beginQuery);
+		recording->scopes.push_back(scope);
+		return (uint32_t)recording->scopes.size() - 1;
+	}
+
+	// Write the end timestamp of a scope returned by begin()
+	void end(VkCommandBuffer cmdBuffer, uint32_t scope, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
+	{
+		if (!enabled() || (recording == nullptr) || (scope == UINT32_MAX))
+		{
+			return;
+		}
+		vkCmdWriteTimestamp(cmdBuffer, stage, recording->queryPool, recording->scopes[scope].beginQuery + 1);
+	}
+
+	// Call after each submission of a command buffer recorded for the slot
+	// Pre-recorded command buffers are submitted many times after a single beginSlot()
+	void submitted(uint32_t slotIndex)
+	{
+		if (enabled())
+		{
+			slots[slotIndex].pending = true;
+		}
+	}
+
+	// Read the results of the last submission of a slot if they are available, without waiting
+	// Call before submitting the slot's command buffer again, the results are dropped otherwise
+	// Returns true if results have been read
+	bool collect(uint32_t slotIndex)
+	{
+		if (!enabled())
+		{
+			return false;
+		}
+		Slot &slot = slots[slotIndex];
+		if (!slot.pending || slot.scopes.empty())
+		{
+			return false;
+		}
+		slot.pending = false;
+		uint32_t queryCount = (uint32_t)slot.scopes.size() * 2;
+		VkResult result = vkGetQueryPoolResults(device, slot.queryPool, 0, queryCount, queryCount * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS)
+		{
+			stats.notReady++;
+			return false;
+		}
+		for (auto& scope : slot.scopes)
+		{
+			uint64_t ticks = (timestamps[scope.beginQuery + 1] - timestamps[scope.beginQuery]) & timestampMask;
+			addDuration(histories[scope.nameIndex], ticks * timestampPeriod / 1000000.0);
+		}
+		stats.collected++;
+		return true;
+	}
+
+	// Average GPU time of a scope over its last results in milliseconds, 0 if it has no results
+	double average(const std::string &name) const
+	{
+		auto nameIndex = nameIndices.find(name);
+		if (nameIndex == nameIndices.end())
+		{
+			return 0.0;
+		}
+		const History &history = histories[nameIndex->second];
+		return history.durations.empty() ? 0.0 : history.sum / history.durations.size();
+	}
+
+	// Averages of all scopes in the order they were first recorded
+	std::vector<std::pair<std::string, double>> averages() const
+	{
+		std::vector<std::pair<std::string, double>> result;
+		for (auto& history : histories)
+		{
+			result.push_back({ history.name, history.durations.empty() ? 0.0 : history.sum / history.durations.size() });
+		}
+		return result;
+	}
+
+	void cleanup()
+	{
+		for (auto& slot : slots)
+		{
+			vkDestroyQueryPool(device, slot.queryPool, nullptr);
+		}
+		slots.clear();
+		recording = nullptr;
+	}
+};
@@ -0,0 +1,179 @@
+/*
+* Class wrapping a buffer of indexed indirect draw commands
+*
+* Draw parameters are stored in a VkDrawIndexedIndirectCommand buffer that is
+* consumed by vkCmdDrawIndexedIndirect, so the number of API calls recorded
+* does not depend on the number of objects drawn
+* The buffer is host visible and can also be bound as a storage buffer so
+* a compute shader (e.g. GPU culling) can write commands and the draw count
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+#include "vulkanextensions.h"
+
+class VulkanIndirectDrawBuffer
+{
+private:
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	// Set if the device supports drawing several commands with one call
+	VkBool32 multiDrawIndirect = VK_FALSE;
+	// Only set if VK_KHR_draw_indirect_count has been enabled on the device
+	PFN_vkCmdDrawIndexedIndirectCountKHR fpCmdDrawIndexedIndirectCountKHR = nullptr;
+
+	void createBuffer(VkBufferUsageFlags usage, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void **mapped)
+	{
+		VkResult err;
+		VkMemoryRequirements memReqs;
+		VkMemoryAllocateInfo memAlloc = vkTools::initializers::memoryAllocateInfo();
+		VkBufferCreateInfo bufferCreateInfo = vkTools::initializers::bufferCreateInfo(usage, size);
+
+		err = vkCreateBuffer(device, &bufferCreateInfo, nullptr, buffer);
+		assert(!err);
+		vkGetBufferMemoryRequirements(device, *buffer, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		// Coherent so commands written by the host don't need explicit flushes
+		VkBool32 found = vkTools::getMemoryType(
+			memoryProperties,
+			memReqs.memoryTypeBits,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&memAlloc.memoryTypeIndex);
+		assert(found);
+		err = vkAllocateMemory(device, &memAlloc, nullptr, memory);
+		assert(!err);
+		err = vkBindBufferMemory(device, *buffer, *memory, 0);
+		assert(!err);
+		// Kept mapped for the lifetime of the buffer
+		err = vkMapMemory(device, *memory, 0, size, 0, mapped);
+		assert(!err);
+	}
+
+public:
+	// Draw commands
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDrawIndexedIndirectCommand *commands = nullptr;
+	// Number of commands to draw, stored in a single uint32_t
+	// Only read by the device if VK_KHR_draw_indirect_count is used
+	VkBuffer countBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory countMemory = VK_NULL_HANDLE;
+	uint32_t *count = nullptr;
+
+	uint32_t maxDrawCount = 0;
+	uint32_t drawCount = 0;
+
+	// enabledFeatures must be the features the logical device has been created with
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, const VkPhysicalDeviceFeatures &enabledFeatures, bool drawIndirectCountEnabled)
+	{
+		this->device = device;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		multiDrawIndirect = enabledFeatures.multiDrawIndirect;
+		if (drawIndirectCountEnabled)
+		{
+			fpCmdDrawIndexedIndirectCountKHR = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+		}
+	}
+
+	// Allocate storage for up to maxDrawCount commands
+	void create(uint32_t maxDrawCount)
+	{
+		assert(maxDrawCount > 0);
+		this->maxDrawCount = maxDrawCount;
+		drawCount = 0;
+
+		createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			maxDrawCount * sizeof(VkDrawIndexedIndirectCommand),
+			&buffer,
+			&memory,
+			(void**)&commands);
+		memset(commands, 0, maxDrawCount * sizeof(VkDrawIndexedIndirectCommand));
+
+		createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			sizeof(uint32_t),
+			&countBuffer,
+			&countMemory,
+			(void**)&count);
+		*count = 0;
+	}
+
+	// Remove all commands
+	void clear()
+	{
+		drawCount = 0;
+		*count = 0;
+	}
+
+	// Append a draw command, returns its index inside the buffer
+	uint32_t add(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+	{
+		assert(drawCount < maxDrawCount);
+		VkDrawIndexedIndirectCommand &command = commands[drawCount];
+		command.indexCount = indexCount;
+		command.instanceCount = instanceCount;
+		command.firstIndex = firstIndex;
+		command.vertexOffset = vertexOffset;
+		command.firstInstance = firstInstance;
+		*count = ++drawCount;
+		return drawCount - 1;
+	}
+
+	// Returns true if the draw count is fetched from countBuffer at execution time
+	// If not, the draw count is baked into the command buffer when draw is recorded
+	bool usesDrawCount()
+	{
+		return fpCmdDrawIndexedIndirectCountKHR != nullptr;
+	}
+
+	// Record the draws into a command buffer
+	// Index and vertex buffers and the pipeline have to be bound already
+	void draw(VkCommandBuffer cmdBuffer)
+	{
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		if (fpCmdDrawIndexedIndirectCountKHR != nullptr)
+		{
+			// Only the upper bound is recorded, so commands can be added or culled
+			// without rebuilding the command buffer
+			fpCmdDrawIndexedIndirectCountKHR(cmdBuffer, buffer, 0, countBuffer, 0, maxDrawCount, stride);
+		}
+		else if (multiDrawIndirect)
+		{
+			vkCmdDrawIndexedIndirect(cmdBuffer, buffer, 0, drawCount, stride);
+		}
+		else
+		{
+			// Without multiDrawIndirect the draw count must be 0 or 1
+			for (uint32_t i = 0; i < drawCount; i++)
+			{
+				vkCmdDrawIndexedIndirect(cmdBuffer, buffer, i * stride, 1, stride);
+			}
+		}
+	}
+
+	void cleanup()
+	{
+		if (buffer != VK_NULL_HANDLE)
+		{
+			vkUnmapMemory(device, memory);
+			vkDestroyBuffer(device, buffer, nullptr);
+			vkFreeMemory(device, memory, nullptr);
+			buffer = VK_NULL_HANDLE;
+		}
+		if (countBuffer != VK_NULL_HANDLE)
+		{
+			vkUnmapMemory(device, countMemory);
+			vkDestroyBuffer(device, countBuffer, nullptr);
+			vkFreeMemory(device, countMemory, nullptr);
+			countBuffer = VK_NULL_HANDLE;
+		}
+	}
+};
@@ -0,0 +1,189 @@
+/*
+* Class generating descriptor set and pipeline layouts from SPIR-V reflection
+*
+* Reflection results are cached per module (by a hash of the SPIR-V code)
+* Descriptor set layouts and pipeline layouts are deduplicated, so pipelines
+* whose shaders use the same resources share the same layout objects
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+#include "vulkanmappedfile.hpp"
+#include "vulkanshaderarchive.hpp"
+#include "vulkanreflection.h"
+
+class VulkanLayoutCache
+{
+private:
+	struct SetLayout
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		VkDescriptorSetLayout layout;
+	};
+
+	struct PipelineLayout
+	{
+		std::vector<VkDescriptorSetLayout> setLayouts;
+		bool hasPushConstants;
+		VkPushConstantRange pushConstantRange;
+		VkPipelineLayout layout;
+	};
+
+	VkDevice device;
+	// Shaders are read from the archive if it contains them
+	const VulkanShaderArchive *shaderArchive = nullptr;
+	// Reflection results by hash of the module code
+	std::unordered_map<uint64_t, vkReflection::ShaderInterface> interfaces;
+	// Few layouts are expected, so they are searched linearly
+	std::vector<SetLayout> setLayouts;
+	std::vector<PipelineLayout> pipelineLayouts;
+
+	static bool equal(const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b)
+	{
+		return
+			(a.binding == b.binding) &&
+			(a.descriptorType == b.descriptorType) &&
+			(a.descriptorCount == b.descriptorCount) &&
+			(a.stageFlags == b.stageFlags) &&
+			(a.pImmutableSamplers == b.pImmutableSamplers);
+	}
+
+	static bool equal(const VkPushConstantRange &a, const VkPushConstantRange &b)
+	{
+		return (a.stageFlags == b.stageFlags) && (a.offset == b.offset) && (a.size == b.size);
+	}
+
+public:
+	void init(VkDevice device, const VulkanShaderArchive *shaderArchive = nullptr)
+	{
+		this->device = device;
+		this->shaderArchive = shaderArchive;
+	}
+
+	// Returns the interface of a module, parsing it only the first time it is seen
+	const vkReflection::ShaderInterface &reflect(const uint32_t *code, size_t codeSize)
+	{
+		uint64_t hash = vkReflection::hashCode(code, codeSize);
+		auto it = interfaces.find(hash);
+		if (it == interfaces.end())
+		{
+			vkReflection::ShaderInterface shaderInterface;
+			bool valid = vkReflection::reflect(code, codeSize, &shaderInterface);
+			assert(valid);
+			it = interfaces.insert(std::make_pair(hash, shaderInterface)).first;
+		}
+		return it->second;
+	}
+
+	const vkReflection::ShaderInterface &reflectFile(const char *fileName)
+	{
+		size_t codeSize = 0;
+		const uint32_t *code = shaderArchive != nullptr ? shaderArchive->find(VulkanShaderArchive::shaderName(fileName), &codeSize) : nullptr;
+		if (code != nullptr)
+		{
+			return reflect(code, codeSize);
+		}
+		VulkanMappedFile file;
+		if (!file.open(fileName) || !file.isSpirv())
+		{
+			vkTools::exitFatal(std::string("Could not load shader file ") + fileName, "Fatal error");
+		}
+		return reflect((const uint32_t*)file.data(), file.size());
+	}
+
+	// Returns a descriptor set layout with the given bindings, creating it if needed
+	VkDescriptorSetLayout descriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings)
+	{
+		for (auto& setLayout : setLayouts)
+		{
+			if ((setLayout.bindings.size() == bindings.size()) &&
+				std::equal(bindings.begin(), bindings.end(), setLayout.bindings.begin(),
+					[](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b) { return equal(a, b); }))
+			{
+				return setLayout.layout;
+			}
+		}
+
+		SetLayout setLayout;
+		setLayout.bindings = bindings;
+		VkDescriptorSetLayoutCreateInfo descriptorLayout =
+			vkTools::initializers::descriptorSetLayoutCreateInfo(bindings.data(), (uint32_t)bindings.size());
+		VkResult err = vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &setLayout.layout);
+		assert(!err);
+		setLayouts.push_back(setLayout);
+		return setLayout.layout;
+	}
+
+	// Returns a pipeline layout for the resources used by all given stages, creating it if needed
+	// The descriptor set layouts it is made of (one per set) are stored in pSetLayouts if not null
+	VkPipelineLayout pipelineLayout(const std::vector<const vkReflection::ShaderInterface*> &stages, std::vector<VkDescriptorSetLayout> *pSetLayouts = nullptr)
+	{
+		PipelineLayout pipelineLayout;
+		for (auto& bindings : vkReflection::mergeDescriptorBindings(stages))
+		{
+			pipelineLayout.setLayouts.push_back(descriptorSetLayout(bindings));
+		}
+		pipelineLayout.pushConstantRange = {};
+		pipelineLayout.hasPushConstants = vkReflection::mergePushConstantRanges(stages, &pipelineLayout.pushConstantRange);
+		if (pSetLayouts != nullptr)
+		{
+			*pSetLayouts = pipelineLayout.setLayouts;
+		}
+
+		for (auto& existing : pipelineLayouts)
+		{
+			if ((existing.setLayouts == pipelineLayout.setLayouts) &&
+				(existing.hasPushConstants == pipelineLayout.hasPushConstants) &&
+				equal(existing.pushConstantRange, pipelineLayout.pushConstantRange))
+			{
+				return existing.layout;
+			}
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+			vkTools::initializers::pipelineLayoutCreateInfo(pipelineLayout.setLayouts.data(), (uint32_t)pipelineLayout.setLayouts.size());
+		if (pipelineLayout.hasPushConstants)
+		{
+			pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+			pipelineLayoutCreateInfo.pPushConstantRanges = &pipelineLayout.pushConstantRange;
+		}
+		VkResult err = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout.layout);
+		assert(!err);
+		pipelineLayouts.push_back(pipelineLayout);
+		return pipelineLayout.layout;
+	}
+
+	uint32_t descriptorSetLayoutCount()
+	{
+		return (uint32_t)setLayouts.size();
+	}
+
+	uint32_t pipelineLayoutCount()
+	{
+		return (uint32_t)pipelineLayouts.size();
+	}
+
+	void cleanup()
+	{
+		for (auto& pipelineLayout : pipelineLayouts)
+		{
+			vkDestroyPipelineLayout(device, pipelineLayout.layout, nullptr);
+		}
+		pipelineLayouts.clear();
+		for (auto& setLayout : setLayouts)
+		{
+			vkDestroyDescriptorSetLayout(device, setLayout.layout, nullptr);
+		}
+		setLayouts.clear();
+	}
+};
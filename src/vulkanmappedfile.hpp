@@ -0,0 +1,165 @@
+/*
+* Class wrapping a read-only memory mapped file
+*
+* The contents of the file are accessed in place, without being copied into
+* a heap buffer, and the mapping is released when the object is destroyed
+*
+* Note : Mappings start on a page boundary, so the data is suitably aligned
+* to be handed to Vulkan as SPIR-V code (pCode must be 4 byte aligned)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class VulkanMappedFile
+{
+private:
+	const char *mappedData = nullptr;
+	size_t mappedSize = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#endif
+
+public:
+	VulkanMappedFile() {}
+
+	VulkanMappedFile(const char *fileName)
+	{
+		open(fileName);
+	}
+
+	~VulkanMappedFile()
+	{
+		close();
+	}
+
+	// The mapping is owned by a single object
+	VulkanMappedFile(const VulkanMappedFile&) = delete;
+	VulkanMappedFile &operator=(const VulkanMappedFile&) = delete;
+
+	// Map the whole file for reading
+	// Returns false if the file could not be opened or mapped
+	// An empty file opens successfully but has no data
+	bool open(const char *fileName)
+	{
+		close();
+#ifdef _WIN32
+		file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize))
+		{
+			close();
+			return false;
+		}
+		if (fileSize.QuadPart == 0)
+		{
+			return true;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+		{
+			close();
+			return false;
+		}
+		mappedData = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (mappedData == nullptr)
+		{
+			close();
+			return false;
+		}
+		mappedSize = (size_t)fileSize.QuadPart;
+#else
+		int fd = ::open(fileName, O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+		if (fileStat.st_size > 0)
+		{
+			void *data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED)
+			{
+				::close(fd);
+				return false;
+			}
+			mappedData = (const char*)data;
+			mappedSize = (size_t)fileStat.st_size;
+		}
+		// The mapping stays valid after the descriptor has been closed
+		::close(fd);
+#endif
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (mappedData != nullptr)
+		{
+			UnmapViewOfFile(mappedData);
+		}
+		if (mapping != NULL)
+		{
+			CloseHandle(mapping);
+			mapping = NULL;
+		}
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file);
+			file = INVALID_HANDLE_VALUE;
+		}
+#else
+		if (mappedData != nullptr)
+		{
+			munmap((void*)mappedData, mappedSize);
+		}
+#endif
+		mappedData = nullptr;
+		mappedSize = 0;
+	}
+
+	const char *data() const
+	{
+		return mappedData;
+	}
+
+	size_t size() const
+	{
+		return mappedSize;
+	}
+
+	// Returns true if the contents can be used as SPIR-V code :
+	// non empty, a whole number of 4 byte aligned words, starting with the SPIR-V magic number
+	bool isSpirv() const
+	{
+		return
+			(mappedSize >= sizeof(uint32_t)) &&
+			(mappedSize % sizeof(uint32_t) == 0) &&
+			((uintptr_t)mappedData % sizeof(uint32_t) == 0) &&
+			(*(const uint32_t*)mappedData == 0x07230203);
+	}
+};
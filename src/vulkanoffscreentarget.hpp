@@ -0,0 +1,189 @@
+/*
+* Class wrapping an offscreen color and depth render target
+*
+* The render pass uses the same formats as the example's render pass, so
+* pipelines created for the swap chain can render into the target as well
+* At the end of the render pass both attachments are in TRANSFER_SRC_OPTIMAL
+* layout, ready to be copied (see VulkanReadbackRing)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+
+class VulkanOffscreenTarget
+{
+public:
+	struct Attachment
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkFormat format;
+	};
+
+private:
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+
+	void createAttachment(Attachment *attachment, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask)
+	{
+		VkResult err;
+		attachment->format = format;
+
+		VkImageCreateInfo image = vkTools::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_2D;
+		image.format = format;
+		image.extent = { width, height, 1 };
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Copied to buffers for readback
+		image.usage = usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		err = vkCreateImage(device, &image, nullptr, &attachment->image);
+		assert(!err);
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vkTools::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		VkBool32 found = vkTools::getMemoryType(memoryProperties, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAlloc.memoryTypeIndex);
+		assert(found);
+		err = vkAllocateMemory(device, &memAlloc, nullptr, &attachment->memory);
+		assert(!err);
+		err = vkBindImageMemory(device, attachment->image, attachment->memory, 0);
+		assert(!err);
+
+		VkImageViewCreateInfo view = vkTools::initializers::imageViewCreateInfo();
+		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view.format = format;
+		view.subresourceRange = { aspectMask, 0, 1, 0, 1 };
+		view.image = attachment->image;
+		err = vkCreateImageView(device, &view, nullptr, &attachment->view);
+		assert(!err);
+	}
+
+	void destroyAttachment(Attachment *attachment)
+	{
+		vkDestroyImageView(device, attachment->view, nullptr);
+		vkDestroyImage(device, attachment->image, nullptr);
+		vkFreeMemory(device, attachment->memory, nullptr);
+		*attachment = Attachment();
+	}
+
+	void createRenderPass()
+	{
+		VkAttachmentDescription attachments[2] = {};
+		attachments[0].format = color.format;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		// Previous contents are cleared anyway
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		attachments[1] = attachments[0];
+		attachments[1].format = depth.format;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorReference;
+		subpass.pDepthStencilAttachment = &depthReference;
+
+		// Rendering waits for the copies of the previous frame, copies wait for rendering
+		VkSubpassDependency dependencies[2] = {};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = 2;
+		renderPassInfo.pAttachments = attachments;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 2;
+		renderPassInfo.pDependencies = dependencies;
+		VkResult err = vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass);
+		assert(!err);
+	}
+
+public:
+	static bool hasStencil(VkFormat format)
+	{
+		return
+			(format == VK_FORMAT_D16_UNORM_S8_UINT) ||
+			(format == VK_FORMAT_D24_UNORM_S8_UINT) ||
+			(format == VK_FORMAT_D32_SFLOAT_S8_UINT);
+	}
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	Attachment color;
+	Attachment depth;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+	void init(VkPhysicalDevice physicalDevice, VkDevice device)
+	{
+		this->device = device;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	}
+
+	// Create the attachments, render pass and frame buffer
+	// Use the formats of the example's render pass to share its pipelines
+	void create(uint32_t width, uint32_t height, VkFormat colorFormat, VkFormat depthFormat)
+	{
+		this->width = width;
+		this->height = height;
+		createAttachment(&color, colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+		createAttachment(&depth, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+			hasStencil(depthFormat) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT);
+		createRenderPass();
+
+		VkImageView attachments[2] = { color.view, depth.view };
+		VkFramebufferCreateInfo frameBufferCreateInfo = vkTools::initializers::framebufferCreateInfo();
+		frameBufferCreateInfo.renderPass = renderPass;
+		frameBufferCreateInfo.attachmentCount = 2;
+		frameBufferCreateInfo.pAttachments = attachments;
+		frameBufferCreateInfo.width = width;
+		frameBufferCreateInfo.height = height;
+		frameBufferCreateInfo.layers = 1;
+		VkResult err = vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &framebuffer);
+		assert(!err);
+	}
+
+	void cleanup()
+	{
+		if (framebuffer != VK_NULL_HANDLE)
+		{
+			vkDestroyFramebuffer(device, framebuffer, nullptr);
+			vkDestroyRenderPass(device, renderPass, nullptr);
+			destroyAttachment(&color);
+			destroyAttachment(&depth);
+			framebuffer = VK_NULL_HANDLE;
+			renderPass = VK_NULL_HANDLE;
+		}
+	}
+};
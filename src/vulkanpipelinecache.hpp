@@ -0,0 +1,189 @@
+/*
+* Class wrapping a pipeline cache that is persisted on disk between runs
+*
+* The cache data is loaded at startup and only passed to the driver if its
+* header matches the current device (vendor ID, device ID and pipeline cache UUID),
+* so a file written by another GPU or driver version is silently discarded
+* The data is written to a temporary file that is then renamed over the
+* previous one, so an interrupted save never leaves a truncated cache behind
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <vulkan/vulkan.h>
+
+class VulkanPipelineCache
+{
+private:
+	// Header written by the driver at the start of the cache data
+	struct Header
+	{
+		uint32_t headerSize;
+		uint32_t headerVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	VkDevice device;
+	VkPhysicalDeviceProperties deviceProperties;
+	std::string fileName;
+	// Size of the data at the last save, used to skip saving an unchanged cache
+	size_t savedSize = 0;
+	std::chrono::time_point<std::chrono::steady_clock> lastSave;
+
+	// Returns true if the data has been written by the same device and driver
+	bool validate(const std::vector<char> &data)
+	{
+		Header header;
+		if (data.size() < sizeof(header))
+		{
+			return false;
+		}
+		memcpy(&header, data.data(), sizeof(header));
+		return
+			(header.headerSize >= sizeof(header)) &&
+			(header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+			(header.vendorID == deviceProperties.vendorID) &&
+			(header.deviceID == deviceProperties.deviceID) &&
+			(memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+	}
+
+public:
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	// True if valid data has been loaded from disk (warm cache)
+	bool loaded = false;
+	// Minimum time between two saves done by saveIfDue()
+	double saveInterval = 30.0;
+
+	void init(VkDevice device, const VkPhysicalDeviceProperties &deviceProperties)
+	{
+		this->device = device;
+		this->deviceProperties = deviceProperties;
+	}
+
+	// Create the pipeline cache, filled with the content of fileName if it is valid for this device
+	// Pass an empty file name to create an empty cache that is never saved
+	void create(const std::string &fileName)
+	{
+		this->fileName = fileName;
+
+		std::vector<char> data;
+		if (!fileName.empty())
+		{
+			std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+			if (file.is_open())
+			{
+				data.resize((size_t)file.tellg());
+				file.seekg(0, std::ios::beg);
+				file.read(data.data(), data.size());
+				if (!file.good() || !validate(data))
+				{
+					data.clear();
+				}
+			}
+		}
+
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pipelineCacheCreateInfo.initialDataSize = data.size();
+		pipelineCacheCreateInfo.pInitialData = data.empty() ? nullptr : data.data();
+		VkResult err = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &cache);
+		if (err && !data.empty())
+		{
+			// Data rejected by the driver, start from an empty cache
+			pipelineCacheCreateInfo.initialDataSize = 0;
+			pipelineCacheCreateInfo.pInitialData = nullptr;
+			data.clear();
+			err = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &cache);
+		}
+		assert(!err);
+
+		loaded = !data.empty();
+		savedSize = data.size();
+		lastSave = std::chrono::steady_clock::now();
+	}
+
+	// Write the cache data to disk if it has grown since the last save
+	// Returns false if writing the file failed
+	bool save()
+	{
+		if (fileName.empty() || cache == VK_NULL_HANDLE)
+		{
+			return true;
+		}
+		lastSave = std::chrono::steady_clock::now();
+
+		size_t size;
+		VkResult err = vkGetPipelineCacheData(device, cache, &size, nullptr);
+		assert(!err);
+		if (size == savedSize)
+		{
+			return true;
+		}
+		std::vector<char> data(size);
+		err = vkGetPipelineCacheData(device, cache, &size, data.data());
+		assert(!err);
+
+		std::string tempFileName = fileName + ".tmp";
+		{
+			std::ofstream file(tempFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			file.write(data.data(), size);
+			if (!file.good())
+			{
+				return false;
+			}
+		}
+		// Replace the previous file in one step
+#ifdef _WIN32
+		bool renamed = MoveFileExA(tempFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		bool renamed = rename(tempFileName.c_str(), fileName.c_str()) == 0;
+#endif
+		if (renamed)
+		{
+			savedSize = size;
+		}
+		return renamed;
+	}
+
+	// Save the cache if saveInterval seconds have passed since the last save
+	// Meant to be called once per frame so pipelines created at runtime are not lost on a crash
+	void saveIfDue()
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<double>(now - lastSave).count() >= saveInterval)
+		{
+			save();
+		}
+	}
+
+	// Save the cache and destroy it
+	void cleanup()
+	{
+		if (cache != VK_NULL_HANDLE)
+		{
+			save();
+			vkDestroyPipelineCache(device, cache, nullptr);
+			cache = VK_NULL_HANDLE;
+		}
+	}
+};
@@ -0,0 +1,153 @@
+/*
+* Class for compiling graphics pipelines asynchronously on a pool of worker threads
+*
+* VulkanPipelineCompiler copies pipeline create infos into descriptions
+* (so the caller's create info does not need to outlive the compilation)
+* and compiles them on N worker threads against a shared pipeline cache,
+* returning a future per pipeline
+* The future holds VK_NULL_HANDLE if the pipeline could not be created
+*
+* Note : Pipeline caches are internally synchronized, so all workers use the same cache
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "vulkanpipelinedescription.hpp"
+#include "vulkancpuprofiler.hpp"
+
+class VulkanPipelineCompiler
+{
+private:
+	struct Job
+	{
+		VulkanPipelineDescription description;
+		std::promise<VkPipeline> promise;
+	};
+
+	VkDevice device;
+	VkPipelineCache pipelineCache;
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::deque<Job*> jobs;
+	bool stopping = false;
+
+	// Sum of the compilation times of all workers
+	std::atomic<int64_t> compileTimeMicroseconds{ 0 };
+
+	void workerLoop()
+	{
+		CPU_PROFILE_THREAD("pipeline compiler");
+		while (true)
+		{
+			Job *job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (jobs.empty())
+				{
+					return;
+				}
+				job = jobs.front();
+				jobs.pop_front();
+			}
+
+			CPU_PROFILE_SCOPE("compile pipeline");
+			VkGraphicsPipelineCreateInfo pipelineCreateInfo = job->description.createInfo();
+			VkPipeline pipeline;
+			auto tStart = std::chrono::high_resolution_clock::now();
+			VkResult err = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+			if (err != VK_SUCCESS)
+			{
+				pipeline = VK_NULL_HANDLE;
+			}
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			compileTimeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(tEnd - tStart).count();
+			job->promise.set_value(pipeline);
+			delete job;
+		}
+	}
+
+public:
+	// Start threadCount workers (one per hardware thread minus the main thread if 0)
+	void init(VkDevice device, VkPipelineCache pipelineCache, uint32_t threadCount = 0)
+	{
+		this->device = device;
+		this->pipelineCache = pipelineCache;
+		if (threadCount == 0)
+		{
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+		stopping = false;
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			workers.push_back(std::thread(&VulkanPipelineCompiler::workerLoop, this));
+		}
+	}
+
+	// Queue a pipeline for compilation
+	// The create info and everything it points to is copied, so it can be released right away
+	// The pipeline returned by the future is owned by the caller, VK_NULL_HANDLE if its creation failed
+	std::future<VkPipeline> compile(const VkGraphicsPipelineCreateInfo &pipelineCreateInfo)
+	{
+		return compile(VulkanPipelineDescription(pipelineCreateInfo));
+	}
+
+	std::future<VkPipeline> compile(const VulkanPipelineDescription &description)
+	{
+		Job *job = new Job{ description, std::promise<VkPipeline>() };
+		std::future<VkPipeline> future = job->promise.get_future();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(job);
+		}
+		jobAvailable.notify_one();
+		return future;
+	}
+
+	uint32_t threadCount()
+	{
+		return (uint32_t)workers.size();
+	}
+
+	// Time spent compiling by all workers in milliseconds
+	double compileTime()
+	{
+		return compileTimeMicroseconds / 1000.0;
+	}
+
+	// Returns true if the pipeline of a (shared) future has been compiled, without blocking
+	template<typename Future> static bool isReady(const Future &future)
+	{
+		return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	// Finish the queued jobs and stop the workers
+	void cleanup()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+		workers.clear();
+	}
+};
@@ -0,0 +1,355 @@
+/*
+* Class holding a deep copy of a graphics pipeline description
+*
+* Copies a VkGraphicsPipelineCreateInfo including the states and arrays it
+* points to, so it can outlive the create info (e.g. for asynchronous compilation)
+* and be hashed and compared (e.g. for deduplicating identical pipelines)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+
+class VulkanPipelineDescription
+{
+private:
+	// Rebuilt by createInfo() so they point into this object
+	VkPipelineVertexInputStateCreateInfo vertexInputState;
+	VkPipelineViewportStateCreateInfo viewportState;
+	VkPipelineColorBlendStateCreateInfo colorBlendState;
+	VkPipelineDynamicStateCreateInfo dynamicState;
+	std::vector<VkPipelineShaderStageCreateInfo> stageCreateInfos;
+	std::vector<VkSpecializationInfo> specializationInfos;
+
+	// Hashes the states one after the other with vkTools::hashBytes
+	struct Hasher
+	{
+		uint64_t value = vkTools::hashBytesSeed;
+
+		void addBytes(const void *data, size_t size)
+		{
+			value = vkTools::hashBytes(data, size, value);
+		}
+
+		template<typename T> void add(const T &data)
+		{
+			addBytes(&data, sizeof(T));
+		}
+	};
+
+	// Compare arrays of structures without padding
+	template<typename T> static bool equalBytes(const std::vector<T> &a, const std::vector<T> &b)
+	{
+		return (a.size() == b.size()) && (a.empty() || (memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0));
+	}
+
+public:
+	struct Stage
+	{
+		VkShaderStageFlagBits stage;
+		VkShaderModule module;
+		std::string entryPoint;
+		std::vector<VkSpecializationMapEntry> specializationMapEntries;
+		std::vector<uint8_t> specializationData;
+	};
+
+	std::vector<Stage> stages;
+	std::vector<VkVertexInputBindingDescription> vertexBindings;
+	std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyState;
+	VkPipelineRasterizationStateCreateInfo rasterizationState;
+	VkPipelineMultisampleStateCreateInfo multisampleState;
+	VkPipelineDepthStencilStateCreateInfo depthStencilState;
+	std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
+	float blendConstants[4];
+	VkBool32 logicOpEnable;
+	VkLogicOp logicOp;
+	uint32_t viewportCount;
+	uint32_t scissorCount;
+	std::vector<VkDynamicState> dynamicStates;
+	VkPipelineLayout layout;
+	VkRenderPass renderPass;
+	uint32_t subpass;
+
+	// Copy all states referenced by a create info
+	// Tessellation, sample masks, static viewports and pNext chains are not supported
+	VulkanPipelineDescription(const VkGraphicsPipelineCreateInfo &createInfo)
+	{
+		assert(createInfo.pTessellationState == nullptr);
+
+		for (uint32_t i = 0; i < createInfo.stageCount; i++)
+		{
+			const VkPipelineShaderStageCreateInfo &stageInfo = createInfo.pStages[i];
+			Stage stage;
+			stage.stage = stageInfo.stage;
+			stage.module = stageInfo.module;
+			stage.entryPoint = stageInfo.pName;
+			if (stageInfo.pSpecializationInfo != nullptr)
+			{
+				const VkSpecializationInfo &specializationInfo = *stageInfo.pSpecializationInfo;
+				stage.specializationMapEntries.assign(
+					specializationInfo.pMapEntries,
+					specializationInfo.pMapEntries + specializationInfo.mapEntryCount);
+				stage.specializationData.assign(
+					(const uint8_t*)specializationInfo.pData,
+					(const uint8_t*)specializationInfo.pData + specializationInfo.dataSize);
+			}
+			stages.push_back(stage);
+		}
+
+		const VkPipelineVertexInputStateCreateInfo &vertexInput = *createInfo.pVertexInputState;
+		vertexBindings.assign(
+			vertexInput.pVertexBindingDescriptions,
+			vertexInput.pVertexBindingDescriptions + vertexInput.vertexBindingDescriptionCount);
+		vertexAttributes.assign(
+			vertexInput.pVertexAttributeDescriptions,
+			vertexInput.pVertexAttributeDescriptions + vertexInput.vertexAttributeDescriptionCount);
+
+		inputAssemblyState = *createInfo.pInputAssemblyState;
+		rasterizationState = *createInfo.pRasterizationState;
+		multisampleState = *createInfo.pMultisampleState;
+		assert(multisampleState.pSampleMask == nullptr);
+		depthStencilState = *createInfo.pDepthStencilState;
+
+		const VkPipelineColorBlendStateCreateInfo &colorBlend = *createInfo.pColorBlendState;
+		colorBlendAttachments.assign(colorBlend.pAttachments, colorBlend.pAttachments + colorBlend.attachmentCount);
+		memcpy(blendConstants, colorBlend.blendConstants, sizeof(blendConstants));
+		logicOpEnable = colorBlend.logicOpEnable;
+		logicOp = colorBlend.logicOp;
+
+		viewportCount = createInfo.pViewportState->viewportCount;
+		scissorCount = createInfo.pViewportState->scissorCount;
+
+		if (createInfo.pDynamicState != nullptr)
+		{
+			dynamicStates.assign(
+				createInfo.pDynamicState->pDynamicStates,
+				createInfo.pDynamicState->pDynamicStates + createInfo.pDynamicState->dynamicStateCount);
+		}
+
+		layout = createInfo.layout;
+		renderPass = createInfo.renderPass;
+		subpass = createInfo.subpass;
+	}
+
+	// Bring the description into a canonical form so equivalent states compare equal
+	// Sorts order independent arrays and clears states that are ignored by the driver
+	void canonicalize()
+	{
+		std::sort(vertexBindings.begin(), vertexBindings.end(),
+			[](const VkVertexInputBindingDescription &a, const VkVertexInputBindingDescription &b) { return a.binding < b.binding; });
+		std::sort(vertexAttributes.begin(), vertexAttributes.end(),
+			[](const VkVertexInputAttributeDescription &a, const VkVertexInputAttributeDescription &b) { return a.location < b.location; });
+		std::sort(dynamicStates.begin(), dynamicStates.end());
+		std::sort(stages.begin(), stages.end(), [](const Stage &a, const Stage &b) { return a.stage < b.stage; });
+		for (auto& stage : stages)
+		{
+			std::sort(stage.specializationMapEntries.begin(), stage.specializationMapEntries.end(),
+				[](const VkSpecializationMapEntry &a, const VkSpecializationMapEntry &b) { return a.constantID < b.constantID; });
+		}
+		for (auto& attachment : colorBlendAttachments)
+		{
+			if (!attachment.blendEnable)
+			{
+				VkColorComponentFlags colorWriteMask = attachment.colorWriteMask;
+				attachment = {};
+				attachment.colorWriteMask = colorWriteMask;
+			}
+		}
+		if (!logicOpEnable)
+		{
+			logicOp = VK_LOGIC_OP_CLEAR;
+		}
+		if (!depthStencilState.stencilTestEnable)
+		{
+			depthStencilState.front = {};
+			depthStencilState.back = {};
+		}
+		if (!rasterizationState.depthBiasEnable)
+		{
+			rasterizationState.depthBiasConstantFactor = 0.0f;
+			rasterizationState.depthBiasClamp = 0.0f;
+			rasterizationState.depthBiasSlopeFactor = 0.0f;
+		}
+	}
+
+	// Hash of all states (call canonicalize first so equivalent descriptions get the same hash)
+	// Handles (shader modules, layout, render pass) are hashed by value
+	size_t hash() const
+	{
+		Hasher hasher;
+		for (auto& stage : stages)
+		{
+			hasher.add(stage.stage);
+			hasher.add((uint64_t)stage.module);
+			hasher.addBytes(stage.entryPoint.data(), stage.entryPoint.size());
+			hasher.addBytes(stage.specializationMapEntries.data(), stage.specializationMapEntries.size() * sizeof(VkSpecializationMapEntry));
+			hasher.addBytes(stage.specializationData.data(), stage.specializationData.size());
+		}
+		hasher.addBytes(vertexBindings.data(), vertexBindings.size() * sizeof(VkVertexInputBindingDescription));
+		hasher.addBytes(vertexAttributes.data(), vertexAttributes.size() * sizeof(VkVertexInputAttributeDescription));
+		hasher.add(inputAssemblyState.topology);
+		hasher.add(inputAssemblyState.primitiveRestartEnable);
+		hasher.add(rasterizationState.depthClampEnable);
+		hasher.add(rasterizationState.rasterizerDiscardEnable);
+		hasher.add(rasterizationState.polygonMode);
+		hasher.add(rasterizationState.cullMode);
+		hasher.add(rasterizationState.frontFace);
+		hasher.add(rasterizationState.depthBiasEnable);
+		hasher.add(rasterizationState.depthBiasConstantFactor);
+		hasher.add(rasterizationState.depthBiasClamp);
+		hasher.add(rasterizationState.depthBiasSlopeFactor);
+		hasher.add(rasterizationState.lineWidth);
+		hasher.add(multisampleState.rasterizationSamples);
+		hasher.add(multisampleState.sampleShadingEnable);
+		hasher.add(multisampleState.minSampleShading);
+		hasher.add(multisampleState.alphaToCoverageEnable);
+		hasher.add(multisampleState.alphaToOneEnable);
+		hasher.add(depthStencilState.depthTestEnable);
+		hasher.add(depthStencilState.depthWriteEnable);
+		hasher.add(depthStencilState.depthCompareOp);
+		hasher.add(depthStencilState.depthBoundsTestEnable);
+		hasher.add(depthStencilState.stencilTestEnable);
+		hasher.add(depthStencilState.front);
+		hasher.add(depthStencilState.back);
+		hasher.add(depthStencilState.minDepthBounds);
+		hasher.add(depthStencilState.maxDepthBounds);
+		hasher.addBytes(colorBlendAttachments.data(), colorBlendAttachments.size() * sizeof(VkPipelineColorBlendAttachmentState));
+		hasher.addBytes(blendConstants, sizeof(blendConstants));
+		hasher.add(logicOpEnable);
+		hasher.add(logicOp);
+		hasher.add(viewportCount);
+		hasher.add(scissorCount);
+		hasher.addBytes(dynamicStates.data(), dynamicStates.size() * sizeof(VkDynamicState));
+		hasher.add((uint64_t)layout);
+		hasher.add((uint64_t)renderPass);
+		hasher.add(subpass);
+		return (size_t)hasher.value;
+	}
+
+	// Compare all states hashed by hash()
+	bool operator==(const VulkanPipelineDescription &other) const
+	{
+		if (stages.size() != other.stages.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < stages.size(); i++)
+		{
+			const Stage &a = stages[i];
+			const Stage &b = other.stages[i];
+			if ((a.stage != b.stage) || (a.module != b.module) || (a.entryPoint != b.entryPoint) ||
+				(a.specializationData != b.specializationData) ||
+				!equalBytes(a.specializationMapEntries, b.specializationMapEntries))
+			{
+				return false;
+			}
+		}
+		const VkPipelineInputAssemblyStateCreateInfo &ia = inputAssemblyState, &oia = other.inputAssemblyState;
+		const VkPipelineRasterizationStateCreateInfo &rs = rasterizationState, &ors = other.rasterizationState;
+		const VkPipelineMultisampleStateCreateInfo &ms = multisampleState, &oms = other.multisampleState;
+		const VkPipelineDepthStencilStateCreateInfo &ds = depthStencilState, &ods = other.depthStencilState;
+		return
+			equalBytes(vertexBindings, other.vertexBindings) &&
+			equalBytes(vertexAttributes, other.vertexAttributes) &&
+			(ia.topology == oia.topology) && (ia.primitiveRestartEnable == oia.primitiveRestartEnable) &&
+			(rs.depthClampEnable == ors.depthClampEnable) && (rs.rasterizerDiscardEnable == ors.rasterizerDiscardEnable) &&
+			(rs.polygonMode == ors.polygonMode) && (rs.cullMode == ors.cullMode) && (rs.frontFace == ors.frontFace) &&
+			(rs.depthBiasEnable == ors.depthBiasEnable) && (rs.depthBiasConstantFactor == ors.depthBiasConstantFactor) &&
+			(rs.depthBiasClamp == ors.depthBiasClamp) && (rs.depthBiasSlopeFactor == ors.depthBiasSlopeFactor) &&
+			(rs.lineWidth == ors.lineWidth) &&
+			(ms.rasterizationSamples == oms.rasterizationSamples) && (ms.sampleShadingEnable == oms.sampleShadingEnable) &&
+			(ms.minSampleShading == oms.minSampleShading) && (ms.alphaToCoverageEnable == oms.alphaToCoverageEnable) &&
+			(ms.alphaToOneEnable == oms.alphaToOneEnable) &&
+			(ds.depthTestEnable == ods.depthTestEnable) && (ds.depthWriteEnable == ods.depthWriteEnable) &&
+			(ds.depthCompareOp == ods.depthCompareOp) && (ds.depthBoundsTestEnable == ods.depthBoundsTestEnable) &&
+			(ds.stencilTestEnable == ods.stencilTestEnable) &&
+			(memcmp(&ds.front, &ods.front, sizeof(VkStencilOpState)) == 0) &&
+			(memcmp(&ds.back, &ods.back, sizeof(VkStencilOpState)) == 0) &&
+			(ds.minDepthBounds == ods.minDepthBounds) && (ds.maxDepthBounds == ods.maxDepthBounds) &&
+			equalBytes(colorBlendAttachments, other.colorBlendAttachments) &&
+			(memcmp(blendConstants, other.blendConstants, sizeof(blendConstants)) == 0) &&
+			(logicOpEnable == other.logicOpEnable) && (logicOp == other.logicOp) &&
+			(viewportCount == other.viewportCount) && (scissorCount == other.scissorCount) &&
+			(dynamicStates == other.dynamicStates) &&
+			(layout == other.layout) && (renderPass == other.renderPass) && (subpass == other.subpass);
+	}
+
+	// Returns a create info pointing into this description
+	// Only valid as long as the description is neither modified nor moved
+	VkGraphicsPipelineCreateInfo createInfo()
+	{
+		specializationInfos.resize(stages.size());
+		stageCreateInfos.resize(stages.size());
+		for (size_t i = 0; i < stages.size(); i++)
+		{
+			VkPipelineShaderStageCreateInfo &stageInfo = stageCreateInfos[i];
+			stageInfo = {};
+			stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stageInfo.stage = stages[i].stage;
+			stageInfo.module = stages[i].module;
+			stageInfo.pName = stages[i].entryPoint.c_str();
+			if (!stages[i].specializationMapEntries.empty())
+			{
+				VkSpecializationInfo &specializationInfo = specializationInfos[i];
+				specializationInfo.mapEntryCount = (uint32_t)stages[i].specializationMapEntries.size();
+				specializationInfo.pMapEntries = stages[i].specializationMapEntries.data();
+				specializationInfo.dataSize = stages[i].specializationData.size();
+				specializationInfo.pData = stages[i].specializationData.data();
+				stageInfo.pSpecializationInfo = &specializationInfo;
+			}
+		}
+
+		vertexInputState = {};
+		vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputState.vertexBindingDescriptionCount = (uint32_t)vertexBindings.size();
+		vertexInputState.pVertexBindingDescriptions = vertexBindings.data();
+		vertexInputState.vertexAttributeDescriptionCount = (uint32_t)vertexAttributes.size();
+		vertexInputState.pVertexAttributeDescriptions = vertexAttributes.data();
+
+		viewportState = {};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = viewportCount;
+		viewportState.scissorCount = scissorCount;
+
+		colorBlendState = {};
+		colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlendState.logicOpEnable = logicOpEnable;
+		colorBlendState.logicOp = logicOp;
+		colorBlendState.attachmentCount = (uint32_t)colorBlendAttachments.size();
+		colorBlendState.pAttachments = colorBlendAttachments.data();
+		memcpy(colorBlendState.blendConstants, blendConstants, sizeof(blendConstants));
+
+		dynamicState = {};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = (uint32_t)dynamicStates.size();
+		dynamicState.pDynamicStates = dynamicStates.data();
+
+		VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineCreateInfo.stageCount = (uint32_t)stageCreateInfos.size();
+		pipelineCreateInfo.pStages = stageCreateInfos.data();
+		pipelineCreateInfo.pVertexInputState = &vertexInputState;
+		pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+		pipelineCreateInfo.pViewportState = &viewportState;
+		pipelineCreateInfo.pRasterizationState = &rasterizationState;
+		pipelineCreateInfo.pMultisampleState = &multisampleState;
+		pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+		pipelineCreateInfo.pColorBlendState = &colorBlendState;
+		pipelineCreateInfo.pDynamicState = dynamicStates.empty() ? nullptr : &dynamicState;
+		pipelineCreateInfo.layout = layout;
+		pipelineCreateInfo.renderPass = renderPass;
+		pipelineCreateInfo.subpass = subpass;
+		return pipelineCreateInfo;
+	}
+};
@@ -0,0 +1,211 @@
+/*
+* Class deduplicating graphics pipelines by a hash of their complete state
+*
+* Pipelines are requested with a create info, which is copied into a canonical
+* description (shaders, vertex input, raster, blend, depth, dynamic states,
+* layout and render pass) and looked up by its hash
+* Identical requests return the existing pipeline instead of compiling a new one
+* Misses are compiled right away or on a VulkanPipelineCompiler if one is attached
+*
+* With a VulkanShaderModuleCache attached, shader modules are compared by the
+* hash of their code and the registry keeps a reference to the modules of each
+* pipeline until it has been compiled, so they can be destroyed right after
+*
+* Note : Render passes and layouts are compared by handle, so pipelines created
+* for distinct but compatible render passes are not merged
+* Not thread safe, requests must come from one thread
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <chrono>
+#include <future>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+#include "vulkanpipelinedescription.hpp"
+#include "vulkanpipelinecompiler.hpp"
+#include "vulkanshadermodulecache.hpp"
+
+class VulkanPipelineRegistry
+{
+private:
+	struct Entry
+	{
+		VulkanPipelineDescription description;
+		// Code hash of each stage whose module is in the shader module cache (0 for the others)
+		std::vector<uint64_t> codeHashes;
+		std::shared_future<VkPipeline> pipeline;
+	};
+
+	// References to the shader modules of a pipeline, held until it is compiled
+	struct ShaderModuleReferences
+	{
+		std::shared_future<VkPipeline> pipeline;
+		std::vector<VkShaderModule> shaderModules;
+	};
+
+	VkDevice device;
+	VkPipelineCache pipelineCache;
+	VulkanPipelineCompiler *compiler = nullptr;
+	VulkanShaderModuleCache *shaderModuleCache = nullptr;
+	// Entries with the same hash are compared to rule out collisions
+	std::unordered_map<size_t, std::vector<Entry>> entries;
+	std::vector<ShaderModuleReferences> shaderModuleReferences;
+
+	// Time spent compiling on the calling thread
+	double syncCompileTime = 0.0;
+
+public:
+	struct Stats
+	{
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+	} stats;
+
+	// Pipelines are compiled asynchronously on compiler if not null
+	// Shader modules are identified by their code if shaderModuleCache is not null
+	void init(VkDevice device, VkPipelineCache pipelineCache, VulkanPipelineCompiler *compiler = nullptr, VulkanShaderModuleCache *shaderModuleCache = nullptr)
+	{
+		this->device = device;
+		this->pipelineCache = pipelineCache;
+		this->compiler = compiler;
+		this->shaderModuleCache = shaderModuleCache;
+	}
+
+	// Returns the pipeline matching a create info, compiling it if it does not exist yet
+	// The future is ready right away unless the pipeline is compiled asynchronously
+	// (async set and a compiler attached)
+	// Pipelines are owned by the registry and destroyed by cleanup()
+	// The future holds VK_NULL_HANDLE if the pipeline could not be created
+	std::shared_future<VkPipeline> acquire(const VkGraphicsPipelineCreateInfo &pipelineCreateInfo, bool async = true)
+	{
+		VulkanPipelineDescription description(pipelineCreateInfo);
+		description.canonicalize();
+
+		// Modules of the cache are keyed by the full hash of their code instead of their handle,
+		// which may be reused once destroyed
+		VulkanPipelineDescription key = description;
+		std::vector<uint64_t> codeHashes(key.stages.size(), 0);
+		std::vector<VkShaderModule> shaderModules;
+		if (shaderModuleCache != nullptr)
+		{
+			for (size_t i = 0; i < key.stages.size(); i++)
+			{
+				VulkanPipelineDescription::Stage &stage = key.stages[i];
+				if (shaderModuleCache->contains(stage.module))
+				{
+					shaderModules.push_back(stage.module);
+					codeHashes[i] = shaderModuleCache->contentHash(stage.module);
+					stage.module = VK_NULL_HANDLE;
+				}
+			}
+		}
+		size_t hash = (size_t)vkTools::hashBytes(codeHashes.data(), codeHashes.size() * sizeof(uint64_t), key.hash());
+
+		std::vector<Entry> &bucket = entries[hash];
+		for (auto& entry : bucket)
+		{
+			if ((entry.description == key) && (entry.codeHashes == codeHashes))
+			{
+				stats.hits++;
+				return entry.pipeline;
+			}
+		}
+
+		stats.misses++;
+		std::shared_future<VkPipeline> pipeline;
+		if (async && (compiler != nullptr))
+		{
+			pipeline = compiler->compile(description).share();
+		}
+		else
+		{
+			VkGraphicsPipelineCreateInfo canonicalCreateInfo = description.createInfo();
+			std::promise<VkPipeline> promise;
+			VkPipeline compiled;
+			auto tStart = std::chrono::high_resolution_clock::now();
+			VkResult err = vkCreateGraphicsPipelines(device, pipelineCache, 1, &canonicalCreateInfo, nullptr, &compiled);
+			if (err != VK_SUCCESS)
+			{
+				compiled = VK_NULL_HANDLE;
+			}
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			syncCompileTime += std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			promise.set_value(compiled);
+			pipeline = promise.get_future().share();
+		}
+		bucket.push_back({ key, codeHashes, pipeline });
+		if (!shaderModules.empty())
+		{
+			for (auto& shaderModule : shaderModules)
+			{
+				shaderModuleCache->addRef(shaderModule);
+			}
+			shaderModuleReferences.push_back({ pipeline, shaderModules });
+			releaseShaderModules();
+		}
+		return pipeline;
+	}
+
+	// Give back the shader module references of the pipelines that have been compiled
+	// Returns the number of references released
+	uint32_t releaseShaderModules()
+	{
+		uint32_t released = 0;
+		for (auto it = shaderModuleReferences.begin(); it != shaderModuleReferences.end();)
+		{
+			if (VulkanPipelineCompiler::isReady(it->pipeline))
+			{
+				for (auto& shaderModule : it->shaderModules)
+				{
+					shaderModuleCache->release(shaderModule);
+				}
+				released += (uint32_t)it->shaderModules.size();
+				it = shaderModuleReferences.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		return released;
+	}
+
+	// Number of distinct pipelines
+	uint32_t size()
+	{
+		uint32_t count = 0;
+		for (auto& bucket : entries)
+		{
+			count += (uint32_t)bucket.second.size();
+		}
+		return count;
+	}
+
+	// Time spent compiling pipelines in milliseconds, including the attached compiler's workers
+	double compileTime()
+	{
+		return syncCompileTime + (compiler != nullptr ? compiler->compileTime() : 0.0);
+	}
+
+	// Destroy all pipelines, waiting for the ones still being compiled
+	void cleanup()
+	{
+		for (auto& bucket : entries)
+		{
+			for (auto& entry : bucket.second)
+			{
+				vkDestroyPipeline(device, entry.pipeline.get(), nullptr);
+			}
+		}
+		entries.clear();
+		// All pipelines have been compiled
+		releaseShaderModules();
+	}
+};
@@ -0,0 +1,299 @@
+/*
+* Class reading the color and depth of an offscreen target back to the host without stalling
+*
+* Each frame uses one slot of the ring : a command buffer that renders into the
+* target (recorded by the caller between beginFrame() and endFrame()) followed by
+* copies of both attachments into a host visible buffer, and a fence signaled
+* when the copies are done
+* readback() only checks the fence, so the pixels of a frame are picked up once
+* they are available while the next frames are already being rendered
+* Buffers are HOST_CACHED if possible, which makes host reads much faster than
+* from write combined memory
+*
+* Note : The data of a frame stays valid until its slot is reused, slotCount frames later
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+#include "vulkanoffscreentarget.hpp"
+
+class VulkanReadbackRing
+{
+public:
+	// Pixels of a frame, tightly packed rows
+	struct Readback
+	{
+		uint64_t frame;
+		uint32_t width;
+		uint32_t height;
+		// Same format as the target's color attachment (4 bytes per pixel)
+		const uint8_t *color;
+		// Depth aspect only, depthTexelSize bytes per pixel (stencil is not read back)
+		const uint8_t *depth;
+		uint32_t depthTexelSize;
+	};
+
+private:
+	struct Slot
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		uint8_t *mapped = nullptr;
+		VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		uint64_t frame = 0;
+		// Submitted and not yet read back
+		bool pending = false;
+	};
+
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	VkCommandPool cmdPool;
+	VkQueue queue;
+	const VulkanOffscreenTarget *target = nullptr;
+	std::vector<Slot> slots;
+	// Slot of the frame being recorded
+	Slot *recording = nullptr;
+	VkDeviceSize colorSize = 0;
+	VkDeviceSize depthSize = 0;
+	uint32_t depthTexelSize = 0;
+	bool coherent = false;
+
+	static uint32_t depthAspectTexelSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+			return 2;
+		default:
+			// 24 bit depth is copied as 32 bit texels
+			return 4;
+		}
+	}
+
+	Slot &slot(uint64_t frame)
+	{
+		return slots[frame % slots.size()];
+	}
+
+	void recordCopies(VkCommandBuffer cmdBuffer)
+	{
+		// The target's render pass leaves both attachments in TRANSFER_SRC_OPTIMAL
+		// and makes the attachment writes visible to transfers
+		VkBufferImageCopy copyRegion = {};
+		copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.imageExtent = { target->width, target->height, 1 };
+		vkCmdCopyImageToBuffer(cmdBuffer, target->color.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, recording->buffer, 1, &copyRegion);
+		copyRegion.bufferOffset = colorSize;
+		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		vkCmdCopyImageToBuffer(cmdBuffer, target->depth.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, recording->buffer, 1, &copyRegion);
+
+		// Make the copies visible to the host
+		VkBufferMemoryBarrier bufferBarrier = vkTools::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = recording->buffer;
+		bufferBarrier.offset = 0;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
+
+	void fillReadback(Slot &slot, Readback *readback)
+	{
+		if (!coherent)
+		{
+			VkMappedMemoryRange range = {};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = slot.memory;
+			range.offset = 0;
+			range.size = VK_WHOLE_SIZE;
+			vkInvalidateMappedMemoryRanges(device, 1, &range);
+		}
+		slot.pending = false;
+		stats.framesRead++;
+		stats.bytesRead += colorSize + depthSize;
+
+		readback->frame = slot.frame;
+		readback->width = target->width;
+		readback->height = target->height;
+		readback->color = slot.mapped;
+		readback->depth = slot.mapped + colorSize;
+		readback->depthTexelSize = depthTexelSize;
+	}
+
+public:
+	struct Stats
+	{
+		uint64_t framesSubmitted = 0;
+		uint64_t framesRead = 0;
+		// Frames that could not be read back because their slot was still in use
+		uint64_t framesSkipped = 0;
+		uint64_t bytesRead = 0;
+	} stats;
+
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool cmdPool, VkQueue queue)
+	{
+		this->device = device;
+		this->cmdPool = cmdPool;
+		this->queue = queue;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	}
+
+	// Create slotCount slots sized for the attachments of the target
+	// More slots let the host fall further behind the device without skipping frames
+	void create(const VulkanOffscreenTarget *target, uint32_t slotCount = 3)
+	{
+		assert(slotCount > 0);
+		this->target = target;
+		colorSize = (VkDeviceSize)target->width * target->height * 4;
+		depthTexelSize = depthAspectTexelSize(target->depth.format);
+		depthSize = (VkDeviceSize)target->width * target->height * depthTexelSize;
+
+		VkResult err;
+		slots.resize(slotCount);
+		std::vector<VkCommandBuffer> cmdBuffers(slotCount);
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vkTools::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, slotCount);
+		err = vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, cmdBuffers.data());
+		assert(!err);
+
+		for (uint32_t i = 0; i < slotCount; i++)
+		{
+			Slot &slot = slots[i];
+			slot.cmdBuffer = cmdBuffers[i];
+
+			VkBufferCreateInfo bufferCreateInfo = vkTools::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_DST_BIT, colorSize + depthSize);
+			err = vkCreateBuffer(device, &bufferCreateInfo, nullptr, &slot.buffer);
+			assert(!err);
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(device, slot.buffer, &memReqs);
+			VkMemoryAllocateInfo memAlloc = vkTools::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			// Cached memory is usually not coherent, ranges are invalidated before reading
+			coherent = false;
+			if (!vkTools::getMemoryType(memoryProperties, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &memAlloc.memoryTypeIndex))
+			{
+				VkBool32 found = vkTools::getMemoryType(memoryProperties, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &memAlloc.memoryTypeIndex);
+				assert(found);
+				coherent = true;
+			}
+			err = vkAllocateMemory(device, &memAlloc, nullptr, &slot.memory);
+			assert(!err);
+			err = vkBindBufferMemory(device, slot.buffer, slot.memory, 0);
+			assert(!err);
+			err = vkMapMemory(device, slot.memory, 0, VK_WHOLE_SIZE, 0, (void**)&slot.mapped);
+			assert(!err);
+
+			// Signaled so the first use of the slot does not wait
+			VkFenceCreateInfo fenceCreateInfo = vkTools::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+			err = vkCreateFence(device, &fenceCreateInfo, nullptr, &slot.fence);
+			assert(!err);
+		}
+	}
+
+	uint32_t slotCount() const
+	{
+		return (uint32_t)slots.size();
+	}
+
+	// Size of one frame's color and depth data in bytes
+	VkDeviceSize frameSize() const
+	{
+		return colorSize + depthSize;
+	}
+
+	// Begin the command buffer of a frame, record rendering into the target's frame buffer into it
+	// Returns VK_NULL_HANDLE without waiting if the slot of the frame is still in use by the device
+	// Frames that have not been read back are overwritten (and counted as skipped)
+	VkCommandBuffer beginFrame(uint64_t frame)
+	{
+		assert(recording == nullptr);
+		Slot &frameSlot = slot(frame);
+		if (vkGetFenceStatus(device, frameSlot.fence) != VK_SUCCESS)
+		{
+			return VK_NULL_HANDLE;
+		}
+		if (frameSlot.pending)
+		{
+			stats.framesSkipped++;
+		}
+		VkResult err = vkResetFences(device, 1, &frameSlot.fence);
+		assert(!err);
+		frameSlot.frame = frame;
+		frameSlot.pending = false;
+
+		VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
+		err = vkBeginCommandBuffer(frameSlot.cmdBuffer, &cmdBufInfo);
+		assert(!err);
+		recording = &frameSlot;
+		return frameSlot.cmdBuffer;
+	}
+
+	// Record the copies of the target and submit the frame
+	void endFrame()
+	{
+		assert(recording != nullptr);
+		recordCopies(recording->cmdBuffer);
+		VkResult err = vkEndCommandBuffer(recording->cmdBuffer);
+		assert(!err);
+
+		VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &recording->cmdBuffer;
+		err = vkQueueSubmit(queue, 1, &submitInfo, recording->fence);
+		assert(!err);
+		recording->pending = true;
+		recording = nullptr;
+		stats.framesSubmitted++;
+	}
+
+	// Get the pixels of a frame if its copies have completed, never waits
+	// Returns false if the frame is not done yet, has already been read or has been overwritten
+	bool readback(uint64_t frame, Readback *readback)
+	{
+		Slot &frameSlot = slot(frame);
+		if (!frameSlot.pending || (frameSlot.frame != frame) || (vkGetFenceStatus(device, frameSlot.fence) != VK_SUCCESS))
+		{
+			return false;
+		}
+		fillReadback(frameSlot, readback);
+		return true;
+	}
+
+	// Same as readback() but waits for the frame to complete
+	bool wait(uint64_t frame, Readback *readback)
+	{
+		Slot &frameSlot = slot(frame);
+		if (!frameSlot.pending || (frameSlot.frame != frame))
+		{
+			return false;
+		}
+		VkResult err = vkWaitForFences(device, 1, &frameSlot.fence, VK_TRUE, UINT64_MAX);
+		assert(!err);
+		fillReadback(frameSlot, readback);
+		return true;
+	}
+
+	void cleanup()
+	{
+		for (auto& slot : slots)
+		{
+			vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+			vkDestroyFence(device, slot.fence, nullptr);
+			vkFreeCommandBuffers(device, cmdPool, 1, &slot.cmdBuffer);
+			vkUnmapMemory(device, slot.memory);
+			vkDestroyBuffer(device, slot.buffer, nullptr);
+			vkFreeMemory(device, slot.memory, nullptr);
+		}
+		slots.clear();
+	}
+};
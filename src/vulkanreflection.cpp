@@ -0,0 +1,539 @@
+/*
+* SPIR-V reflection
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanreflection.h"
+#include "vulkantools.h"
+
+#include <algorithm>
+#include <map>
+
+#include <vulkan/spirv.hpp>
+
+namespace vkReflection
+{
+	namespace
+	{
+		// StorageBuffer storage class (SPIR-V 1.3), not in the bundled header
+		const uint32_t storageClassStorageBuffer = 12;
+		const uint32_t unset = ~0u;
+
+		struct Type
+		{
+			uint32_t op = 0;
+			// Operands following the result ID
+			std::vector<uint32_t> operands;
+		};
+
+		struct Decorations
+		{
+			uint32_t set = unset;
+			uint32_t binding = unset;
+			uint32_t location = unset;
+			uint32_t arrayStride = 0;
+			bool builtIn = false;
+			bool block = false;
+			bool bufferBlock = false;
+			std::vector<uint32_t> memberOffsets;
+			std::vector<uint32_t> memberMatrixStrides;
+		};
+
+		struct Variable
+		{
+			uint32_t id;
+			uint32_t typeId;
+			uint32_t storageClass;
+		};
+
+		struct Module
+		{
+			std::vector<Type> types;
+			std::vector<Decorations> decorations;
+			std::vector<uint32_t> constants;
+			std::vector<Variable> variables;
+		};
+
+		void setMember(std::vector<uint32_t> &values, uint32_t member, uint32_t value)
+		{
+			if (values.size() <= member)
+			{
+				values.resize(member + 1, 0);
+			}
+			values[member] = value;
+		}
+
+		// Checks the operands of a type declaration that the reflection follows
+		// Types used by a type must be declared before it (except the pointee of a pointer),
+		// so the helpers below can't recurse endlessly or index past the types of the module
+		bool validType(const Module &module, uint32_t op, const std::vector<uint32_t> &operands)
+		{
+			uint32_t bound = (uint32_t)module.types.size();
+			auto declared = [&](uint32_t id) { return (id < bound) && (module.types[id].op != 0); };
+			switch (op)
+			{
+			case spv::OpTypeInt:
+			case spv::OpTypeFloat:
+				return operands.size() >= 1;
+			case spv::OpTypeVector:
+			case spv::OpTypeMatrix:
+				// 2 to 4 components or columns
+				return (operands.size() >= 2) && declared(operands[0]) && (operands[1] >= 2) && (operands[1] <= 4);
+			case spv::OpTypeArray:
+				return (operands.size() >= 2) && declared(operands[0]) && (operands[1] < bound);
+			case spv::OpTypeRuntimeArray:
+			case spv::OpTypeSampledImage:
+				return (operands.size() >= 1) && declared(operands[0]);
+			case spv::OpTypeStruct:
+				return std::all_of(operands.begin(), operands.end(), declared);
+			case spv::OpTypePointer:
+				return (operands.size() >= 2) && (operands[1] < bound);
+			case spv::OpTypeImage:
+				// Sampled type, dim, depth, arrayed, multisampled, sampled, format
+				return operands.size() >= 7;
+			default:
+				return true;
+			}
+		}
+
+		// Size in bytes of a type inside a buffer block, using the explicit layout decorations
+		uint32_t typeSize(const Module &module, uint32_t typeId, uint32_t matrixStride)
+		{
+			const Type &type = module.types[typeId];
+			switch (type.op)
+			{
+			case spv::OpTypeBool:
+				return 4;
+			case spv::OpTypeInt:
+			case spv::OpTypeFloat:
+				return type.operands[0] / 8;
+			case spv::OpTypeVector:
+				return type.operands[1] * typeSize(module, type.operands[0], 0);
+			case spv::OpTypeMatrix:
+				return type.operands[1] * (matrixStride != 0 ? matrixStride : typeSize(module, type.operands[0], 0));
+			case spv::OpTypeArray:
+			{
+				uint32_t length = module.constants[type.operands[1]];
+				uint32_t stride = module.decorations[typeId].arrayStride;
+				return length * (stride != 0 ? stride : typeSize(module, type.operands[0], matrixStride));
+			}
+			case spv::OpTypeStruct:
+			{
+				const Decorations &decorations = module.decorations[typeId];
+				uint32_t size = 0;
+				for (uint32_t i = 0; i < type.operands.size(); i++)
+				{
+					uint32_t offset = i < decorations.memberOffsets.size() ? decorations.memberOffsets[i] : 0;
+					uint32_t memberMatrixStride = i < decorations.memberMatrixStrides.size() ? decorations.memberMatrixStrides[i] : 0;
+					size = std::max(size, offset + typeSize(module, type.operands[i], memberMatrixStride));
+				}
+				return size;
+			}
+			default:
+				return 0;
+			}
+		}
+
+		// Strip (possibly nested) arrays from a type and return the element type
+		// descriptorCount receives the total number of elements, 0 for runtime arrays
+		uint32_t stripArrays(const Module &module, uint32_t typeId, uint32_t *descriptorCount)
+		{
+			*descriptorCount = 1;
+			while (true)
+			{
+				const Type &type = module.types[typeId];
+				if (type.op == spv::OpTypeArray)
+				{
+					*descriptorCount *= module.constants[type.operands[1]];
+				}
+				else if (type.op == spv::OpTypeRuntimeArray)
+				{
+					*descriptorCount = 0;
+				}
+				else
+				{
+					return typeId;
+				}
+				typeId = type.operands[0];
+			}
+		}
+
+		bool descriptorType(const Module &module, uint32_t storageClass, uint32_t typeId, VkDescriptorType *descriptorType)
+		{
+			const Type &type = module.types[typeId];
+			if (storageClass == storageClassStorageBuffer)
+			{
+				*descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				return true;
+			}
+			if (storageClass == spv::StorageClassUniform)
+			{
+				*descriptorType = module.decorations[typeId].bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				return true;
+			}
+			if (storageClass != spv::StorageClassUniformConstant)
+			{
+				return false;
+			}
+			switch (type.op)
+			{
+			case spv::OpTypeSampler:
+				*descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+				return true;
+			case spv::OpTypeSampledImage:
+				*descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				return true;
+			case spv::OpTypeImage:
+			{
+				// Operands : sampled type, dim, depth, arrayed, multisampled, sampled, format
+				uint32_t dim = type.operands[1];
+				bool storage = type.operands[5] == 2;
+				if (dim == spv::DimSubpassData)
+				{
+					*descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				}
+				else if (dim == spv::DimBuffer)
+				{
+					*descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				}
+				else
+				{
+					*descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				}
+				return true;
+			}
+			default:
+				return false;
+			}
+		}
+
+		// Format of a 32 bit scalar or vector vertex input, VK_FORMAT_UNDEFINED if not supported
+		VkFormat vertexFormat(const Module &module, uint32_t typeId, uint32_t *size)
+		{
+			const VkFormat formats[3][4] =
+			{
+				{ VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT },
+				{ VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT },
+				{ VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT },
+			};
+
+			const Type *type = &module.types[typeId];
+			uint32_t componentCount = 1;
+			if (type->op == spv::OpTypeVector)
+			{
+				componentCount = type->operands[1];
+				type = &module.types[type->operands[0]];
+			}
+			if ((componentCount > 4) || (type->operands.empty()) || (type->operands[0] != 32))
+			{
+				return VK_FORMAT_UNDEFINED;
+			}
+			*size = componentCount * 4;
+			if (type->op == spv::OpTypeFloat)
+			{
+				return formats[0][componentCount - 1];
+			}
+			if (type->op == spv::OpTypeInt)
+			{
+				return formats[type->operands[1] ? 1 : 2][componentCount - 1];
+			}
+			return VK_FORMAT_UNDEFINED;
+		}
+
+		VkShaderStageFlagBits shaderStage(uint32_t executionModel)
+		{
+			switch (executionModel)
+			{
+			case spv::ExecutionModelVertex: return VK_SHADER_STAGE_VERTEX_BIT;
+			case spv::ExecutionModelTessellationControl: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+			case spv::ExecutionModelTessellationEvaluation: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+			case spv::ExecutionModelGeometry: return VK_SHADER_STAGE_GEOMETRY_BIT;
+			case spv::ExecutionModelFragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+			case spv::ExecutionModelGLCompute: return VK_SHADER_STAGE_COMPUTE_BIT;
+			default: return VK_SHADER_STAGE_ALL;
+			}
+		}
+	}
+
+	bool reflect(const uint32_t *code, size_t codeSize, ShaderInterface *shaderInterface)
+	{
+		size_t wordCount = codeSize / sizeof(uint32_t);
+		if ((wordCount < 5) || (code[0] != spv::MagicNumber))
+		{
+			return false;
+		}
+
+		// Header : magic, version, generator, bound, schema
+		uint32_t bound = code[3];
+		// Each ID is defined by an instruction of at least two words
+		if (bound > wordCount)
+		{
+			return false;
+		}
+		Module module;
+		module.types.resize(bound);
+		module.decorations.resize(bound);
+		module.constants.resize(bound, 0);
+
+		*shaderInterface = {};
+		shaderInterface->stage = VK_SHADER_STAGE_ALL;
+
+		// Collect types, decorations, constants and global variables
+		size_t offset = 5;
+		while (offset < wordCount)
+		{
+			const uint32_t *instruction = code + offset;
+			uint32_t opcode = instruction[0] & spv::OpCodeMask;
+			uint32_t length = instruction[0] >> spv::WordCountShift;
+			if ((length == 0) || (offset + length > wordCount))
+			{
+				return false;
+			}
+
+			// Malformed modules (e.g. hot reloaded files being written) are rejected, the IDs used
+			// as indices must be below the bound of the header
+			switch (opcode)
+			{
+			case spv::OpEntryPoint:
+				if (length < 2)
+				{
+					return false;
+				}
+				if (shaderInterface->stage == VK_SHADER_STAGE_ALL)
+				{
+					shaderInterface->stage = shaderStage(instruction[1]);
+				}
+				break;
+			case spv::OpDecorate:
+			{
+				if ((length < 3) || (instruction[1] >= bound))
+				{
+					return false;
+				}
+				Decorations &decorations = module.decorations[instruction[1]];
+				uint32_t value = length > 3 ? instruction[3] : 0;
+				switch (instruction[2])
+				{
+				case spv::DecorationDescriptorSet: decorations.set = value; break;
+				case spv::DecorationBinding: decorations.binding = value; break;
+				case spv::DecorationLocation: decorations.location = value; break;
+				case spv::DecorationArrayStride: decorations.arrayStride = value; break;
+				case spv::DecorationBuiltIn: decorations.builtIn = true; break;
+				case spv::DecorationBlock: decorations.block = true; break;
+				case spv::DecorationBufferBlock: decorations.bufferBlock = true; break;
+				}
+				break;
+			}
+			case spv::OpMemberDecorate:
+			{
+				// A struct can't have more members than the module has words
+				if ((length < 4) || (instruction[1] >= bound) || (instruction[2] >= wordCount))
+				{
+					return false;
+				}
+				Decorations &decorations = module.decorations[instruction[1]];
+				uint32_t value = length > 4 ? instruction[4] : 0;
+				switch (instruction[3])
+				{
+				case spv::DecorationOffset: setMember(decorations.memberOffsets, instruction[2], value); break;
+				case spv::DecorationMatrixStride: setMember(decorations.memberMatrixStrides, instruction[2], value); break;
+				}
+				break;
+			}
+			case spv::OpConstant:
+				if ((length < 4) || (instruction[2] >= bound))
+				{
+					return false;
+				}
+				module.constants[instruction[2]] = instruction[3];
+				break;
+			case spv::OpVariable:
+				if ((length < 4) || (instruction[1] >= bound) || (instruction[2] >= bound))
+				{
+					return false;
+				}
+				module.variables.push_back({ instruction[2], instruction[1], instruction[3] });
+				break;
+			default:
+				// All type declarations have their result ID as first operand
+				if ((opcode >= spv::OpTypeVoid) && (opcode <= spv::OpTypePipe))
+				{
+					if ((length < 2) || (instruction[1] >= bound) || (module.types[instruction[1]].op != 0))
+					{
+						return false;
+					}
+					std::vector<uint32_t> operands(instruction + 2, instruction + length);
+					if (!validType(module, opcode, operands))
+					{
+						return false;
+					}
+					Type &type = module.types[instruction[1]];
+					type.op = opcode;
+					type.operands = std::move(operands);
+				}
+				break;
+			}
+			offset += length;
+		}
+
+		for (auto& variable : module.variables)
+		{
+			const Type &pointer = module.types[variable.typeId];
+			if (pointer.op != spv::OpTypePointer)
+			{
+				continue;
+			}
+			uint32_t typeId = pointer.operands[1];
+			const Decorations &decorations = module.decorations[variable.id];
+
+			if (variable.storageClass == spv::StorageClassPushConstant)
+			{
+				// Range covered by the members of the block
+				const Decorations &blockDecorations = module.decorations[typeId];
+				uint32_t begin = blockDecorations.memberOffsets.empty() ? 0 :
+					*std::min_element(blockDecorations.memberOffsets.begin(), blockDecorations.memberOffsets.end());
+				shaderInterface->pushConstantRange.stageFlags = shaderInterface->stage;
+				shaderInterface->pushConstantRange.offset = begin;
+				shaderInterface->pushConstantRange.size = typeSize(module, typeId, 0) - begin;
+				continue;
+			}
+
+			if ((variable.storageClass == spv::StorageClassInput) && (shaderInterface->stage == VK_SHADER_STAGE_VERTEX_BIT))
+			{
+				if (decorations.builtIn || (decorations.location == unset))
+				{
+					continue;
+				}
+				// Matrices use one location per column
+				const Type &type = module.types[typeId];
+				uint32_t columnCount = 1;
+				if (type.op == spv::OpTypeMatrix)
+				{
+					columnCount = type.operands[1];
+					typeId = type.operands[0];
+				}
+				for (uint32_t column = 0; column < columnCount; column++)
+				{
+					VertexInput input;
+					input.location = decorations.location + column;
+					input.size = 0;
+					input.format = vertexFormat(module, typeId, &input.size);
+					shaderInterface->vertexInputs.push_back(input);
+				}
+				continue;
+			}
+
+			if (decorations.binding == unset)
+			{
+				continue;
+			}
+			DescriptorBinding binding;
+			binding.set = decorations.set == unset ? 0 : decorations.set;
+			binding.binding = decorations.binding;
+			binding.stageFlags = shaderInterface->stage;
+			typeId = stripArrays(module, typeId, &binding.descriptorCount);
+			if (descriptorType(module, variable.storageClass, typeId, &binding.descriptorType))
+			{
+				shaderInterface->descriptorBindings.push_back(binding);
+			}
+		}
+
+		std::sort(shaderInterface->descriptorBindings.begin(), shaderInterface->descriptorBindings.end(),
+			[](const DescriptorBinding &a, const DescriptorBinding &b) { return (a.set < b.set) || ((a.set == b.set) && (a.binding < b.binding)); });
+		std::sort(shaderInterface->vertexInputs.begin(), shaderInterface->vertexInputs.end(),
+			[](const VertexInput &a, const VertexInput &b) { return a.location < b.location; });
+
+		return true;
+	}
+
+	uint64_t hashCode(const uint32_t *code, size_t codeSize)
+	{
+		return vkTools::hashBytes(code, codeSize);
+	}
+
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> mergeDescriptorBindings(const std::vector<const ShaderInterface*> &stages)
+	{
+		std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+		uint32_t setCount = 0;
+		for (auto stage : stages)
+		{
+			for (auto& binding : stage->descriptorBindings)
+			{
+				auto it = sets[binding.set].find(binding.binding);
+				if (it != sets[binding.set].end())
+				{
+					it->second.stageFlags |= binding.stageFlags;
+					continue;
+				}
+				VkDescriptorSetLayoutBinding layoutBinding = {};
+				layoutBinding.binding = binding.binding;
+				layoutBinding.descriptorType = binding.descriptorType;
+				layoutBinding.descriptorCount = binding.descriptorCount;
+				layoutBinding.stageFlags = binding.stageFlags;
+				sets[binding.set][binding.binding] = layoutBinding;
+				setCount = std::max(setCount, binding.set + 1);
+			}
+		}
+
+		// Sets that are not used by any stage are left empty
+		std::vector<std::vector<VkDescriptorSetLayoutBinding>> layoutBindings(setCount);
+		for (auto& set : sets)
+		{
+			for (auto& binding : set.second)
+			{
+				layoutBindings[set.first].push_back(binding.second);
+			}
+		}
+		return layoutBindings;
+	}
+
+	bool mergePushConstantRanges(const std::vector<const ShaderInterface*> &stages, VkPushConstantRange *pushConstantRange)
+	{
+		bool found = false;
+		uint32_t end = 0;
+		for (auto stage : stages)
+		{
+			const VkPushConstantRange &range = stage->pushConstantRange;
+			if (range.size == 0)
+			{
+				continue;
+			}
+			if (!found)
+			{
+				*pushConstantRange = range;
+				end = range.offset + range.size;
+				found = true;
+				continue;
+			}
+			pushConstantRange->stageFlags |= range.stageFlags;
+			pushConstantRange->offset = std::min(pushConstantRange->offset, range.offset);
+			end = std::max(end, range.offset + range.size);
+		}
+		if (found)
+		{
+			pushConstantRange->size = end - pushConstantRange->offset;
+		}
+		return found;
+	}
+
+	uint32_t interleavedVertexInput(
+		const ShaderInterface &vertexShader,
+		uint32_t binding,
+		std::vector<VkVertexInputAttributeDescription> *attributeDescriptions)
+	{
+		uint32_t offset = 0;
+		attributeDescriptions->clear();
+		for (auto& input : vertexShader.vertexInputs)
+		{
+			VkVertexInputAttributeDescription attributeDescription;
+			attributeDescription.location = input.location;
+			attributeDescription.binding = binding;
+			attributeDescription.format = input.format;
+			attributeDescription.offset = offset;
+			attributeDescriptions->push_back(attributeDescription);
+			offset += input.size;
+		}
+		return offset;
+	}
+}
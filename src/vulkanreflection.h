@@ -0,0 +1,73 @@
+/*
+* SPIR-V reflection
+*
+* Extracts the resource interface of a SPIR-V module (descriptor bindings,
+* push constant block and vertex inputs) so descriptor set layouts, pipeline
+* layouts and vertex input states can be generated instead of written by hand
+*
+* Note : Dynamic uniform / storage buffers can't be told apart from regular ones
+* in SPIR-V, change the descriptor type of the reflected bindings if needed
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vkReflection
+{
+	struct DescriptorBinding
+	{
+		uint32_t set;
+		uint32_t binding;
+		VkDescriptorType descriptorType;
+		// 0 for runtime sized arrays
+		uint32_t descriptorCount;
+		VkShaderStageFlags stageFlags;
+	};
+
+	struct VertexInput
+	{
+		uint32_t location;
+		VkFormat format;
+		// Size of the attribute in bytes (one location of a matrix is one attribute)
+		uint32_t size;
+	};
+
+	struct ShaderInterface
+	{
+		VkShaderStageFlagBits stage;
+		// Sorted by set and binding
+		std::vector<DescriptorBinding> descriptorBindings;
+		// size is 0 if the module has no push constant block
+		VkPushConstantRange pushConstantRange;
+		// Vertex shader inputs sorted by location, built-ins excluded
+		std::vector<VertexInput> vertexInputs;
+	};
+
+	// Parse a SPIR-V module (codeSize in bytes)
+	// Returns false if the code is not valid SPIR-V
+	bool reflect(const uint32_t *code, size_t codeSize, ShaderInterface *shaderInterface);
+
+	// Hash of a module's code, used to cache reflection results
+	uint64_t hashCode(const uint32_t *code, size_t codeSize);
+
+	// Merge the descriptor bindings of several stages into one list per set
+	// Bindings used by multiple stages get the union of their stage flags
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> mergeDescriptorBindings(const std::vector<const ShaderInterface*> &stages);
+
+	// Merge the push constant ranges of several stages into one range covering all of them
+	// Returns false if no stage uses push constants
+	bool mergePushConstantRanges(const std::vector<const ShaderInterface*> &stages, VkPushConstantRange *pushConstantRange);
+
+	// Vertex attributes for all inputs of a vertex shader interleaved in a single binding
+	// Returns the stride of the binding
+	uint32_t interleavedVertexInput(
+		const ShaderInterface &vertexShader,
+		uint32_t binding,
+		std::vector<VkVertexInputAttributeDescription> *attributeDescriptions);
+}
@@ -0,0 +1,95 @@
+/*
+* Class wrapping a persistently mapped, host visible buffer split into segments
+*
+* Each segment is written by the host for one frame (e.g. one segment per
+* swap chain image) so data still read by the device for a previous frame
+* is never overwritten while being updated for the next one
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+
+class VulkanRingBuffer
+{
+private:
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	uint8_t *mapped = nullptr;
+
+public:
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	// Size of one segment, rounded up to the requested alignment
+	VkDeviceSize segmentSize = 0;
+	uint32_t segmentCount = 0;
+
+	void init(VkPhysicalDevice physicalDevice, VkDevice device)
+	{
+		this->device = device;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	}
+
+	// Create a buffer holding segmentCount segments of at least size bytes each
+	// alignment must be a power of two (e.g. minUniformBufferOffsetAlignment for dynamic uniform buffers)
+	void create(VkBufferUsageFlags usage, VkDeviceSize size, uint32_t segmentCount, VkDeviceSize alignment = 4)
+	{
+		assert(segmentCount > 0);
+		assert((alignment & (alignment - 1)) == 0);
+		this->segmentCount = segmentCount;
+		segmentSize = (size + alignment - 1) & ~(alignment - 1);
+
+		VkResult err;
+		VkMemoryRequirements memReqs;
+		VkMemoryAllocateInfo memAlloc = vkTools::initializers::memoryAllocateInfo();
+		VkBufferCreateInfo bufferCreateInfo = vkTools::initializers::bufferCreateInfo(usage, segmentSize * segmentCount);
+
+		err = vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer);
+		assert(!err);
+		vkGetBufferMemoryRequirements(device, buffer, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		// Coherent so host writes are visible without explicit flushes
+		VkBool32 found = vkTools::getMemoryType(
+			memoryProperties,
+			memReqs.memoryTypeBits,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&memAlloc.memoryTypeIndex);
+		assert(found);
+		err = vkAllocateMemory(device, &memAlloc, nullptr, &memory);
+		assert(!err);
+		err = vkBindBufferMemory(device, buffer, memory, 0);
+		assert(!err);
+		err = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, (void**)&mapped);
+		assert(!err);
+	}
+
+	// Offset of a segment inside the buffer (for binding it)
+	VkDeviceSize offset(uint32_t index)
+	{
+		assert(index < segmentCount);
+		return index * segmentSize;
+	}
+
+	// Host pointer to the start of a segment
+	void *segment(uint32_t index)
+	{
+		return mapped + offset(index);
+	}
+
+	void cleanup()
+	{
+		if (buffer != VK_NULL_HANDLE)
+		{
+			vkUnmapMemory(device, memory);
+			vkDestroyBuffer(device, buffer, nullptr);
+			vkFreeMemory(device, memory, nullptr);
+			buffer = VK_NULL_HANDLE;
+			mapped = nullptr;
+		}
+	}
+};
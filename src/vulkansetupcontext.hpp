@@ -0,0 +1,209 @@
+/*
+* Class batching setup and upload commands into asynchronous submissions
+*
+* Setup commands (layout transitions, buffer copies, ...) are recorded into a
+* shared command buffer that is submitted as one batch with a fence instead of
+* draining the queue with vkQueueWaitIdle
+* Every batch gets a monotonically increasing value (like a timeline semaphore)
+* and completion callbacks that are run by poll() or wait() once its fence is signaled
+*
+* Note : Not thread safe, callbacks are run on the thread calling poll() or wait()
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+
+class VulkanSetupContext
+{
+private:
+	struct Batch
+	{
+		VkCommandBuffer cmdBuffer;
+		VkFence fence;
+		uint64_t value;
+		std::vector<std::function<void()>> callbacks;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue;
+	VkCommandPool cmdPool;
+
+	// Batch currently being recorded
+	VkCommandBuffer recordingCmdBuffer = VK_NULL_HANDLE;
+	std::vector<std::function<void()>> recordingCallbacks;
+	// Submitted batches in submission order
+	std::deque<Batch> pendingBatches;
+	// Command buffers and fences of completed batches, reused by the next ones
+	std::vector<VkCommandBuffer> freeCmdBuffers;
+	std::vector<VkFence> freeFences;
+
+	uint64_t submittedValue = 0;
+	uint64_t completedValue = 0;
+
+	// Run the callbacks of a completed batch and recycle its objects
+	void retire(Batch &batch)
+	{
+		completedValue = batch.value;
+		freeCmdBuffers.push_back(batch.cmdBuffer);
+		VkResult err = vkResetFences(device, 1, &batch.fence);
+		assert(!err);
+		freeFences.push_back(batch.fence);
+		for (auto& callback : batch.callbacks)
+		{
+			callback();
+		}
+	}
+
+public:
+	void init(VkDevice device, VkQueue queue, VkCommandPool cmdPool)
+	{
+		this->device = device;
+		this->queue = queue;
+		this->cmdPool = cmdPool;
+	}
+
+	// Returns the command buffer of the batch being recorded
+	// A new batch is started if there is none
+	VkCommandBuffer commandBuffer()
+	{
+		if (recordingCmdBuffer == VK_NULL_HANDLE)
+		{
+			VkResult err;
+			if (freeCmdBuffers.empty())
+			{
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+					vkTools::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+				err = vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &recordingCmdBuffer);
+				assert(!err);
+			}
+			else
+			{
+				recordingCmdBuffer = freeCmdBuffers.back();
+				freeCmdBuffers.pop_back();
+			}
+
+			// Beginning a command buffer implicitly resets it
+			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
+			cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			err = vkBeginCommandBuffer(recordingCmdBuffer, &cmdBufInfo);
+			assert(!err);
+		}
+		return recordingCmdBuffer;
+	}
+
+	// Add a callback that is run once the batch being recorded has completed on the device
+	void onComplete(std::function<void()> callback)
+	{
+		commandBuffer();
+		recordingCallbacks.push_back(callback);
+	}
+
+	// Submit the batch being recorded without waiting for it
+	// Returns the value that is reached once it has completed
+	uint64_t submit()
+	{
+		if (recordingCmdBuffer == VK_NULL_HANDLE)
+		{
+			return submittedValue;
+		}
+
+		VkResult err = vkEndCommandBuffer(recordingCmdBuffer);
+		assert(!err);
+
+		Batch batch;
+		batch.cmdBuffer = recordingCmdBuffer;
+		batch.value = ++submittedValue;
+		batch.callbacks.swap(recordingCallbacks);
+		if (freeFences.empty())
+		{
+			VkFenceCreateInfo fenceCreateInfo = vkTools::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+			err = vkCreateFence(device, &fenceCreateInfo, nullptr, &batch.fence);
+			assert(!err);
+		}
+		else
+		{
+			batch.fence = freeFences.back();
+			freeFences.pop_back();
+		}
+
+		VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.cmdBuffer;
+		err = vkQueueSubmit(queue, 1, &submitInfo, batch.fence);
+		assert(!err);
+
+		pendingBatches.push_back(batch);
+		recordingCmdBuffer = VK_NULL_HANDLE;
+		return batch.value;
+	}
+
+	// Retire all batches that have completed, without blocking
+	// Returns the value of the last completed batch
+	uint64_t poll()
+	{
+		while (!pendingBatches.empty() && vkGetFenceStatus(device, pendingBatches.front().fence) == VK_SUCCESS)
+		{
+			Batch batch = pendingBatches.front();
+			pendingBatches.pop_front();
+			retire(batch);
+		}
+		return completedValue;
+	}
+
+	// Block until the batch with the given value (and all batches before it) has completed
+	void wait(uint64_t value)
+	{
+		while (!pendingBatches.empty() && pendingBatches.front().value <= value)
+		{
+			Batch batch = pendingBatches.front();
+			pendingBatches.pop_front();
+			VkResult err = vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+			assert(!err);
+			retire(batch);
+		}
+	}
+
+	// Submit the batch being recorded and wait for all batches to complete
+	void waitAll()
+	{
+		wait(submit());
+	}
+
+	uint64_t lastSubmittedValue()
+	{
+		return submittedValue;
+	}
+
+	uint64_t lastCompletedValue()
+	{
+		return completedValue;
+	}
+
+	void cleanup()
+	{
+		if (device == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		waitAll();
+		if (!freeCmdBuffers.empty())
+		{
+			vkFreeCommandBuffers(device, cmdPool, (uint32_t)freeCmdBuffers.size(), freeCmdBuffers.data());
+			freeCmdBuffers.clear();
+		}
+		for (auto& fence : freeFences)
+		{
+			vkDestroyFence(device, fence, nullptr);
+		}
+		freeFences.clear();
+	}
+};
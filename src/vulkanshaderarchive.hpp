@@ -0,0 +1,261 @@
+/*
+* Class reading (and writing) archives of SPIR-V shaders
+*
+* An archive is a single file mapped in memory once, shaders are served
+* in place by name (file name without directory) without further file access
+*
+* Layout (little endian) :
+*   Header
+*   Entry[entryCount], sorted by name hash for binary search
+*   Names (not null terminated)
+*   SPIR-V code of each entry, 4 byte aligned
+*
+* Written by the shaderPacker tool (see the shaders build target)
+*
+* Note : The archive shadows the shader files it was packed from, open() rejects
+* corrupted archives (unsorted index, code not matching its hash) and
+* newerShaderFile() finds the files rebuilt since the archive was written
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "vulkanmappedfile.hpp"
+#include "vulkantools.h"
+
+class VulkanShaderArchive
+{
+public:
+	// "VKSA" in little endian
+	static const uint32_t MAGIC = 0x41534b56;
+	static const uint32_t VERSION = 1;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+	};
+
+	struct Entry
+	{
+		uint64_t nameHash;
+		// Hash of the code, the key of the shader module cache (see vkReflection::hashCode)
+		uint64_t codeHash;
+		uint32_t nameOffset;
+		uint32_t nameSize;
+		uint32_t codeOffset;
+		// In bytes
+		uint32_t codeSize;
+	};
+
+	struct Shader
+	{
+		std::string name;
+		std::vector<uint32_t> code;
+	};
+
+private:
+	VulkanMappedFile file;
+	const Entry *entries = nullptr;
+	uint32_t entryCount = 0;
+	time_t writeTime = 0;
+
+	bool inBounds(uint64_t offset, uint64_t size) const
+	{
+		return offset + size <= file.size();
+	}
+
+	bool validate()
+	{
+		if (!inBounds(0, sizeof(Header)))
+		{
+			return false;
+		}
+		const Header *header = (const Header*)file.data();
+		if ((header->magic != MAGIC) || (header->version != VERSION) ||
+			!inBounds(sizeof(Header), (uint64_t)header->entryCount * sizeof(Entry)))
+		{
+			return false;
+		}
+		const Entry *headerEntries = (const Entry*)(file.data() + sizeof(Header));
+		for (uint32_t i = 0; i < header->entryCount; i++)
+		{
+			const Entry &entry = headerEntries[i];
+			if (!inBounds(entry.nameOffset, entry.nameSize) || !inBounds(entry.codeOffset, entry.codeSize) ||
+				(entry.codeOffset % sizeof(uint32_t) != 0) || (entry.codeSize % sizeof(uint32_t) != 0))
+			{
+				return false;
+			}
+			// find() does a binary search on the index
+			if ((i > 0) && (headerEntries[i - 1].nameHash > entry.nameHash))
+			{
+				return false;
+			}
+			// The code hash is the key of the shader module cache, a wrong one would serve another shader
+			if ((vkTools::hashBytes(file.data() + entry.nameOffset, entry.nameSize) != entry.nameHash) ||
+				(vkTools::hashBytes(file.data() + entry.codeOffset, entry.codeSize) != entry.codeHash))
+			{
+				return false;
+			}
+		}
+		entries = headerEntries;
+		entryCount = header->entryCount;
+		return true;
+	}
+
+public:
+	// Name of a shader in an archive for a file name (the directory is dropped)
+	static std::string shaderName(const std::string &fileName)
+	{
+		size_t separator = fileName.find_last_of("/\\");
+		return separator == std::string::npos ? fileName : fileName.substr(separator + 1);
+	}
+
+	// Map an archive, returns false if it can't be opened or is not a valid archive
+	bool open(const char *fileName)
+	{
+		close();
+		struct stat fileStat;
+		if ((stat(fileName, &fileStat) != 0) || !file.open(fileName) || !validate())
+		{
+			close();
+			return false;
+		}
+		writeTime = fileStat.st_mtime;
+		return true;
+	}
+
+	void close()
+	{
+		file.close();
+		entries = nullptr;
+		entryCount = 0;
+		writeTime = 0;
+	}
+
+	bool isOpen() const
+	{
+		return entries != nullptr;
+	}
+
+	uint32_t size() const
+	{
+		return entryCount;
+	}
+
+	// Returns the first shader of the archive whose file in directory has been modified after the
+	// archive was written (e.g. rebuilt without repacking), or an empty string if there is none
+	// Shaders without a file in directory are not checked
+	std::string newerShaderFile(const std::string &directory) const
+	{
+		for (uint32_t i = 0; i < entryCount; i++)
+		{
+			std::string name(file.data() + entries[i].nameOffset, entries[i].nameSize);
+			struct stat fileStat;
+			if ((stat((directory + name).c_str(), &fileStat) == 0) && (fileStat.st_mtime > writeTime))
+			{
+				return name;
+			}
+		}
+		return std::string();
+	}
+
+	// Returns the code of a shader (pointing into the mapping) or null if the archive does not contain it
+	// codeSize receives the size of the code in bytes, codeHash (if not null) the hash of the code
+	const uint32_t *find(const std::string &name, size_t *codeSize, uint64_t *codeHash = nullptr) const
+	{
+		uint64_t nameHash = vkTools::hashBytes(name.data(), name.size());
+		const Entry *last = entries + entryCount;
+		const Entry *entry = std::lower_bound(entries, last, nameHash,
+			[](const Entry &entry, uint64_t nameHash) { return entry.nameHash < nameHash; });
+		for (; (entry != last) && (entry->nameHash == nameHash); entry++)
+		{
+			if ((entry->nameSize == name.size()) && (memcmp(file.data() + entry->nameOffset, name.data(), name.size()) == 0))
+			{
+				*codeSize = entry->codeSize;
+				if (codeHash != nullptr)
+				{
+					*codeHash = entry->codeHash;
+				}
+				return (const uint32_t*)(file.data() + entry->codeOffset);
+			}
+		}
+		return nullptr;
+	}
+
+	// Same as find() with the hash of the name, ignoring the (unlikely) collisions
+	const uint32_t *find(uint64_t nameHash, size_t *codeSize) const
+	{
+		const Entry *last = entries + entryCount;
+		const Entry *entry = std::lower_bound(entries, last, nameHash,
+			[](const Entry &entry, uint64_t nameHash) { return entry.nameHash < nameHash; });
+		if ((entry == last) || (entry->nameHash != nameHash))
+		{
+			return nullptr;
+		}
+		*codeSize = entry->codeSize;
+		return (const uint32_t*)(file.data() + entry->codeOffset);
+	}
+
+	// Write an archive containing the given shaders
+	static bool write(const char *fileName, const std::vector<Shader> &shaders)
+	{
+		std::vector<Entry> archiveEntries(shaders.size());
+		uint32_t offset = (uint32_t)(sizeof(Header) + shaders.size() * sizeof(Entry));
+		for (size_t i = 0; i < shaders.size(); i++)
+		{
+			Entry &entry = archiveEntries[i];
+			entry.nameHash = vkTools::hashBytes(shaders[i].name.data(), shaders[i].name.size());
+			entry.nameOffset = offset;
+			entry.nameSize = (uint32_t)shaders[i].name.size();
+			offset += entry.nameSize;
+		}
+		offset = (offset + 3) & ~3u;
+		for (size_t i = 0; i < shaders.size(); i++)
+		{
+			Entry &entry = archiveEntries[i];
+			entry.codeSize = (uint32_t)(shaders[i].code.size() * sizeof(uint32_t));
+			entry.codeHash = vkTools::hashBytes(shaders[i].code.data(), entry.codeSize);
+			entry.codeOffset = offset;
+			offset += entry.codeSize;
+		}
+
+		// Names and code are written in the original order, only the index is sorted
+		std::vector<Entry> index = archiveEntries;
+		std::stable_sort(index.begin(), index.end(), [](const Entry &a, const Entry &b) { return a.nameHash < b.nameHash; });
+
+		std::ofstream stream(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!stream.is_open())
+		{
+			return false;
+		}
+		Header header = { MAGIC, VERSION, (uint32_t)shaders.size(), 0 };
+		stream.write((const char*)&header, sizeof(header));
+		stream.write((const char*)index.data(), index.size() * sizeof(Entry));
+		uint32_t position = (uint32_t)(sizeof(Header) + index.size() * sizeof(Entry));
+		for (auto& shader : shaders)
+		{
+			stream.write(shader.name.data(), shader.name.size());
+			position += (uint32_t)shader.name.size();
+		}
+		const char padding[3] = {};
+		stream.write(padding, ((position + 3) & ~3u) - position);
+		for (auto& shader : shaders)
+		{
+			stream.write((const char*)shader.code.data(), shader.code.size() * sizeof(uint32_t));
+		}
+		return stream.good();
+	}
+};
@@ -0,0 +1,182 @@
+/*
+* Class sharing shader modules by the content of their SPIR-V code
+*
+* Modules are looked up by a hash of their code, so loading the same shader
+* for several pipelines creates a single module
+* Modules are reference counted and destroyed as soon as the last reference
+* is released (e.g. once the pipelines using them have been compiled)
+*
+* Note : Modules are identified by the hash and size of their code, a
+* collision of the 64 bit hash between modules of the same size is ignored
+* Not thread safe, references must be acquired and released from one thread
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <string>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+#include "vulkantools.h"
+#include "vulkanmappedfile.hpp"
+#include "vulkanreflection.h"
+
+class VulkanShaderModuleCache
+{
+private:
+	struct Entry
+	{
+		uint64_t hash;
+		size_t codeSize;
+		uint32_t refCount;
+		// File the code was last loaded from, empty if it was not loaded from a file
+		std::string fileName;
+	};
+
+	VkDevice device;
+	// Live modules by handle
+	std::unordered_map<VkShaderModule, Entry> entries;
+	// Live modules by hash of their code
+	std::unordered_multimap<uint64_t, VkShaderModule> modulesByHash;
+
+public:
+	struct Stats
+	{
+		// Acquisitions served by an existing module
+		uint32_t hits = 0;
+		// Modules created
+		uint32_t misses = 0;
+		// Modules destroyed after their last reference was released
+		uint32_t destroyed = 0;
+	} stats;
+
+	void init(VkDevice device)
+	{
+		this->device = device;
+	}
+
+	// Returns a reference to the module for the given code (codeSize in bytes), creating it if needed
+	// fileName records the file the code comes from if not null
+	// Each reference must be given back with release()
+	VkShaderModule acquire(const uint32_t *code, size_t codeSize, const char *fileName = nullptr)
+	{
+		return acquire(code, codeSize, vkReflection::hashCode(code, codeSize), fileName);
+	}
+
+	// Same as acquire() with the hash of the code already known (e.g. stored in a shader archive)
+	VkShaderModule acquire(const uint32_t *code, size_t codeSize, uint64_t hash, const char *fileName)
+	{
+		assert(hash == vkReflection::hashCode(code, codeSize));
+		auto range = modulesByHash.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			Entry &entry = entries[it->second];
+			if (entry.codeSize == codeSize)
+			{
+				entry.refCount++;
+				if (fileName != nullptr)
+				{
+					entry.fileName = fileName;
+				}
+				stats.hits++;
+				return it->second;
+			}
+		}
+
+		stats.misses++;
+		VkShaderModule module = vkTools::createShaderModule(code, codeSize, device);
+		entries[module] = { hash, codeSize, 1, fileName != nullptr ? fileName : "" };
+		modulesByHash.insert(std::make_pair(hash, module));
+		return module;
+	}
+
+	// Same as acquire() for the code of a SPIR-V file, read in place from a memory mapping
+	VkShaderModule acquireFile(const char *fileName)
+	{
+		VulkanMappedFile file;
+		if (!file.open(fileName))
+		{
+			vkTools::exitFatal(std::string("Could not open shader file ") + fileName, "Fatal error");
+		}
+		if (!file.isSpirv())
+		{
+			vkTools::exitFatal(std::string("Shader file ") + fileName + " is not valid SPIR-V", "Fatal error");
+		}
+		return acquire((const uint32_t*)file.data(), file.size(), fileName);
+	}
+
+	// Add a reference to a module of the cache
+	void addRef(VkShaderModule module)
+	{
+		auto it = entries.find(module);
+		assert(it != entries.end());
+		it->second.refCount++;
+	}
+
+	// Give back a reference, the module is destroyed with its last reference
+	void release(VkShaderModule module)
+	{
+		auto it = entries.find(module);
+		assert(it != entries.end());
+		assert(it->second.refCount > 0);
+		if (--it->second.refCount > 0)
+		{
+			return;
+		}
+		auto range = modulesByHash.equal_range(it->second.hash);
+		for (auto hashIt = range.first; hashIt != range.second; ++hashIt)
+		{
+			if (hashIt->second == module)
+			{
+				modulesByHash.erase(hashIt);
+				break;
+			}
+		}
+		entries.erase(it);
+		vkDestroyShaderModule(device, module, nullptr);
+		stats.destroyed++;
+	}
+
+	// Returns true if the module belongs to the cache
+	bool contains(VkShaderModule module)
+	{
+		return entries.find(module) != entries.end();
+	}
+
+	// Hash of the code of a module of the cache
+	// Unlike the handle it stays the same when the module is destroyed and created again
+	uint64_t contentHash(VkShaderModule module)
+	{
+		auto it = entries.find(module);
+		assert(it != entries.end());
+		return it->second.hash;
+	}
+
+	// File the code of a module of the cache was last loaded from (empty if none)
+	const std::string &fileName(VkShaderModule module)
+	{
+		auto it = entries.find(module);
+		assert(it != entries.end());
+		return it->second.fileName;
+	}
+
+	// Number of live modules
+	uint32_t size()
+	{
+		return (uint32_t)entries.size();
+	}
+
+	// Destroy the remaining modules, whatever their reference count
+	void cleanup()
+	{
+		for (auto& entry : entries)
+		{
+			vkDestroyShaderModule(device, entry.first, nullptr);
+		}
+		entries.clear();
+		modulesByHash.clear();
+	}
+};
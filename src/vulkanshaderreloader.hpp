@@ -0,0 +1,341 @@
+/*
+* Class reloading SPIR-V shaders when their files change and rebuilding the pipelines using them
+*
+* The directories of the tracked pipelines' shader files are watched on a background
+* thread (inotify on Linux, change notifications on Windows), which also reads the
+* new code of the changed files
+* update() is called at a frame boundary : it creates the new modules, requests the
+* pipelines depending on them from the registry (compiled on its worker threads)
+* and swaps the pipelines that are ready into their targets
+*
+* Note : Watches the .spv files, rebuild them from the GLSL sources (e.g. with the
+* shaders build target) to see the changes
+* Replaced pipelines stay in the registry until it is cleaned up, so command
+* buffers still referencing them remain valid
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <sys/stat.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <vulkan/vulkan.h>
+#include "vulkanmappedfile.hpp"
+#include "vulkanpipelinedescription.hpp"
+#include "vulkanpipelineregistry.hpp"
+#include "vulkanshadermodulecache.hpp"
+#include "vulkancpuprofiler.hpp"
+
+class VulkanShaderReloader
+{
+private:
+	struct TrackedPipeline
+	{
+		// Holds a reference to its shader modules so it can be rebuilt at any time
+		VulkanPipelineDescription description;
+		// File of each stage of the description, empty if the stage can't be reloaded
+		std::vector<std::string> stageFiles;
+		VkPipeline *target;
+		// Rebuilt pipeline waiting to be swapped in
+		std::shared_future<VkPipeline> pending;
+	};
+
+	VulkanShaderModuleCache *shaderModuleCache = nullptr;
+	VulkanPipelineRegistry *pipelineRegistry = nullptr;
+	std::vector<TrackedPipeline> trackedPipelines;
+
+	std::thread watcher;
+	std::atomic<bool> stopping{ false };
+	// Watched files by directory, fixed once the watcher is started
+	std::map<std::string, std::set<std::string>> watchedFiles;
+
+	// Code of the files changed since the last update, filled by the watcher
+	std::mutex mutex;
+	std::map<std::string, std::vector<uint32_t>> changedFiles;
+
+	void releaseShaderModule(const VulkanPipelineDescription::Stage &stage)
+	{
+		if (shaderModuleCache->contains(stage.module))
+		{
+			shaderModuleCache->release(stage.module);
+		}
+	}
+
+	void releaseShaderModules(const TrackedPipeline &pipeline)
+	{
+		for (auto& stage : pipeline.description.stages)
+		{
+			releaseShaderModule(stage);
+		}
+	}
+
+	static std::string directoryOf(const std::string &fileName)
+	{
+		size_t separator = fileName.find_last_of("/\\");
+		return separator == std::string::npos ? "." : fileName.substr(0, separator);
+	}
+
+	// Called on the watcher thread, keeps the last valid version of each changed file
+	void fileChanged(const std::string &fileName)
+	{
+		VulkanMappedFile file;
+		if (!file.open(fileName.c_str()) || !file.isSpirv())
+		{
+			// Still being written or not valid, a later event will pick up the final version
+			return;
+		}
+		const uint32_t *code = (const uint32_t*)file.data();
+		std::vector<uint32_t> codeCopy(code, code + file.size() / sizeof(uint32_t));
+		std::lock_guard<std::mutex> lock(mutex);
+		changedFiles[fileName].swap(codeCopy);
+	}
+
+#ifdef _WIN32
+	void watch()
+	{
+		CPU_PROFILE_THREAD("shader watcher");
+		std::vector<HANDLE> notifications;
+		std::vector<std::string> directories;
+		std::map<std::string, time_t> lastWriteTimes;
+		for (auto& directory : watchedFiles)
+		{
+			HANDLE notification = FindFirstChangeNotificationA(directory.first.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+			if (notification == INVALID_HANDLE_VALUE)
+			{
+				std::cout << "Could not watch shader directory " << directory.first << "\n";
+				continue;
+			}
+			notifications.push_back(notification);
+			directories.push_back(directory.first);
+			for (auto& fileName : directory.second)
+			{
+				struct stat fileStat;
+				lastWriteTimes[fileName] = stat(fileName.c_str(), &fileStat) == 0 ? fileStat.st_mtime : 0;
+			}
+		}
+
+		while (!stopping && !notifications.empty())
+		{
+			DWORD result = WaitForMultipleObjects((DWORD)notifications.size(), notifications.data(), FALSE, 100);
+			if (result >= WAIT_OBJECT_0 + notifications.size())
+			{
+				continue;
+			}
+			uint32_t index = result - WAIT_OBJECT_0;
+			// Notifications don't tell which file changed, compare the modification times
+			for (auto& fileName : watchedFiles[directories[index]])
+			{
+				struct stat fileStat;
+				if ((stat(fileName.c_str(), &fileStat) == 0) && (fileStat.st_mtime != lastWriteTimes[fileName]))
+				{
+					lastWriteTimes[fileName] = fileStat.st_mtime;
+					fileChanged(fileName);
+				}
+			}
+			FindNextChangeNotification(notifications[index]);
+		}
+
+		for (auto& notification : notifications)
+		{
+			FindCloseChangeNotification(notification);
+		}
+	}
+#else
+	void watch()
+	{
+		CPU_PROFILE_THREAD("shader watcher");
+		int fd = inotify_init1(IN_NONBLOCK);
+		if (fd < 0)
+		{
+			std::cout << "Could not initialize inotify, shader hot reload disabled\n";
+			return;
+		}
+		std::map<int, std::string> directories;
+		for (auto& directory : watchedFiles)
+		{
+			// Files are either rewritten in place or replaced by a rename
+			int wd = inotify_add_watch(fd, directory.first.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (wd < 0)
+			{
+				std::cout << "Could not watch shader directory " << directory.first << "\n";
+				continue;
+			}
+			directories[wd] = directory.first;
+		}
+
+		alignas(struct inotify_event) char buffer[4096];
+		while (!stopping)
+		{
+			pollfd pfd = { fd, POLLIN, 0 };
+			if (poll(&pfd, 1, 100) <= 0)
+			{
+				continue;
+			}
+			ssize_t length = read(fd, buffer, sizeof(buffer));
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const struct inotify_event *event = (const struct inotify_event*)(buffer + offset);
+				offset += sizeof(struct inotify_event) + event->len;
+				if (event->len == 0)
+				{
+					continue;
+				}
+				const std::string &directory = directories[event->wd];
+				std::string fileName = directory + "/" + event->name;
+				if (watchedFiles[directory].count(fileName) > 0)
+				{
+					fileChanged(fileName);
+				}
+			}
+		}
+
+		close(fd);
+	}
+#endif
+
+public:
+	void init(VulkanShaderModuleCache *shaderModuleCache, VulkanPipelineRegistry *pipelineRegistry)
+	{
+		this->shaderModuleCache = shaderModuleCache;
+		this->pipelineRegistry = pipelineRegistry;
+	}
+
+	// Rebuild the pipeline of a create info and store it in target when one of its shader files changes
+	// Stages whose module was not loaded from a file (through the module cache) are not reloaded
+	// Must be called before start()
+	void track(const VkGraphicsPipelineCreateInfo &pipelineCreateInfo, VkPipeline *target)
+	{
+		assert(!watcher.joinable());
+		TrackedPipeline pipeline = { VulkanPipelineDescription(pipelineCreateInfo), {}, target, {} };
+		bool reloadable = false;
+		for (auto& stage : pipeline.description.stages)
+		{
+			std::string fileName;
+			if (shaderModuleCache->contains(stage.module))
+			{
+				shaderModuleCache->addRef(stage.module);
+				fileName = shaderModuleCache->fileName(stage.module);
+			}
+			if (!fileName.empty())
+			{
+				watchedFiles[directoryOf(fileName)].insert(fileName);
+				reloadable = true;
+			}
+			pipeline.stageFiles.push_back(fileName);
+		}
+		if (!reloadable)
+		{
+			releaseShaderModules(pipeline);
+			return;
+		}
+		trackedPipelines.push_back(pipeline);
+	}
+
+	// Start watching the shader files of the tracked pipelines
+	void start()
+	{
+		stopping = false;
+		watcher = std::thread(&VulkanShaderReloader::watch, this);
+	}
+
+	// Create the modules of the changed files, request the pipelines using them
+	// and swap in the rebuilt pipelines that are ready
+	// Call at a frame boundary, when the targets can be changed
+	// Returns true if at least one target has been changed
+	bool update()
+	{
+		std::map<std::string, std::vector<uint32_t>> changed;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			changed.swap(changedFiles);
+		}
+
+		for (auto& file : changed)
+		{
+			VkShaderModule module = shaderModuleCache->acquire(file.second.data(), file.second.size() * sizeof(uint32_t));
+			uint32_t rebuildCount = 0;
+			for (auto& pipeline : trackedPipelines)
+			{
+				bool uses = false;
+				for (size_t i = 0; i < pipeline.stageFiles.size(); i++)
+				{
+					if (pipeline.stageFiles[i] == file.first)
+					{
+						shaderModuleCache->addRef(module);
+						releaseShaderModule(pipeline.description.stages[i]);
+						pipeline.description.stages[i].module = module;
+						uses = true;
+					}
+				}
+				if (uses)
+				{
+					// Replaces a rebuild of older code that is still compiling
+					pipeline.pending = pipelineRegistry->acquire(pipeline.description.createInfo(), true);
+					rebuildCount++;
+				}
+			}
+			// The tracked pipelines hold their own references
+			shaderModuleCache->release(module);
+			std::cout << "Reloaded " << file.first << ", rebuilding " << rebuildCount << " pipelines\n";
+		}
+
+		bool swapped = false;
+		for (auto& pipeline : trackedPipelines)
+		{
+			if (VulkanPipelineCompiler::isReady(pipeline.pending))
+			{
+				VkPipeline rebuilt = pipeline.pending.get();
+				pipeline.pending = std::shared_future<VkPipeline>();
+				if (rebuilt == VK_NULL_HANDLE)
+				{
+					// Keep rendering with the previous pipeline until the shader is fixed
+					std::cout << "Could not rebuild a pipeline, keeping the previous one\n";
+					continue;
+				}
+				*pipeline.target = rebuilt;
+				swapped = true;
+			}
+		}
+		if (swapped)
+		{
+			pipelineRegistry->releaseShaderModules();
+		}
+		return swapped;
+	}
+
+	// Stop watching and give back the module references of the tracked pipelines
+	void cleanup()
+	{
+		stopping = true;
+		if (watcher.joinable())
+		{
+			watcher.join();
+		}
+		for (auto& pipeline : trackedPipelines)
+		{
+			releaseShaderModules(pipeline);
+		}
+		trackedPipelines.clear();
+		watchedFiles.clear();
+		changedFiles.clear();
+	}
+};
@@ -0,0 +1,153 @@
+/*
+* Class mapping named specialization constants to constant IDs and values
+*
+* One SPIR-V module can be turned into several shader variants by attaching
+* different constant values to its pipeline shader stage, the driver then
+* constant-folds the branches depending on them when compiling the pipeline
+* Constants are declared with the constant_id used in the shader, e.g.
+*	layout (constant_id = 0) const bool GRAYSCALE = false;
+* and set by name, all values are stored as 32 bit scalars (bool as VkBool32)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+class VulkanSpecializationConstants
+{
+private:
+	enum Type { TYPE_BOOL, TYPE_INT, TYPE_FLOAT };
+
+	std::vector<std::string> names;
+	std::vector<Type> types;
+	std::vector<VkSpecializationMapEntry> entries;
+	// One 32 bit value per constant
+	std::vector<uint32_t> data;
+	VkSpecializationInfo specializationInfo;
+
+	uint32_t index(const std::string &name) const
+	{
+		for (uint32_t i = 0; i < names.size(); i++)
+		{
+			if (names[i] == name)
+			{
+				return i;
+			}
+		}
+		assert(!"Undeclared specialization constant");
+		return 0;
+	}
+
+	void add(const std::string &name, uint32_t constantId, Type type, uint32_t value)
+	{
+		VkSpecializationMapEntry entry;
+		entry.constantID = constantId;
+		entry.offset = (uint32_t)(data.size() * sizeof(uint32_t));
+		entry.size = sizeof(uint32_t);
+		names.push_back(name);
+		types.push_back(type);
+		entries.push_back(entry);
+		data.push_back(value);
+	}
+
+public:
+	// Declare a constant with the constant_id used in the shader and its value for this variant
+	void declare(const std::string &name, uint32_t constantId, bool value)
+	{
+		add(name, constantId, TYPE_BOOL, value ? VK_TRUE : VK_FALSE);
+	}
+	void declare(const std::string &name, uint32_t constantId, int32_t value)
+	{
+		add(name, constantId, TYPE_INT, (uint32_t)value);
+	}
+	void declare(const std::string &name, uint32_t constantId, float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		add(name, constantId, TYPE_FLOAT, bits);
+	}
+
+	// Change the value of a declared constant
+	void set(const std::string &name, bool value)
+	{
+		data[index(name)] = value ? VK_TRUE : VK_FALSE;
+	}
+	void set(const std::string &name, int32_t value)
+	{
+		data[index(name)] = (uint32_t)value;
+	}
+	void set(const std::string &name, float value)
+	{
+		memcpy(&data[index(name)], &value, sizeof(value));
+	}
+
+	// Returns a copy of a shader stage using the constant values of this object
+	// The stage points into this object, which must stay alive (and unchanged)
+	// until the pipeline has been created or acquired from a pipeline registry
+	VkPipelineShaderStageCreateInfo apply(const VkPipelineShaderStageCreateInfo &shaderStage)
+	{
+		specializationInfo.mapEntryCount = (uint32_t)entries.size();
+		specializationInfo.pMapEntries = entries.data();
+		specializationInfo.dataSize = data.size() * sizeof(uint32_t);
+		specializationInfo.pData = data.data();
+
+		VkPipelineShaderStageCreateInfo specializedStage = shaderStage;
+		specializedStage.pSpecializationInfo = entries.empty() ? nullptr : &specializationInfo;
+		return specializedStage;
+	}
+
+	// Generate every combination of the given boolean constants (2^n variants)
+	// Other constants keep the values of this object
+	std::vector<VulkanSpecializationConstants> permutations(const std::vector<std::string> &booleanNames) const
+	{
+		assert(booleanNames.size() < 32);
+		std::vector<VulkanSpecializationConstants> variants;
+		for (uint32_t mask = 0; mask < (1u << booleanNames.size()); mask++)
+		{
+			VulkanSpecializationConstants variant = *this;
+			for (uint32_t i = 0; i < booleanNames.size(); i++)
+			{
+				variant.set(booleanNames[i], (mask & (1u << i)) != 0);
+			}
+			variants.push_back(variant);
+		}
+		return variants;
+	}
+
+	// Human readable list of the constant values, e.g. for benchmark output
+	std::string toString() const
+	{
+		std::string result;
+		for (uint32_t i = 0; i < names.size(); i++)
+		{
+			if (i > 0)
+			{
+				result += " ";
+			}
+			result += names[i] + "=";
+			switch (types[i])
+			{
+			case TYPE_BOOL:
+				result += data[i] ? "true" : "false";
+				break;
+			case TYPE_INT:
+				result += std::to_string((int32_t)data[i]);
+				break;
+			case TYPE_FLOAT:
+				float value;
+				memcpy(&value, &data[i], sizeof(value));
+				result += std::to_string(value);
+				break;
+			}
+		}
+		return result;
+	}
+};
@@ -0,0 +1,601 @@
+/*
+* SPIR-V size optimizer
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanspirvoptimizer.h"
+
+#include <sstream>
+
+#include <vulkan/spirv.hpp>
+
+namespace vkSpirvOptimizer
+{
+	namespace
+	{
+		// Instructions added after SPIR-V 1.0, not in the bundled header
+		const uint32_t opModuleProcessed = 330;
+		const uint32_t opExecutionModeId = 331;
+		const uint32_t opDecorateId = 332;
+		const uint32_t opCopyLogical = 400;
+		const uint32_t opDecorateString = 5632;
+		const uint32_t opMemberDecorateString = 5633;
+
+		// Operands of an instruction after its result type and result IDs
+		// 'i' : ID, 'l' : literal word, 's' : literal string
+		// A trailing '*' repeats the previous kind until the end of the instruction
+		struct Layout
+		{
+			bool resultType;
+			bool result;
+			const char *operands;
+		};
+
+		bool operandLayout(uint32_t opcode, Layout *layout)
+		{
+			switch (opcode)
+			{
+			case spv::OpNop: *layout = { false, false, "" }; return true;
+			case spv::OpUndef: *layout = { true, true, "" }; return true;
+			case spv::OpSourceContinued: *layout = { false, false, "s" }; return true;
+			case spv::OpSource: *layout = { false, false, "llis" }; return true;
+			case spv::OpSourceExtension: *layout = { false, false, "s" }; return true;
+			case spv::OpName: *layout = { false, false, "is" }; return true;
+			case spv::OpMemberName: *layout = { false, false, "ils" }; return true;
+			case spv::OpString: *layout = { false, true, "s" }; return true;
+			case spv::OpLine: *layout = { false, false, "ill" }; return true;
+			case spv::OpNoLine: *layout = { false, false, "" }; return true;
+			case opModuleProcessed: *layout = { false, false, "s" }; return true;
+			case spv::OpExtension: *layout = { false, false, "s" }; return true;
+			case spv::OpExtInstImport: *layout = { false, true, "s" }; return true;
+			case spv::OpExtInst: *layout = { true, true, "ili*" }; return true;
+			case spv::OpMemoryModel: *layout = { false, false, "ll" }; return true;
+			case spv::OpEntryPoint: *layout = { false, false, "lisi*" }; return true;
+			case spv::OpExecutionMode: *layout = { false, false, "il*" }; return true;
+			case opExecutionModeId: *layout = { false, false, "ili*" }; return true;
+			case spv::OpCapability: *layout = { false, false, "l" }; return true;
+
+			case spv::OpTypeVoid:
+			case spv::OpTypeBool:
+			case spv::OpTypeSampler:
+			case spv::OpTypeEvent:
+			case spv::OpTypeDeviceEvent:
+			case spv::OpTypeReserveId:
+			case spv::OpTypeQueue:
+				*layout = { false, true, "" }; return true;
+			case spv::OpTypeInt: *layout = { false, true, "ll" }; return true;
+			case spv::OpTypeFloat: *layout = { false, true, "l" }; return true;
+			case spv::OpTypeVector: *layout = { false, true, "il" }; return true;
+			case spv::OpTypeMatrix: *layout = { false, true, "il" }; return true;
+			case spv::OpTypeImage: *layout = { false, true, "il*" }; return true;
+			case spv::OpTypeSampledImage: *layout = { false, true, "i" }; return true;
+			case spv::OpTypeArray: *layout = { false, true, "ii" }; return true;
+			case spv::OpTypeRuntimeArray: *layout = { false, true, "i" }; return true;
+			case spv::OpTypeStruct: *layout = { false, true, "i*" }; return true;
+			case spv::OpTypeOpaque: *layout = { false, true, "s" }; return true;
+			case spv::OpTypePointer: *layout = { false, true, "li" }; return true;
+			case spv::OpTypeFunction: *layout = { false, true, "i*" }; return true;
+			case spv::OpTypePipe: *layout = { false, true, "l" }; return true;
+			case spv::OpTypeForwardPointer: *layout = { false, false, "il" }; return true;
+
+			case spv::OpConstantTrue:
+			case spv::OpConstantFalse:
+			case spv::OpConstantNull:
+			case spv::OpSpecConstantTrue:
+			case spv::OpSpecConstantFalse:
+				*layout = { true, true, "" }; return true;
+			case spv::OpConstant:
+			case spv::OpSpecConstant:
+				*layout = { true, true, "l*" }; return true;
+			case spv::OpConstantComposite:
+			case spv::OpSpecConstantComposite:
+				*layout = { true, true, "i*" }; return true;
+			case spv::OpConstantSampler: *layout = { true, true, "lll" }; return true;
+
+			case spv::OpFunction: *layout = { true, true, "li" }; return true;
+			case spv::OpFunctionParameter: *layout = { true, true, "" }; return true;
+			case spv::OpFunctionEnd: *layout = { false, false, "" }; return true;
+			case spv::OpFunctionCall: *layout = { true, true, "i*" }; return true;
+
+			case spv::OpVariable: *layout = { true, true, "li" }; return true;
+			case spv::OpImageTexelPointer: *layout = { true, true, "iii" }; return true;
+			case spv::OpLoad: *layout = { true, true, "il*" }; return true;
+			case spv::OpStore: *layout = { false, false, "iil*" }; return true;
+			case spv::OpCopyMemory: *layout = { false, false, "iil*" }; return true;
+			case spv::OpCopyMemorySized: *layout = { false, false, "iiil*" }; return true;
+			case spv::OpAccessChain:
+			case spv::OpInBoundsAccessChain:
+			case spv::OpPtrAccessChain:
+			case spv::OpInBoundsPtrAccessChain:
+				*layout = { true, true, "i*" }; return true;
+			case spv::OpArrayLength: *layout = { true, true, "il" }; return true;
+			case spv::OpGenericPtrMemSemantics: *layout = { true, true, "i" }; return true;
+
+			case spv::OpDecorate: *layout = { false, false, "il*" }; return true;
+			case spv::OpMemberDecorate: *layout = { false, false, "ill*" }; return true;
+			case opDecorateId: *layout = { false, false, "ili*" }; return true;
+			case opDecorateString: *layout = { false, false, "ils*" }; return true;
+			case opMemberDecorateString: *layout = { false, false, "ills*" }; return true;
+
+			case spv::OpVectorExtractDynamic: *layout = { true, true, "ii" }; return true;
+			case spv::OpVectorInsertDynamic: *layout = { true, true, "iii" }; return true;
+			case spv::OpVectorShuffle: *layout = { true, true, "iil*" }; return true;
+			case spv::OpCompositeConstruct: *layout = { true, true, "i*" }; return true;
+			case spv::OpCompositeExtract: *layout = { true, true, "il*" }; return true;
+			case spv::OpCompositeInsert: *layout = { true, true, "iil*" }; return true;
+			case spv::OpCopyObject:
+			case spv::OpTranspose:
+			case opCopyLogical:
+				*layout = { true, true, "i" }; return true;
+
+			case spv::OpSampledImage: *layout = { true, true, "ii" }; return true;
+			case spv::OpImageSampleImplicitLod:
+			case spv::OpImageSampleExplicitLod:
+			case spv::OpImageSampleProjImplicitLod:
+			case spv::OpImageSampleProjExplicitLod:
+			case spv::OpImageFetch:
+			case spv::OpImageRead:
+				*layout = { true, true, "iili*" }; return true;
+			case spv::OpImageSampleDrefImplicitLod:
+			case spv::OpImageSampleDrefExplicitLod:
+			case spv::OpImageSampleProjDrefImplicitLod:
+			case spv::OpImageSampleProjDrefExplicitLod:
+			case spv::OpImageGather:
+			case spv::OpImageDrefGather:
+				*layout = { true, true, "iiili*" }; return true;
+			case spv::OpImageWrite: *layout = { false, false, "iiili*" }; return true;
+			case spv::OpImage:
+			case spv::OpImageQueryFormat:
+			case spv::OpImageQueryOrder:
+			case spv::OpImageQuerySize:
+			case spv::OpImageQueryLevels:
+			case spv::OpImageQuerySamples:
+				*layout = { true, true, "i" }; return true;
+			case spv::OpImageQuerySizeLod:
+			case spv::OpImageQueryLod:
+				*layout = { true, true, "ii" }; return true;
+
+			case spv::OpGenericCastToPtrExplicit: *layout = { true, true, "il" }; return true;
+
+			case spv::OpEmitVertex:
+			case spv::OpEndPrimitive:
+				*layout = { false, false, "" }; return true;
+			case spv::OpEmitStreamVertex:
+			case spv::OpEndStreamPrimitive:
+				*layout = { false, false, "i" }; return true;
+			case spv::OpControlBarrier: *layout = { false, false, "iii" }; return true;
+			case spv::OpMemoryBarrier: *layout = { false, false, "ii" }; return true;
+			case spv::OpAtomicStore: *layout = { false, false, "iiii" }; return true;
+
+			case spv::OpPhi: *layout = { true, true, "i*" }; return true;
+			case spv::OpLoopMerge: *layout = { false, false, "iil*" }; return true;
+			case spv::OpSelectionMerge: *layout = { false, false, "il" }; return true;
+			case spv::OpLabel: *layout = { false, true, "" }; return true;
+			case spv::OpBranch: *layout = { false, false, "i" }; return true;
+			case spv::OpBranchConditional: *layout = { false, false, "iiil*" }; return true;
+			// Selector and default, the (literal, label) pairs are decoded separately
+			case spv::OpSwitch: *layout = { false, false, "ii" }; return true;
+			case spv::OpKill:
+			case spv::OpReturn:
+			case spv::OpUnreachable:
+				*layout = { false, false, "" }; return true;
+			case spv::OpReturnValue: *layout = { false, false, "i" }; return true;
+			case spv::OpLifetimeStart:
+			case spv::OpLifetimeStop:
+				*layout = { false, false, "il" }; return true;
+			}
+
+			// Conversions, arithmetic, relational, logical, bit, derivative and atomic
+			// instructions only take IDs
+			if (((opcode >= spv::OpConvertFToU) && (opcode <= spv::OpBitcast)) ||
+				((opcode >= spv::OpSNegate) && (opcode <= spv::OpSMulExtended)) ||
+				((opcode >= spv::OpAny) && (opcode <= spv::OpFUnordGreaterThanEqual)) ||
+				((opcode >= spv::OpShiftRightLogical) && (opcode <= spv::OpBitCount)) ||
+				((opcode >= spv::OpDPdx) && (opcode <= spv::OpFwidthCoarse)) ||
+				((opcode >= spv::OpAtomicLoad) && (opcode <= spv::OpAtomicXor)))
+			{
+				*layout = { true, true, "i*" };
+				return true;
+			}
+
+			// Not supported (decoration groups, OpSpecConstantOp, extensions, ...)
+			return false;
+		}
+
+		bool isDebug(uint32_t opcode)
+		{
+			switch (opcode)
+			{
+			case spv::OpSourceContinued:
+			case spv::OpSource:
+			case spv::OpSourceExtension:
+			case spv::OpName:
+			case spv::OpMemberName:
+			case spv::OpLine:
+			case spv::OpNoLine:
+			case opModuleProcessed:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool isDecoration(uint32_t opcode)
+		{
+			switch (opcode)
+			{
+			case spv::OpDecorate:
+			case spv::OpMemberDecorate:
+			case opDecorateId:
+			case opDecorateString:
+			case opMemberDecorateString:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		struct Instruction
+		{
+			size_t offset;
+			uint32_t length;
+			uint32_t opcode;
+			// Word index of the result ID, 0 if none
+			uint32_t resultIndex;
+			// Word indices of the ID operands (result type included)
+			std::vector<uint32_t> idIndices;
+			// Index of the enclosing OpFunction instruction + 1, 0 for global instructions
+			size_t function;
+		};
+
+		// Find the ID operands of an instruction
+		// switchLiteralWords is the size of the case literals of an OpSwitch
+		bool decode(const uint32_t *code, Instruction *instruction, uint32_t switchLiteralWords)
+		{
+			const uint32_t *words = code + instruction->offset;
+			Layout layout;
+			if (!operandLayout(instruction->opcode, &layout))
+			{
+				return false;
+			}
+
+			uint32_t index = 1;
+			if (layout.resultType)
+			{
+				instruction->idIndices.push_back(index++);
+			}
+			instruction->resultIndex = layout.result ? index++ : 0;
+
+			const char *kinds = layout.operands;
+			while (index < instruction->length)
+			{
+				if (*kinds == '\0')
+				{
+					if (instruction->opcode != spv::OpSwitch)
+					{
+						// More operands than the instruction can have
+						return false;
+					}
+					index += switchLiteralWords;
+					instruction->idIndices.push_back(index++);
+					continue;
+				}
+				char kind = *kinds;
+				if (kinds[1] != '*')
+				{
+					kinds++;
+				}
+				switch (kind)
+				{
+				case 'i':
+					instruction->idIndices.push_back(index++);
+					break;
+				case 'l':
+					index++;
+					break;
+				case 's':
+					// Null terminated, the last word contains at least one zero byte
+					while (index < instruction->length)
+					{
+						uint32_t word = words[index++];
+						if (((word & 0xff) == 0) || ((word & 0xff00) == 0) || ((word & 0xff0000) == 0) || ((word & 0xff000000) == 0))
+						{
+							break;
+						}
+					}
+					break;
+				}
+			}
+			return index == instruction->length;
+		}
+	}
+
+	bool optimize(const uint32_t *code, size_t codeSize, std::vector<uint32_t> *optimized, Report *report)
+	{
+		size_t wordCount = codeSize / sizeof(uint32_t);
+		if ((codeSize % sizeof(uint32_t) != 0) || (wordCount < 5) || (code[0] != spv::MagicNumber))
+		{
+			return false;
+		}
+		// Header : magic, version, generator, bound, schema
+		uint32_t bound = code[3];
+
+		// Split the module into instructions
+		std::vector<Instruction> instructions;
+		size_t offset = 5;
+		while (offset < wordCount)
+		{
+			Instruction instruction = {};
+			instruction.offset = offset;
+			instruction.opcode = code[offset] & spv::OpCodeMask;
+			instruction.length = code[offset] >> spv::WordCountShift;
+			if ((instruction.length == 0) || (offset + instruction.length > wordCount))
+			{
+				return false;
+			}
+			instructions.push_back(instruction);
+			offset += instruction.length;
+		}
+
+		// Find the ID operands and the definition of each ID
+		// Dead code elimination and renumbering need all instructions to be understood
+		bool decoded = true;
+		std::vector<size_t> definitions(bound, SIZE_MAX);
+		std::vector<uint32_t> resultTypes(bound, 0);
+		std::vector<uint32_t> intWidths(bound, 32);
+		size_t function = 0;
+		for (size_t i = 0; (i < instructions.size()) && decoded; i++)
+		{
+			Instruction &instruction = instructions[i];
+			const uint32_t *words = code + instruction.offset;
+			uint32_t switchLiteralWords = 1;
+			if ((instruction.opcode == spv::OpSwitch) && (instruction.length > 1) && (words[1] < bound))
+			{
+				switchLiteralWords = intWidths[resultTypes[words[1]]] / 32;
+			}
+			decoded = decode(code, &instruction, switchLiteralWords);
+			if (!decoded)
+			{
+				break;
+			}
+			for (auto& index : instruction.idIndices)
+			{
+				decoded = decoded && (words[index] < bound);
+			}
+			if (instruction.resultIndex != 0)
+			{
+				uint32_t result = words[instruction.resultIndex];
+				decoded = decoded && (result < bound) && (definitions[result] == SIZE_MAX);
+				if (!decoded)
+				{
+					break;
+				}
+				definitions[result] = i;
+				if (!instruction.idIndices.empty() && (instruction.idIndices[0] == 1))
+				{
+					resultTypes[result] = words[1];
+				}
+				if ((instruction.opcode == spv::OpTypeInt) && (words[2] >= 32))
+				{
+					intWidths[result] = words[2];
+				}
+			}
+			if (instruction.opcode == spv::OpFunction)
+			{
+				function = i + 1;
+			}
+			instruction.function = function;
+			if (instruction.opcode == spv::OpFunctionEnd)
+			{
+				function = 0;
+			}
+		}
+
+		std::vector<bool> keep(instructions.size(), true);
+		Report result;
+		result.originalSize = codeSize;
+		result.originalBound = bound;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			if (isDebug(instructions[i].opcode))
+			{
+				keep[i] = false;
+				result.strippedInstructions++;
+			}
+		}
+
+		std::vector<uint32_t> output(code, code + 5);
+		if (decoded)
+		{
+			// Mark the IDs reachable from the entry points
+			std::vector<bool> live(bound, false);
+			std::vector<uint32_t> worklist;
+			auto markLive = [&](uint32_t id)
+			{
+				if (!live[id])
+				{
+					live[id] = true;
+					worklist.push_back(id);
+				}
+			};
+			auto markOperands = [&](const Instruction &instruction)
+			{
+				for (auto& index : instruction.idIndices)
+				{
+					markLive(code[instruction.offset + index]);
+				}
+			};
+
+			for (auto& instruction : instructions)
+			{
+				switch (instruction.opcode)
+				{
+				case spv::OpEntryPoint:
+				case spv::OpExecutionMode:
+				case opExecutionModeId:
+				case spv::OpTypeForwardPointer:
+					markOperands(instruction);
+					break;
+				case spv::OpExtInstImport:
+					markLive(code[instruction.offset + instruction.resultIndex]);
+					break;
+				}
+			}
+
+			bool changed = true;
+			while (changed)
+			{
+				while (!worklist.empty())
+				{
+					uint32_t id = worklist.back();
+					worklist.pop_back();
+					size_t definition = definitions[id];
+					if (definition == SIZE_MAX)
+					{
+						// Used but never defined
+						return false;
+					}
+					const Instruction &instruction = instructions[definition];
+					if (instruction.opcode == spv::OpFunction)
+					{
+						// Everything used or defined by the body of a live function is live
+						for (size_t i = definition; (i < instructions.size()) && (instructions[i].function == definition + 1); i++)
+						{
+							markOperands(instructions[i]);
+							if (instructions[i].resultIndex != 0)
+							{
+								markLive(code[instructions[i].offset + instructions[i].resultIndex]);
+							}
+						}
+					}
+					else
+					{
+						markOperands(instruction);
+					}
+				}
+				// Decorations referencing other IDs keep them alive if their target is
+				changed = false;
+				for (auto& instruction : instructions)
+				{
+					if ((instruction.opcode == opDecorateId) && live[code[instruction.offset + 1]])
+					{
+						markOperands(instruction);
+						changed = changed || !worklist.empty();
+					}
+				}
+			}
+
+			// Remove the unreferenced definitions, functions and decorations
+			for (size_t i = 0; i < instructions.size(); i++)
+			{
+				const Instruction &instruction = instructions[i];
+				if (!keep[i])
+				{
+					continue;
+				}
+				if (instruction.function != 0)
+				{
+					const Instruction &functionInstruction = instructions[instruction.function - 1];
+					if (!live[code[functionInstruction.offset + functionInstruction.resultIndex]])
+					{
+						keep[i] = false;
+						if (instruction.opcode == spv::OpFunction)
+						{
+							result.removedFunctions++;
+						}
+					}
+				}
+				else if (isDecoration(instruction.opcode))
+				{
+					if (!live[code[instruction.offset + 1]])
+					{
+						keep[i] = false;
+						result.removedDecorations++;
+					}
+				}
+				else if ((instruction.resultIndex != 0) && !live[code[instruction.offset + instruction.resultIndex]])
+				{
+					keep[i] = false;
+					result.removedDefinitions++;
+				}
+			}
+
+			// Renumber the remaining IDs in order of definition
+			std::vector<uint32_t> newIds(bound, 0);
+			uint32_t nextId = 1;
+			for (size_t i = 0; i < instructions.size(); i++)
+			{
+				if (keep[i] && (instructions[i].resultIndex != 0))
+				{
+					newIds[code[instructions[i].offset + instructions[i].resultIndex]] = nextId++;
+				}
+			}
+			for (size_t i = 0; i < instructions.size(); i++)
+			{
+				if (!keep[i])
+				{
+					continue;
+				}
+				const Instruction &instruction = instructions[i];
+				size_t start = output.size();
+				output.insert(output.end(), code + instruction.offset, code + instruction.offset + instruction.length);
+				for (auto& index : instruction.idIndices)
+				{
+					uint32_t id = newIds[output[start + index]];
+					if (id == 0)
+					{
+						// References a removed definition
+						return false;
+					}
+					output[start + index] = id;
+				}
+				if (instruction.resultIndex != 0)
+				{
+					output[start + instruction.resultIndex] = newIds[output[start + instruction.resultIndex]];
+				}
+			}
+			output[3] = nextId;
+			result.eliminatedDeadCode = true;
+		}
+		else
+		{
+			// Debug instructions are never referenced, they can be stripped without understanding the rest
+			for (size_t i = 0; i < instructions.size(); i++)
+			{
+				if (keep[i])
+				{
+					output.insert(output.end(), code + instructions[i].offset, code + instructions[i].offset + instructions[i].length);
+				}
+			}
+		}
+
+		result.optimizedSize = output.size() * sizeof(uint32_t);
+		result.optimizedBound = output[3];
+		optimized->swap(output);
+		if (report != nullptr)
+		{
+			*report = result;
+		}
+		return true;
+	}
+
+	std::string toString(const Report &report)
+	{
+		std::stringstream ss;
+		size_t saved = report.originalSize - report.optimizedSize;
+		ss << report.originalSize << " -> " << report.optimizedSize << " bytes ("
+			<< saved << " saved, " << (report.originalSize > 0 ? 100 * saved / report.originalSize : 0) << "%), "
+			<< report.strippedInstructions << " debug instructions stripped";
+		if (report.eliminatedDeadCode)
+		{
+			ss << ", " << report.removedFunctions << " functions, " << report.removedDefinitions << " definitions and "
+				<< report.removedDecorations << " decorations removed, bound " << report.originalBound << " -> " << report.optimizedBound;
+		}
+		else
+		{
+			ss << ", dead code kept (unsupported instructions)";
+		}
+		return ss.str();
+	}
+}
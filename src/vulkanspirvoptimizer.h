@@ -0,0 +1,46 @@
+/*
+* SPIR-V size optimizer
+*
+* Shrinks SPIR-V modules before they are shipped or turned into shader modules :
+* - strips debug instructions (OpName, OpMemberName, OpLine, OpSource, ...)
+* - removes functions, types, constants and variables that are not referenced
+*   from an entry point, along with their decorations
+* - renumbers the remaining IDs compactly
+*
+* Note : Only instructions of the core SPIR-V grammar used by GLSL compilers are
+* understood, modules using other instructions (e.g. decoration groups) are
+* only stripped of their debug instructions
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace vkSpirvOptimizer
+{
+	struct Report
+	{
+		// In bytes
+		size_t originalSize = 0;
+		size_t optimizedSize = 0;
+		uint32_t strippedInstructions = 0;
+		uint32_t removedDefinitions = 0;
+		uint32_t removedFunctions = 0;
+		uint32_t removedDecorations = 0;
+		uint32_t originalBound = 0;
+		uint32_t optimizedBound = 0;
+		// False if the module could only be stripped of its debug instructions
+		bool eliminatedDeadCode = false;
+	};
+
+	// Optimize a SPIR-V module (codeSize in bytes)
+	// Returns false if the code is not valid SPIR-V, optimized is left untouched in that case
+	bool optimize(const uint32_t *code, size_t codeSize, std::vector<uint32_t> *optimized, Report *report = nullptr);
+
+	// One line summary of a report, e.g. for logging
+	std::string toString(const Report &report);
+}
@@ -74,6 +74,23 @@ namespace vkTools
 		}
 	}
 
+	VkBool32 getMemoryType(const VkPhysicalDeviceMemoryProperties &memoryProperties, uint32_t typeBits, VkFlags properties, uint32_t *typeIndex)
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if ((typeBits & 1) == 1)
+			{
+				if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+				{
+					*typeIndex = i;
+					return true;
+				}
+			}
+			typeBits >>= 1;
+		}
+		return false;
+	}
+
 	// Create an image memory barrier for changing the layout of
 	// an image and put it into an active command buffer
 	// See chapter 11.4 "Image Layout" for details
@@ -190,19 +207,13 @@ namespace vkTools
 
 	std::string readTextFile(const char *fileName)
 	{
-		std::string fileContent;
-		std::ifstream fileStream(fileName, std::ios::in);
-		if (!fileStream.is_open()) {
+		VulkanMappedFile file;
+		if (!file.open(fileName)) {
 			printf("File %s not found\n", fileName);
 			return "";
 		}
-		std::string line = "";
-		while (!fileStream.eof()) {
-			getline(fileStream, line);
-			fileContent.append(line + "\n");
-		}
-		fileStream.close();
-		return fileContent;
+		// Single copy from the mapping into the string
+		return std::string(file.data(), file.size());
 	}
 
 	// Load a binary file into a buffer (e.g. SPIR-V)
@@ -223,6 +234,7 @@ namespace vkTools
 		shader_code = malloc(size);
 		retval = fread(shader_code, size, 1, fp);
 		assert(retval == 1);
+		fclose(fp);
 
 		*psize = size;
 
@@ -231,9 +243,24 @@ namespace vkTools
 
 	VkShaderModule loadShader(const char *fileName, VkDevice device, VkShaderStageFlagBits stage) 
 	{
-		size_t size = 0;
-		const char *shaderCode = readBinaryFile(fileName, &size);
-		assert(size > 0);
+		// The code is handed to Vulkan straight from the mapping, which is released on return
+		VulkanMappedFile file;
+		if (!file.open(fileName))
+		{
+			exitFatal(std::string("Could not open shader file ") + fileName, "Fatal error");
+		}
+		if (!file.isSpirv())
+		{
+			exitFatal(std::string("Shader file ") + fileName + " is not valid SPIR-V", "Fatal error");
+		}
+		return createShaderModule((const uint32_t*)file.data(), file.size(), device);
+	}
+
+	VkShaderModule createShaderModule(const uint32_t *code, size_t codeSize, VkDevice device)
+	{
+		assert(codeSize > 0);
+		assert(codeSize % sizeof(uint32_t) == 0);
+		assert((uintptr_t)code % sizeof(uint32_t) == 0);
 
 		VkShaderModule shaderModule;
 		VkShaderModuleCreateInfo moduleCreateInfo;
@@ -242,8 +269,8 @@ namespace vkTools
 		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 		moduleCreateInfo.pNext = NULL;
 
-		moduleCreateInfo.codeSize = size;
-		moduleCreateInfo.pCode = (uint32_t*)shaderCode;
+		moduleCreateInfo.codeSize = codeSize;
+		moduleCreateInfo.pCode = code;
 		moduleCreateInfo.flags = 0;
 		err = vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule);
 		assert(!err);
@@ -251,6 +278,17 @@ namespace vkTools
 		return shaderModule;
 	}
 
+	uint64_t hashBytes(const void *data, size_t size, uint64_t seed)
+	{
+		uint64_t hash = seed;
+		const uint8_t *bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+		}
+		return hash;
+	}
+
 
 	VkShaderModule loadShaderGLSL(const char *fileName, VkDevice device, VkShaderStageFlagBits stage)
 	{
@@ -278,6 +316,7 @@ namespace vkTools
 
 		err = vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule);
 		assert(!err);
+		free((void*)moduleCreateInfo.pCode);
 
 		return shaderModule;
 	}
@@ -422,6 +461,16 @@ VkSemaphoreCreateInfo vkTools::initializers::semaphoreCreateInfo(
 	return semaphoreCreateInfo;
 }
 
+VkFenceCreateInfo vkTools::initializers::fenceCreateInfo(
+	VkFenceCreateFlags flags)
+{
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceCreateInfo.pNext = NULL;
+	fenceCreateInfo.flags = flags;
+	return fenceCreateInfo;
+}
+
 VkSubmitInfo vkTools::initializers::submitInfo()
 {
 	VkSubmitInfo submitInfo = {};
@@ -592,6 +641,23 @@ VkWriteDescriptorSet vkTools::initializers::writeDescriptorSet(
 	return writeDescriptorSet;
 }
 
+VkWriteDescriptorSet vkTools::initializers::writeDescriptorSet(
+	VkDescriptorSet dstSet,
+	VkDescriptorType type,
+	uint32_t binding,
+	VkBufferView * texelBufferView)
+{
+	VkWriteDescriptorSet writeDescriptorSet = {};
+	writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writeDescriptorSet.pNext = NULL;
+	writeDescriptorSet.dstSet = dstSet;
+	writeDescriptorSet.descriptorType = type;
+	writeDescriptorSet.dstBinding = binding;
+	writeDescriptorSet.pTexelBufferView = texelBufferView;
+	writeDescriptorSet.descriptorCount = 1;
+	return writeDescriptorSet;
+}
+
 VkVertexInputBindingDescription vkTools::initializers::vertexInputBindingDescription(
 	uint32_t binding, 
 	uint32_t stride, 
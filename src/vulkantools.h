@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <vector>
 #include <iostream>
+#include "vulkanmappedfile.hpp"
 #ifdef _WIN32
 #include <windows.h>
 #include <fcntl.h>
@@ -37,6 +38,13 @@ namespace vkTools
 	VkBool32 checkDeviceExtensionPresent(VkPhysicalDevice physicalDevice, const char* extensionName);
 	// Return string representation of a vulkan error string
 	std::string errorString(VkResult errorCode);
+	// Get memory type index for a given memory allocation (flags and bits)
+	// Same as VulkanExampleBase::getMemoryType for classes that don't have access to the example base
+	VkBool32 getMemoryType(
+		const VkPhysicalDeviceMemoryProperties &memoryProperties,
+		uint32_t typeBits,
+		VkFlags properties,
+		uint32_t *typeIndex);
 
 	// Put an image memory barrier for setting an image layout into the given command buffer
 	void setImageLayout(
@@ -51,9 +59,19 @@ namespace vkTools
 	// Load a text file (e.g. GLGL shader) into a std::string
 	std::string readTextFile(const char *fileName);
 	// Load a binary file into a buffer (e.g. SPIR-V)
+	// The buffer is allocated with malloc and must be released by the caller with free
+	// Prefer VulkanMappedFile to read files in place without a copy
 	char *readBinaryFile(const char *filename, size_t *psize);
 	// Load a SPIR-V shader
+	// The code is read in place from a memory mapping of the file
 	VkShaderModule loadShader(const char *fileName, VkDevice device, VkShaderStageFlagBits stage);
+	// Create a shader module from SPIR-V code (codeSize in bytes, code must be 4 byte aligned)
+	VkShaderModule createShaderModule(const uint32_t *code, size_t codeSize, VkDevice device);
+	// Initial value of hashBytes()
+	const uint64_t hashBytesSeed = 14695981039346656037ULL;
+	// 64 bit FNV-1a hash of size bytes
+	// Pass the hash of the previous bytes as seed to hash data in several parts
+	uint64_t hashBytes(const void *data, size_t size, uint64_t seed = hashBytesSeed);
 	// Load a GLSL shader
 	// Note : Only for testing purposes, support for directly feeding GLSL shaders into Vulkan
 	// may be dropped at some point	
@@ -109,6 +127,9 @@ namespace vkTools
 		VkSemaphoreCreateInfo semaphoreCreateInfo(
 			VkSemaphoreCreateFlags flags);
 
+		VkFenceCreateInfo fenceCreateInfo(
+			VkFenceCreateFlags flags);
+
 		VkSubmitInfo submitInfo();
 
 		VkViewport viewport(
@@ -171,6 +192,13 @@ namespace vkTools
 			uint32_t binding, 
 			VkDescriptorImageInfo* imageInfo);
 
+		// For uniform and storage texel buffers
+		VkWriteDescriptorSet writeDescriptorSet(
+			VkDescriptorSet dstSet,
+			VkDescriptorType type,
+			uint32_t binding,
+			VkBufferView* texelBufferView);
+
 		VkVertexInputBindingDescription vertexInputBindingDescription(
 			uint32_t binding, 
 			uint32_t stride, 